@@ -45,7 +45,7 @@ namespace chess
     public:
         typedef Representation representation_type;
     public:
-        ai(int32_t aPly = 4);
+        ai(int32_t aPly = 4, std::size_t aTableSize = DEFAULT_TABLE_SIZE, uint32_t aThreads = std::thread::hardware_concurrency());
         ~ai();
     public:
         player_type type() const override;
@@ -70,7 +70,7 @@ namespace chess
         move_tables<representation_type> const iMoveTables;
         mutable std::recursive_mutex iMutex;
         basic_position<representation_type> iPosition;
-        table iTable;
+        transposition_table iTable;
         std::list<ai_thread<Representation, Player>> iThreads;
         std::mutex iSignalMutex;
         std::condition_variable iSignal;
@@ -25,8 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <future>
 
 #include <chess/primitives.hpp>
-#include <chess/i_player.hpp>
-#include <chess/zobrist.hpp>
+#include <chess/table.hpp>
 
 namespace chess
 {
@@ -45,29 +44,28 @@ namespace chess
         struct work_item
         {
             position_type position;
-            move move;
             game_tree_node node;
+            uint32_t helper;
             std::promise<game_tree_node> result;
         };
     public:
-        ai_thread(i_player const& aPlayer, int32_t aPly);
+        ai_thread(transposition_table& aTable, int32_t aPly);
         ~ai_thread();
     public:
-        std::promise<game_tree_node>& eval(position_type const& aPosition, game_tree_node&& aNode);
+        std::future<game_tree_node> eval(position_type const& aPosition, game_tree_node&& aNode, uint32_t aHelper);
         void start();
         void stop();
         void finish();
     private:
         void process();
     private:
-        i_player const& iPlayer;
+        transposition_table& iTable;
         int32_t iPly;
         move_tables<representation_type> const iMoveTables;
         std::deque<work_item> iQueue;
         std::mutex iMutex;
         std::condition_variable iSignal;
+        std::atomic<game_state*> iGameState = nullptr; // set by the thread so must be initialized before it starts
         std::thread iThread;
-        std::atomic<game_state*> iGameState = nullptr;
-        zobrist::hash_t iHash;
     };
 }
\ No newline at end of file
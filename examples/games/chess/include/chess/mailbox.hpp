@@ -186,17 +186,26 @@ namespace chess
     template <player Player, typename ResultContainer>
     inline void sort_nodes(move_tables<mailbox_rep> const& aTables, mailbox_position const& aPosition, ResultContainer& aResult)
     {
-        std::sort(as_valid_moves(aResult).begin(), as_valid_moves(aResult).end(), [&](auto const& lhs, auto const& rhs)
+        // evaluate each move once up front rather than twice per comparison
+        auto& moves = as_valid_moves(aResult);
+        mailbox_position board = aPosition;
+        std::vector<std::pair<double, std::size_t>> keys;
+        keys.reserve(moves.size());
+        for (std::size_t i = 0u; i < moves.size(); ++i)
         {
-            mailbox_position lhsBoard = aPosition;
-            mailbox_position rhsBoard = aPosition;
-            make(lhsBoard, as_move(lhs));
-            make(rhsBoard, as_move(rhs));
-            return eval<mailbox_rep, Player>{}(aTables, lhsBoard, 2.0).eval < eval<mailbox_rep, Player>{}(aTables, rhsBoard, 2.0).eval;
-        });
+            make(board, as_move(moves[i]));
+            keys.emplace_back(eval<mailbox_rep, Player>{}(aTables, board, 2.0).eval, i);
+            unmake(board);
+        }
+        std::stable_sort(keys.begin(), keys.end(), [](auto const& lhs, auto const& rhs) { return lhs.first < rhs.first; });
+        std::vector<game_tree_node> sorted;
+        sorted.reserve(moves.size());
+        for (auto const& key : keys)
+            sorted.push_back(std::move(moves[key.second]));
+        moves = std::move(sorted);
     }
 
-    template <player Player>
+    template <player Player, move_generation Generation = move_generation::All>
     inline void valid_moves(move_tables<mailbox_rep> const& aTables, mailbox_position& aPosition, game_tree_node& aResult)
     {
         as_valid_moves(aResult).clear();
@@ -206,6 +215,14 @@ namespace chess
                     for (coordinate yTo = 0u; yTo <= 7u; ++yTo)
                     {
                         move candidateMove{ { xFrom, yFrom }, { xTo, yTo } };
+                        if constexpr (Generation != move_generation::All)
+                        {
+                            // cheap filter before the full legality test
+                            bool const capture = static_cast<player>(piece_at(aPosition, candidateMove.to) & piece::COLOR_MASK) == opponent_v<Player> ||
+                                (piece_type(piece_at(aPosition, candidateMove.from)) == piece::Pawn && xFrom != xTo);
+                            if (capture != (Generation == move_generation::Captures))
+                                continue;
+                        }
                         if (can_move<>(aTables, Player, aPosition, candidateMove))
                         {
                             auto const movingPiece = piece_at(aPosition, candidateMove.from);
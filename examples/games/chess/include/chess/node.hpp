@@ -25,7 +25,7 @@ namespace chess
 {
     struct game_tree_node
     {
-        std::optional<move> move;
+        std::optional<chess::move> move;
         std::optional<std::vector<game_tree_node>> children;
         std::optional<bool> kingMobility;
         std::optional<double> eval;
@@ -49,6 +49,8 @@ namespace chess
 
     constexpr std::size_t PIECE_COLORS = static_cast<std::size_t>(piece_color_cardinal::COUNT);
 
+    constexpr std::size_t SQUARES = 64;
+
     enum class piece : uint8_t
     {
         None        = 0x00,
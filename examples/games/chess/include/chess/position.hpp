@@ -20,12 +20,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <bit>
 #include <ostream>
+#include <sstream>
+#include <cctype>
+#include <tuple>
 
 #include <neolib/core/static_vector.hpp>
 
 #include <chess/chess.hpp>
 #include <chess/piece.hpp>
 #include <chess/player.hpp>
+#include <chess/zobrist.hpp>
 
 namespace chess
 {
@@ -35,8 +39,6 @@ namespace chess
     typedef neogfx::point_i32 coordinates_i32;
     typedef coordinates_i32::coordinate_type coordinate_i32;
 
-    std::size_t constexpr SQUARES = 64;
-
     struct move
     {
         coordinates from;
@@ -56,6 +58,13 @@ namespace chess
         castling_state castlingState;
     };
 
+    enum class move_generation : uint32_t
+    {
+        All,
+        Captures,   // including en passant
+        Quiets
+    };
+
     inline bool operator==(move const& lhs, move const& rhs)
     {
         // todo: consider castling state?
@@ -177,8 +186,17 @@ namespace chess
         player turn;
         std::vector<move> moveHistory;
         mutable std::optional<move> checkTest;
+        zobrist::hash_t hash = {};
 
-        std::weak_ordering operator<=>(basic_position<mailbox_rep> const&) const = default;
+        // hash is derived from the other members so it takes no part in comparisons
+        std::weak_ordering operator<=>(basic_position<mailbox_rep> const& aOther) const
+        {
+            return std::tie(rep, kings, turn, moveHistory, checkTest) <=> std::tie(aOther.rep, aOther.kings, aOther.turn, aOther.moveHistory, aOther.checkTest);
+        }
+        bool operator==(basic_position<mailbox_rep> const& aOther) const
+        {
+            return std::tie(rep, kings, turn, moveHistory, checkTest) == std::tie(aOther.rep, aOther.kings, aOther.turn, aOther.moveHistory, aOther.checkTest);
+        }
     };
 
     template <>
@@ -187,8 +205,17 @@ namespace chess
         bitboard_rep rep;
         player turn;
         std::vector<move> moveHistory;
+        zobrist::hash_t hash = {};
 
-        std::weak_ordering operator<=>(basic_position<bitboard_rep> const&) const = default;
+        // hash is derived from the other members so it takes no part in comparisons
+        std::weak_ordering operator<=>(basic_position<bitboard_rep> const& aOther) const
+        {
+            return std::tie(rep, turn, moveHistory) <=> std::tie(aOther.rep, aOther.turn, aOther.moveHistory);
+        }
+        bool operator==(basic_position<bitboard_rep> const& aOther) const
+        {
+            return std::tie(rep, turn, moveHistory) == std::tie(aOther.rep, aOther.turn, aOther.moveHistory);
+        }
     };
 
     using mailbox_position = basic_position<mailbox_rep>;
@@ -219,6 +246,40 @@ namespace chess
 
     using position = bitboard_position;
 
+    template <typename Representation>
+    inline zobrist::hash_t state_hash(basic_position<Representation> const& aPosition)
+    {
+        auto const& keys = zobrist::get_keys();
+        zobrist::hash_t result = {};
+        if (aPosition.turn == player::Black)
+            result ^= keys.blackToMove;
+        if (!aPosition.moveHistory.empty())
+        {
+            auto const& lastMove = aPosition.moveHistory.back();
+            for (std::size_t color = 0u; color < PIECE_COLORS; ++color)
+            {
+                auto const& castlingState = lastMove.castlingState[color];
+                bool const kingMoved = castlingState[static_cast<std::size_t>(move::castling_piece_index::King)];
+                if (kingMoved || castlingState[static_cast<std::size_t>(move::castling_piece_index::QueensRook)])
+                    result ^= keys.castling[color * 2u];
+                if (kingMoved || castlingState[static_cast<std::size_t>(move::castling_piece_index::KingsRook)])
+                    result ^= keys.castling[color * 2u + 1u];
+            }
+            if (piece_type(piece_at(aPosition.rep, lastMove.to)) == piece::Pawn &&
+                std::abs(static_cast<int32_t>(lastMove.to.y) - static_cast<int32_t>(lastMove.from.y)) == 2)
+                result ^= keys.enPassant[lastMove.to.x];
+        }
+        return result;
+    }
+
+    template <typename Representation>
+    inline void set_piece(basic_position<Representation>& aPosition, coordinates const& aCoordinates, piece aPiece)
+    {
+        auto const square = bit_position_from_coordinates(aCoordinates);
+        aPosition.hash ^= zobrist::piece_key(square, piece_at(aPosition.rep, aCoordinates)) ^ zobrist::piece_key(square, aPiece);
+        set_piece(aPosition.rep, aCoordinates, aPiece);
+    }
+
     inline std::string to_string(piece aPiece, std::string const& aNone = ".")
     {
         switch (aPiece)
@@ -288,20 +349,21 @@ namespace chess
         std::optional<move> lastMove;
         if (!aPosition.moveHistory.empty())
         {
+            aPosition.hash ^= state_hash(aPosition);
             lastMove = aPosition.moveHistory.back();
             auto const& lastMoveFrom = lastMove->from;
             auto const& lastMoveTo = lastMove->to;
             aPosition.moveHistory.pop_back();
             auto const movedPiece = piece_at(aPosition.rep, lastMoveTo);
-            set_piece(aPosition.rep, lastMoveFrom, movedPiece);
-            set_piece(aPosition.rep, lastMoveTo, lastMove->capture);
+            set_piece(aPosition, lastMoveFrom, movedPiece);
+            set_piece(aPosition, lastMoveTo, lastMove->capture);
             if (lastMove->promoteTo)
             {
                 // pawn promotion
                 if (lastMove->to.y == promotion_rank_v<player::White>)
-                    set_piece(aPosition.rep, lastMoveFrom, piece::WhitePawn);
+                    set_piece(aPosition, lastMoveFrom, piece::WhitePawn);
                 else if (lastMove->to.y == promotion_rank_v<player::Black>)
-                    set_piece(aPosition.rep, lastMoveFrom, piece::BlackPawn);
+                    set_piece(aPosition, lastMoveFrom, piece::BlackPawn);
             }
             else
             {
@@ -313,8 +375,8 @@ namespace chess
                         aPosition.moveHistory.back().to == coordinates{ aPosition.moveHistory.back().to.x, 3u } &&
                         aPosition.moveHistory.back().from == coordinates{ aPosition.moveHistory.back().to.x, 1u })
                     {
-                        set_piece(aPosition.rep, lastMoveTo, piece::None);
-                        set_piece(aPosition.rep, lastMoveTo.with_y(lastMoveTo.y + 1u), piece::WhitePawn);
+                        set_piece(aPosition, lastMoveTo, piece::None);
+                        set_piece(aPosition, lastMoveTo.with_y(lastMoveTo.y + 1u), piece::WhitePawn);
                     }
                     break;
                 case piece::WhitePawn:
@@ -323,8 +385,8 @@ namespace chess
                         aPosition.moveHistory.back().to == coordinates{ aPosition.moveHistory.back().to.x, 4u } &&
                         aPosition.moveHistory.back().from == coordinates{ aPosition.moveHistory.back().to.x, 6u })
                     {
-                        set_piece(aPosition.rep, lastMoveTo, piece::None);
-                        set_piece(aPosition.rep, lastMoveTo.with_y(lastMoveTo.y - 1u), piece::BlackPawn);
+                        set_piece(aPosition, lastMoveTo, piece::None);
+                        set_piece(aPosition, lastMoveTo.with_y(lastMoveTo.y - 1u), piece::BlackPawn);
                     }
                     break;
                 case piece::WhiteKing:
@@ -333,13 +395,13 @@ namespace chess
                     // castling (white)
                     if (lastMoveTo.x - lastMoveFrom.x == 2u)
                     {
-                        set_piece(aPosition.rep, coordinates{ 7u, 0u }, piece::WhiteRook);
-                        set_piece(aPosition.rep, coordinates{ 5u, 0u }, piece::None);
+                        set_piece(aPosition, coordinates{ 7u, 0u }, piece::WhiteRook);
+                        set_piece(aPosition, coordinates{ 5u, 0u }, piece::None);
                     }
                     else if (lastMoveFrom.x - lastMoveTo.x == 2u)
                     {
-                        set_piece(aPosition.rep, coordinates{ 0u, 0u }, piece::WhiteRook);
-                        set_piece(aPosition.rep, coordinates{ 3u, 0u }, piece::None);
+                        set_piece(aPosition, coordinates{ 0u, 0u }, piece::WhiteRook);
+                        set_piece(aPosition, coordinates{ 3u, 0u }, piece::None);
                     }
                     break;
                 case piece::BlackKing:
@@ -348,13 +410,13 @@ namespace chess
                     // castling (black)
                     if (lastMoveTo.x - lastMoveFrom.x == 2u)
                     {
-                        set_piece(aPosition.rep, coordinates{ 7u, 7u }, piece::BlackRook);
-                        set_piece(aPosition.rep, coordinates{ 5u, 7u }, piece::None);
+                        set_piece(aPosition, coordinates{ 7u, 7u }, piece::BlackRook);
+                        set_piece(aPosition, coordinates{ 5u, 7u }, piece::None);
                     }
                     else if (lastMoveFrom.x - lastMoveTo.x == 2u)
                     {
-                        set_piece(aPosition.rep, coordinates{ 0u, 7u }, piece::BlackRook);
-                        set_piece(aPosition.rep, coordinates{ 3u, 7u }, piece::None);
+                        set_piece(aPosition, coordinates{ 0u, 7u }, piece::BlackRook);
+                        set_piece(aPosition, coordinates{ 3u, 7u }, piece::None);
                     }
                     break;
                 default:
@@ -363,6 +425,7 @@ namespace chess
                 }
             }
             aPosition.turn = opponent(aPosition.turn);
+            aPosition.hash ^= state_hash(aPosition);
         }
         return lastMove;
     }
@@ -428,11 +491,12 @@ namespace chess
     template <typename Representation>
     inline void make(basic_position<Representation>& aPosition, chess::move const& aMove)
     {
+        aPosition.hash ^= state_hash(aPosition);
         auto const movingPiece = piece_at(aPosition.rep, aMove.from);
         auto const targetPiece = piece_at(aPosition.rep, aMove.to);
         auto const destinationPiece = (!aMove.promoteTo ? movingPiece : *aMove.promoteTo);
-        set_piece(aPosition.rep, aMove.to, destinationPiece);
-        set_piece(aPosition.rep, aMove.from, piece::None);
+        set_piece(aPosition, aMove.to, destinationPiece);
+        set_piece(aPosition, aMove.from, piece::None);
         auto const currentMoveCount = aPosition.moveHistory.size();
         aPosition.moveHistory.emplace_back(aMove.from, aMove.to, aMove.isCapture, aMove.promoteTo, targetPiece, currentMoveCount > 0 ? aPosition.moveHistory[currentMoveCount - 1u].castlingState : move::castling_state{});
         auto& newMove = aPosition.moveHistory.back();
@@ -447,15 +511,15 @@ namespace chess
             {
                 // queenside castling
                 newMove.castlingState[as_color_cardinal<>(movingPiece)][static_cast<std::size_t>(move::castling_piece_index::QueensRook)] = true;
-                set_piece(aPosition.rep, aMove.from.with_x(0u), piece::None);
-                set_piece(aPosition.rep, aMove.from.with_x(3u), piece_color(movingPiece) | piece::Rook);
+                set_piece(aPosition, aMove.from.with_x(0u), piece::None);
+                set_piece(aPosition, aMove.from.with_x(3u), piece_color(movingPiece) | piece::Rook);
             }
             else if (aMove.to.x - aMove.from.x == 2)
             {
                 // kingside castling
                 newMove.castlingState[as_color_cardinal<>(movingPiece)][static_cast<std::size_t>(move::castling_piece_index::KingsRook)] = true;
-                set_piece(aPosition.rep, aMove.from.with_x(7u), piece::None);
-                set_piece(aPosition.rep, aMove.from.with_x(5u), piece_color(movingPiece) | piece::Rook);
+                set_piece(aPosition, aMove.from.with_x(7u), piece::None);
+                set_piece(aPosition, aMove.from.with_x(5u), piece_color(movingPiece) | piece::Rook);
             }
             break;
         case piece::WhiteRook:
@@ -475,7 +539,7 @@ namespace chess
             if (targetPiece == piece::None && aMove.from.x != aMove.to.x)
             {
                 newMove.capture = piece_at(aPosition.rep, aMove.to.with_y(4u));
-                set_piece(aPosition.rep, aMove.to.with_y(4u), piece::None);
+                set_piece(aPosition, aMove.to.with_y(4u), piece::None);
             }
             break;
         case piece::BlackPawn:
@@ -483,7 +547,7 @@ namespace chess
             if (targetPiece == piece::None && aMove.from.x != aMove.to.x)
             {
                 newMove.capture = piece_at(aPosition.rep, aMove.to.with_y(3u));
-                set_piece(aPosition.rep, aMove.to.with_y(3u), piece::None);
+                set_piece(aPosition, aMove.to.with_y(3u), piece::None);
             }
             break;
         default:
@@ -509,6 +573,19 @@ namespace chess
             break;
         }
         aPosition.turn = opponent(aPosition.turn);
+        aPosition.hash ^= state_hash(aPosition);
+    }
+
+    namespace zobrist
+    {
+        template <typename Representation>
+        inline hash_t hash(basic_position<Representation> const& aPosition)
+        {
+            hash_t result = state_hash(aPosition);
+            for (bit_position sq = 0u; sq < SQUARES; ++sq)
+                result ^= piece_key(sq, piece_at(aPosition.rep, coordinates_from_bit_position(sq)));
+            return result;
+        }
     }
 
     struct invalid_uci_move : std::runtime_error { invalid_uci_move() : std::runtime_error{ "chess::invalid_uci_move" } {} };
@@ -529,6 +606,85 @@ namespace chess
         return result;
     }
 
+    struct invalid_fen : std::runtime_error { invalid_fen() : std::runtime_error{ "chess::invalid_fen" } {} };
+
+    // Reads placement, side to move, castling and en passant; the move clocks are not tracked. Castling
+    // rights and the en passant square live in the last move of the history so they are carried by a
+    // synthesized move which is not meant to be unmade.
+    template <typename Representation>
+    inline basic_position<Representation> parse_fen(std::string const& aFen)
+    {
+        std::istringstream fields{ aFen };
+        std::string placement, turn, castling, enPassant;
+        if (!(fields >> placement >> turn >> castling >> enPassant))
+            throw invalid_fen();
+        basic_position<Representation> result = {};
+        coordinate x = 0u;
+        coordinate y = 7u;
+        for (auto const ch : placement)
+        {
+            if (ch == '/')
+            {
+                if (x != 8u || y == 0u)
+                    throw invalid_fen();
+                x = 0u;
+                --y;
+            }
+            else if (ch >= '1' && ch <= '8')
+            {
+                x += static_cast<coordinate>(ch - '0');
+                if (x > 8u)
+                    throw invalid_fen();
+            }
+            else
+            {
+                if (x >= 8u)
+                    throw invalid_fen();
+                auto const color = std::isupper(static_cast<unsigned char>(ch)) ? piece::White : piece::Black;
+                auto const type = parse_piece_character(ch);
+                set_piece(result.rep, coordinates{ x, y }, type | color);
+                if constexpr (std::is_same_v<Representation, mailbox_rep>)
+                    if (type == piece::King)
+                        result.kings[as_color_cardinal<>(color)] = coordinates{ x, y };
+                ++x;
+            }
+        }
+        if (x != 8u || y != 0u)
+            throw invalid_fen();
+        if (turn == "w")
+            result.turn = player::White;
+        else if (turn == "b")
+            result.turn = player::Black;
+        else
+            throw invalid_fen();
+        move lastMove = {};
+        bool const castlingRestricted = (castling != "KQkq");
+        if (castling != "-")
+            for (auto const ch : castling)
+                if (std::string{ "KQkq" }.find(ch) == std::string::npos)
+                    throw invalid_fen();
+        for (std::size_t color = 0u; color < PIECE_COLORS; ++color)
+        {
+            auto const kingside = (color == 0u ? 'K' : 'k');
+            auto const queenside = (color == 0u ? 'Q' : 'q');
+            lastMove.castlingState[color][static_cast<std::size_t>(move::castling_piece_index::KingsRook)] = castling.find(kingside) == std::string::npos;
+            lastMove.castlingState[color][static_cast<std::size_t>(move::castling_piece_index::QueensRook)] = castling.find(queenside) == std::string::npos;
+        }
+        if (enPassant != "-")
+        {
+            if (enPassant.size() != 2u || enPassant[0] < 'a' || enPassant[0] > 'h' ||
+                enPassant[1] != (result.turn == player::White ? '6' : '3'))
+                throw invalid_fen();
+            coordinate const file = enPassant[0] - 'a';
+            lastMove.from = result.turn == player::White ? coordinates{ file, 6u } : coordinates{ file, 1u };
+            lastMove.to = result.turn == player::White ? coordinates{ file, 4u } : coordinates{ file, 3u };
+        }
+        if (castlingRestricted || enPassant != "-")
+            result.moveHistory.push_back(lastMove);
+        result.hash = zobrist::hash(result);
+        return result;
+    }
+
     template <typename Representation>
     basic_position<Representation> const& setup_position();
 
@@ -18,41 +18,176 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include <vector>
-#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <memory>
+#include <optional>
 
-#include <chess/zobrist.hpp>
+#include <chess/position.hpp>
 
 namespace chess
 {
+    enum class table_bound : uint8_t
+    {
+        None    = 0x0,
+        Exact   = 0x1,
+        Lower   = 0x2,
+        Upper   = 0x3
+    };
+
+    typedef std::uint16_t table_move;
+
+    inline table_move to_table_move(move const& aMove)
+    {
+        // from and to never coincide so zero is free to mean "no move"
+        return static_cast<table_move>(
+            bit_position_from_coordinates(aMove.from) |
+            (bit_position_from_coordinates(aMove.to) << 6u) |
+            ((aMove.promoteTo ? as_cardinal(*aMove.promoteTo) + 1u : 0u) << 12u));
+    }
+
+    inline coordinates table_move_from(table_move aMove)
+    {
+        return coordinates_from_bit_position(aMove & 0x3Fu);
+    }
+
+    inline coordinates table_move_to(table_move aMove)
+    {
+        return coordinates_from_bit_position((aMove >> 6u) & 0x3Fu);
+    }
+
+    inline bool table_move_promotes(table_move aMove)
+    {
+        return (aMove >> 12u) != 0u;
+    }
+
+    inline bool same_move(table_move lhs, move const& rhs)
+    {
+        return lhs != table_move{} && lhs == to_table_move(rhs);
+    }
+
+    // Mate scores are scaled down by their distance from the root (see eval) so the same mate would be worth
+    // different amounts depending on where in the tree its position was reached; they are stored relative to
+    // the node they were found at and rescaled to the distance of the node that probes them.
+    double constexpr MATE_THRESHOLD = 1e200;
+
+    inline bool is_mate_score(double aScore)
+    {
+        return std::isfinite(aScore) && std::abs(aScore) >= MATE_THRESHOLD;
+    }
+
+    inline double mate_score_to_table(double aScore, std::int32_t aDistance)
+    {
+        if (!is_mate_score(aScore))
+            return aScore;
+        return std::clamp(aScore * std::pow(10.0, aDistance), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max());
+    }
+
+    inline double mate_score_from_table(double aScore, std::int32_t aDistance)
+    {
+        if (!is_mate_score(aScore))
+            return aScore;
+        return aScore / std::pow(10.0, aDistance);
+    }
+
+    struct table_hit
+    {
+        double score;
+        std::int32_t depth;
+        table_bound bound;
+        table_move bestMove;
+    };
+
+    // Lock-free entry: signature is the position hash XORed with both data words so a torn
+    // write by another search thread is detected as a miss instead of being read as a hit.
     struct table_entry
     {
         std::atomic<zobrist::hash_t> signature = zobrist::hash_t{};
-        std::atomic<std::chrono::steady_clock::time_point> age = std::chrono::steady_clock::time_point{};
-        std::atomic<std::int32_t> depth = 0;
-        std::atomic<double> score = 0.0;
-
-        table_entry() = default;
-        table_entry(table_entry const& other) :
-            signature{ other.signature.load() },
-            age{ other.age.load() },
-            depth{ other.depth.load() },
-            score{ other.score.load() }
+        std::atomic<std::uint64_t> data = 0ull;
+        std::atomic<std::uint64_t> score = 0ull;
+    };
+
+    std::size_t constexpr DEFAULT_TABLE_SIZE = 256u * 1024u * 1024u;
+
+    class transposition_table
+    {
+    public:
+        transposition_table(std::size_t aSizeInBytes = DEFAULT_TABLE_SIZE)
         {
+            resize(aSizeInBytes);
         }
-
-        zobrist::hash_t combined_hash(zobrist::hash_t aHash) const
+    public:
+        std::size_t size() const
+        {
+            return iMask + 1u;
+        }
+        void resize(std::size_t aSizeInBytes)
         {
-            auto result = aHash ^ age.load().time_since_epoch().count() ^ depth.load();
-            double s = score.load();
-            std::uint64_t n;
-            std::memcpy(&n, &s, sizeof s);
-            result ^= n;
-            return result;
+            auto const entries = std::bit_floor(std::max<std::size_t>(aSizeInBytes / sizeof(table_entry), 1u));
+            iEntries = std::make_unique<table_entry[]>(entries);
+            iMask = entries - 1u;
+            iGeneration = 0u;
         }
+        void clear()
+        {
+            for (std::size_t i = 0u; i <= iMask; ++i)
+            {
+                iEntries[i].signature.store(zobrist::hash_t{}, std::memory_order_relaxed);
+                iEntries[i].data.store(0ull, std::memory_order_relaxed);
+                iEntries[i].score.store(0ull, std::memory_order_relaxed);
+            }
+            iGeneration = 0u;
+        }
+        void new_search()
+        {
+            iGeneration = (iGeneration + 1u) & GENERATION_MASK;
+        }
+        std::optional<table_hit> probe(zobrist::hash_t aHash, std::int32_t aDistance) const
+        {
+            auto const& entry = iEntries[aHash & iMask];
+            auto const data = entry.data.load(std::memory_order_relaxed);
+            auto const score = entry.score.load(std::memory_order_relaxed);
+            if ((entry.signature.load(std::memory_order_relaxed) ^ data ^ score) != aHash || data == 0ull)
+                return {};
+            return table_hit{
+                mate_score_from_table(std::bit_cast<double>(score), aDistance),
+                static_cast<std::int32_t>(static_cast<std::int8_t>(data & 0xFFu)),
+                static_cast<table_bound>((data >> 8u) & 0x3u),
+                static_cast<table_move>((data >> 16u) & 0xFFFFu) };
+        }
+        void store(zobrist::hash_t aHash, std::int32_t aDepth, std::int32_t aDistance, table_bound aBound, double aScore, table_move aBestMove)
+        {
+            auto& entry = iEntries[aHash & iMask];
+            auto const existingData = entry.data.load(std::memory_order_relaxed);
+            bool const samePosition = ((entry.signature.load(std::memory_order_relaxed) ^ existingData ^ entry.score.load(std::memory_order_relaxed)) == aHash);
+            if (existingData != 0ull && !samePosition && aBound != table_bound::Exact)
+            {
+                // depth preferred replacement; entries from earlier searches always give way
+                auto const existingDepth = static_cast<std::int32_t>(static_cast<std::int8_t>(existingData & 0xFFu));
+                auto const existingGeneration = static_cast<std::uint32_t>((existingData >> 10u) & GENERATION_MASK);
+                if (existingGeneration == iGeneration && existingDepth > aDepth)
+                    return;
+            }
+            if (aBestMove == table_move{} && samePosition)
+                aBestMove = static_cast<table_move>((existingData >> 16u) & 0xFFFFu);
+            auto const data =
+                static_cast<std::uint64_t>(static_cast<std::uint8_t>(static_cast<std::int8_t>(std::clamp(aDepth, -128, 127)))) |
+                (static_cast<std::uint64_t>(aBound) << 8u) |
+                (static_cast<std::uint64_t>(iGeneration) << 10u) |
+                (static_cast<std::uint64_t>(aBestMove) << 16u);
+            auto const score = std::bit_cast<std::uint64_t>(mate_score_to_table(aScore, aDistance));
+            entry.signature.store(aHash ^ data ^ score, std::memory_order_relaxed);
+            entry.data.store(data, std::memory_order_relaxed);
+            entry.score.store(score, std::memory_order_relaxed);
+        }
+    private:
+        static constexpr std::uint32_t GENERATION_MASK = 0x3Fu;
+        std::unique_ptr<table_entry[]> iEntries;
+        std::size_t iMask = 0u;
+        std::uint32_t iGeneration = 0u;
     };
-
-    std::size_t constexpr DEFAULT_TABLE_SIZE = 1000000000 / sizeof(table_entry);
-
-    typedef std::vector<table_entry> table;
 }
\ No newline at end of file
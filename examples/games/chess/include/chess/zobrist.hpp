@@ -19,9 +19,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <cstdint>
+#include <array>
 #include <random>
 
-#include <chess/position.hpp>
+#include <chess/piece.hpp>
+#include <chess/player.hpp>
 
 namespace chess::zobrist
 {
@@ -142,35 +144,12 @@ namespace chess::zobrist
 
     typedef bitstring_t hash_t;
 
-    inline hash_t hash(bitboard_position const& aBoard)
+    inline hash_t piece_key(std::size_t aSquare, piece aPiece)
     {
-        hash_t hash = 0ull;
-
-        for (std::size_t sq = 0u; sq < SQUARES; ++sq)
-            if (aBoard.rep.bySquare[sq] != piece::None)
-                hash ^= get_keys().pieces[sq][to_index(to_piece_index(aBoard.rep.bySquare[sq]))];
-
-        if (aBoard.turn == player::Black)
-            hash ^= get_keys().blackToMove;
-
-        // todo: en passant and castling
-
-        return hash;
+        if (aPiece == piece::None)
+            return hash_t{};
+        return get_keys().pieces[aSquare][to_index(to_piece_index(aPiece))];
     }
 
-    inline hash_t hash(mailbox_position const& aBoard)
-    {
-        hash_t hash = 0ull;
-
-        for (std::size_t sq = 0u; sq < SQUARES; ++sq)
-            if (aBoard.rep[sq / 8u][sq % 8u] != piece::None)
-                hash ^= get_keys().pieces[sq][to_index(to_piece_index(aBoard.rep[sq / 8u][sq % 8u]))];
-
-        if (aBoard.turn == player::Black)
-            hash ^= get_keys().blackToMove;
-
-        // todo: en passant and castling
-
-        return hash;
-    }
+    // hash(basic_position) is in position.hpp next to make() and unmake() which update it incrementally
 }
\ No newline at end of file
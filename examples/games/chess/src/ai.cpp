@@ -67,15 +67,15 @@ namespace chess
     }
 
     template <typename Representation, player Player>
-    ai<Representation, Player>::ai(int32_t aPly) :
+    ai<Representation, Player>::ai(int32_t aPly, std::size_t aTableSize, uint32_t aThreads) :
         async_thread{ "chess::ai" },
         iPly{ aPly },
         iMoveTables{ generate_move_tables<representation_type>() },
         iPosition{ chess::setup_position<representation_type>() },
-        iTable{ DEFAULT_TABLE_SIZE, table_entry{} }
+        iTable{ aTableSize }
     {
-        for (unsigned int t = 1u; t <= std::thread::hardware_concurrency(); ++t)
-            iThreads.emplace_back(*this, iPly);
+        for (uint32_t t = 1u; t <= std::max(aThreads, 1u); ++t)
+            iThreads.emplace_back(iTable, iPly);
         start();
         Decided([&](move const& aBestMove)
         {
@@ -210,18 +210,29 @@ namespace chess
         // todo: opening book and/or sensible white first move...
         if (children.size() > 0u)
         {
-            std::vector<game_tree_node> bestMoves;
+            // every thread searches the whole root (Lazy SMP); the first thread's result is the one played,
+            // the others exist to fill the shared transposition table ahead of it
+            std::vector<move> rootMoves;
+            rootMoves.reserve(children.size());
+            for (auto const& child : children)
+                rootMoves.push_back(*child.move);
             std::vector<std::future<game_tree_node>> futures;
-            futures.reserve(children.size());
-            auto iterThread = iThreads.begin();
-            for (auto& child : children)
+            futures.reserve(iThreads.size());
+            uint32_t helper = 0u;
+            for (auto& thread : iThreads)
             {
-                futures.emplace_back(iterThread->eval(iPosition, std::move(child)).get_future());
-                if (++iterThread == iThreads.end())
-                    iterThread = iThreads.begin();
+                game_tree_node root;
+                root.children.emplace();
+                if (helper == 0u)
+                    *root.children = std::move(children);
+                else
+                    for (auto const& rootMove : rootMoves)
+                        root.children->emplace_back(rootMove);
+                futures.push_back(thread.eval(iPosition, std::move(root), helper++));
             }
             
             sNodeCounter = 0;
+            iTable.new_search();
             iNodesPerSecond = std::nullopt;
             iStartTime = std::chrono::steady_clock::now();
 
@@ -230,8 +241,12 @@ namespace chess
             for (auto& t : iThreads)
                 t.start();
             
-            for (auto& future : futures)
-                bestMoves.push_back(std::move(future.get()));
+            auto result = futures[0].get();
+            for (auto thread = std::next(iThreads.begin()); thread != iThreads.end(); ++thread)
+                thread->stop();
+            for (auto future = std::next(futures.begin()); future != futures.end(); ++future)
+                (void)future->get();
+            auto& bestMoves = *result.children;
 
             lk.lock();
             iNodesPerSecond = nodes_per_second();
@@ -38,6 +38,12 @@ namespace chess
         return tGameState;
     }
 
+    inline transposition_table*& transpositions()
+    {
+        thread_local transposition_table* tTable = nullptr;
+        return tTable;
+    }
+
     double constexpr ALPHA = -std::numeric_limits<double>::infinity();
     double constexpr BETA = std::numeric_limits<double>::infinity();
     double constexpr EPSILON = std::numeric_limits<double>::epsilon();
@@ -49,6 +55,127 @@ namespace chess
     constexpr std::size_t STACK_NODE_STACK_CAPACITY = 32; // todo: what should this hard limit be?
     struct stack_node_stack_limit_exceeded : std::logic_error { stack_node_stack_limit_exceeded() : std::logic_error{ "chess::stack_node_stack_limit_exceeded" } {} };
 
+    // move ordering keys: hash move, then captures and promotions (MVV-LVA), then killers, then quiet moves by history
+    constexpr int32_t HASH_MOVE_KEY = 0x40000000;
+    constexpr int32_t CAPTURE_KEY = 0x20000000;
+    constexpr int32_t KILLER_KEY = 0x10000000;
+    constexpr std::size_t KILLER_PLY = 64;
+    constexpr std::array<int32_t, PIECE_TYPES> ORDERING_VALUES = { 1, 3, 3, 5, 9, 10 };
+
+    struct search_heuristics
+    {
+        std::array<std::array<table_move, 2>, KILLER_PLY> killers;
+        std::array<std::array<std::array<int32_t, SQUARES>, SQUARES>, PIECE_COLORS> history;
+        std::deque<std::vector<int32_t>> keys;
+        std::deque<game_tree_node> scratch;
+    };
+
+    inline search_heuristics& heuristics()
+    {
+        thread_local search_heuristics tHeuristics = {};
+        return tHeuristics;
+    }
+
+    inline void new_search_heuristics()
+    {
+        auto& h = heuristics();
+        for (auto& killers : h.killers)
+            killers.fill(table_move{});
+        // keep what was learnt last move but let this search outweigh it
+        for (auto& byColor : h.history)
+            for (auto& byFrom : byColor)
+                for (auto& value : byFrom)
+                    value /= 2;
+    }
+
+    // deque so that references to shallower entries survive deeper entries being added
+    template <typename T>
+    inline T& at_distance(std::deque<T>& aStack, int32_t aDistance)
+    {
+        auto const index = static_cast<std::size_t>(aDistance);
+        if (aStack.size() <= index)
+            aStack.resize(index + 1u);
+        return aStack[index];
+    }
+
+    inline bool quiet(move const& aMove)
+    {
+        return !(aMove.isCapture && *aMove.isCapture) && !aMove.promoteTo;
+    }
+
+    template <typename Representation>
+    inline bool quiet(basic_position<Representation> const& position, table_move aMove)
+    {
+        auto const from = table_move_from(aMove);
+        auto const to = table_move_to(aMove);
+        return !table_move_promotes(aMove) && piece_at(position.rep, to) == piece::None &&
+            !(piece_type(piece_at(position.rep, from)) == piece::Pawn && from.x != to.x);
+    }
+
+    template <player Turn, typename Representation>
+    inline int32_t ordering_key(basic_position<Representation> const& position, move const& aMove, table_move hashMove, int32_t distance)
+    {
+        if (same_move(hashMove, aMove))
+            return HASH_MOVE_KEY;
+        if (!quiet(aMove))
+        {
+            auto const attacker = piece_at(position.rep, aMove.from);
+            auto const victim = piece_at(position.rep, aMove.to);
+            auto const victimValue = victim != piece::None ? ORDERING_VALUES[as_cardinal(victim)] :
+                (aMove.isCapture && *aMove.isCapture) ? ORDERING_VALUES[as_cardinal(piece::Pawn)] : 0; // en passant
+            auto const promotionValue = aMove.promoteTo ? ORDERING_VALUES[as_cardinal(*aMove.promoteTo)] : 0;
+            return CAPTURE_KEY + (victimValue + promotionValue) * 16 - ORDERING_VALUES[as_cardinal(attacker)];
+        }
+        auto const& h = heuristics();
+        if (static_cast<std::size_t>(distance) < KILLER_PLY)
+        {
+            if (same_move(h.killers[distance][0], aMove))
+                return KILLER_KEY + 1;
+            if (same_move(h.killers[distance][1], aMove))
+                return KILLER_KEY;
+        }
+        return h.history[as_cardinal(Turn)][bit_position_from_coordinates(aMove.from)][bit_position_from_coordinates(aMove.to)];
+    }
+
+    template <player Turn>
+    inline void update_heuristics(move const& aMove, int32_t depth, int32_t distance)
+    {
+        if (!quiet(aMove))
+            return;
+        auto& h = heuristics();
+        auto const cutoff = to_table_move(aMove);
+        if (static_cast<std::size_t>(distance) < KILLER_PLY && h.killers[distance][0] != cutoff)
+        {
+            h.killers[distance][1] = h.killers[distance][0];
+            h.killers[distance][0] = cutoff;
+        }
+        auto& history = h.history[as_cardinal(Turn)][bit_position_from_coordinates(aMove.from)][bit_position_from_coordinates(aMove.to)];
+        history = std::min(history + depth * depth, KILLER_KEY - 1);
+    }
+
+    // moves [aFirst, aMoves.size()) are scored once; the picker then selects the best remaining move
+    // each time so that a cutoff leaves the rest of the list unsorted
+    template <player Turn, typename Representation>
+    inline void score_moves(basic_position<Representation> const& position, std::vector<game_tree_node> const& aMoves, std::vector<int32_t>& aKeys, std::size_t aFirst, table_move hashMove, int32_t distance)
+    {
+        aKeys.resize(aMoves.size());
+        for (auto i = aFirst; i < aMoves.size(); ++i)
+            aKeys[i] = ordering_key<Turn>(position, *aMoves[i].move, hashMove, distance);
+    }
+
+    inline void pick_move(std::vector<game_tree_node>& aMoves, std::vector<int32_t>& aKeys, std::size_t aIndex)
+    {
+        auto best = aIndex;
+        for (auto i = aIndex + 1u; i < aMoves.size(); ++i)
+            if (aKeys[i] > aKeys[best])
+                best = i;
+        if (best != aIndex)
+        {
+            std::swap(aMoves[aIndex], aMoves[best]);
+            std::swap(aKeys[aIndex], aKeys[best]);
+        }
+    }
+
     template <player Player, player Turn, typename Representation>
     double minimax(move_tables<Representation> const& tables, basic_position<Representation>& position, game_tree_node& node, int32_t ply, int32_t depth)
     {
@@ -108,32 +235,48 @@ namespace chess
     }
 
     template <player Player, player Turn, typename Representation>
-    double quiesce(move_tables<Representation> const& tables, basic_position<Representation>& position, game_tree_node& node, int32_t ply, int32_t depth, double alpha = ALPHA, double beta = BETA)
+    double quiesce(move_tables<Representation> const& tables, basic_position<Representation>& position, int32_t ply, int32_t depth, double alpha = ALPHA, double beta = BETA)
     {
         if (state().stopped)
             return 0.0;
 
         ++sNodeCounter;
 
-        double stand_pat = eval<Representation, Turn>{}(tables, position, static_cast<double>(ply - depth)).eval;
+        auto const distance = ply - depth;
+        if (auto const hit = transpositions()->probe(position.hash, distance))
+        {
+            // any searched entry is at least as deep as quiescence
+            if (hit->depth >= 0)
+            {
+                if (hit->bound == table_bound::Exact)
+                    return std::clamp(hit->score, alpha, beta);
+                if (hit->bound == table_bound::Lower && hit->score >= beta)
+                    return beta;
+                if (hit->bound == table_bound::Upper && hit->score <= alpha)
+                    return alpha;
+            }
+        }
+
+        double stand_pat = eval<Representation, Turn>{}(tables, position, static_cast<double>(distance)).eval;
         if (depth == MAX_QUIESCE)
             return stand_pat;
         if (stand_pat >= beta)
             return beta;
         if (alpha < stand_pat)
             alpha = stand_pat;
-        if (node.children == std::nullopt)
-            node.children.emplace();
-        valid_moves<Turn>(tables, position, node);
-        auto& validMoves = *node.children;
-        // todo: sort by capture value may improve performance?
-        for (auto& child : validMoves)
+        auto& captures = at_distance(heuristics().scratch, distance);
+        if (captures.children == std::nullopt)
+            captures.children.emplace();
+        valid_moves<Turn, move_generation::Captures>(tables, position, captures);
+        auto& validMoves = *captures.children;
+        auto& keys = at_distance(heuristics().keys, distance);
+        score_moves<Turn>(position, validMoves, keys, 0u, table_move{}, distance);
+        for (std::size_t index = 0u; index < validMoves.size(); ++index)
         {
-            auto const& move = *child.move;
-            if (!*move.isCapture)
-                continue;
+            pick_move(validMoves, keys, index);
+            auto const& move = *validMoves[index].move;
             make(position, move);
-            auto score = -quiesce<Player, opponent_v<Turn>>(tables, position, child, ply, depth - 1, -beta, -alpha);
+            auto score = -quiesce<Player, opponent_v<Turn>>(tables, position, ply, depth - 1, -beta, -alpha);
             unmake(position);
             if (score >= beta)
                 return beta;
@@ -165,22 +308,69 @@ namespace chess
             stackNodeStack.resize(stackStackIndex + 1);
         }
         auto& use = (useStack ? stackNodeStack[stackStackIndex] : node);
-        if (use.children == std::nullopt)
+        auto const alphaOriginal = alpha;
+        table_move hashMove = {};
+        if (auto const hit = transpositions()->probe(position.hash, stackUsageDepth))
         {
-            use.children.emplace();
-            valid_moves<Turn>(tables, position, use);
+            hashMove = hit->bestMove;
+            if (hit->depth >= depth)
+            {
+                if (hit->bound == table_bound::Exact)
+                    return -*(use.eval = -hit->score);
+                if (hit->bound == table_bound::Lower)
+                    alpha = std::max(alpha, hit->score);
+                else if (hit->bound == table_bound::Upper)
+                    beta = std::min(beta, hit->score);
+                if (alpha >= beta)
+                    return -*(use.eval = -hit->score);
+            }
+        }
+        if (depth == 0)
+            return quiesce<Player, Turn>(tables, position, ply, depth - 1);
+        // Nodes on the stack are regenerated every visit so their moves are generated in stages: captures
+        // first and quiet moves only if no capture cuts off. Tree nodes keep their moves between iterations
+        // so they are generated whole. A hash move is usually quiet; when there is one, skip the staging
+        // so that it is still searched first.
+        bool quietsPending = false;
+        if (use.children == std::nullopt || useStack)
+        {
+            if (use.children == std::nullopt)
+                use.children.emplace();
+            if (useStack && (hashMove == table_move{} || !quiet(position, hashMove)))
+            {
+                valid_moves<Turn, move_generation::Captures>(tables, position, use);
+                quietsPending = true;
+            }
+            else
+                valid_moves<Turn>(tables, position, use);
         }
-        else if (useStack)
-            valid_moves<Turn>(tables, position, use);
         auto& validMoves = *use.children;
-        if (depth == 0 || validMoves.empty())
-            return quiesce<Player, Turn>(tables, position, node, ply, depth - 1);
-        for (auto& child : validMoves)
+        auto const distance = stackUsageDepth;
+        auto& keys = at_distance(heuristics().keys, distance);
+        score_moves<Turn>(position, validMoves, keys, 0u, hashMove, distance);
+        table_move bestMove = {};
+        for (std::size_t index = 0u;; ++index)
         {
+            if (index == validMoves.size())
+            {
+                if (!quietsPending)
+                    break;
+                quietsPending = false;
+                auto& quiets = at_distance(heuristics().scratch, distance);
+                if (quiets.children == std::nullopt)
+                    quiets.children.emplace();
+                valid_moves<Turn, move_generation::Quiets>(tables, position, quiets);
+                std::move(quiets.children->begin(), quiets.children->end(), std::back_inserter(validMoves));
+                score_moves<Turn>(position, validMoves, keys, index, hashMove, distance);
+                if (index == validMoves.size())
+                    break;
+            }
+            pick_move(validMoves, keys, index);
+            auto& child = validMoves[index];
             double score;
             auto const& move = *child.move;
             make(position, move);
-            if (&child == &validMoves[0])
+            if (index == 0u)
                 score = -pvs<Player, opponent_v<Turn>>(tables, position, child, ply, depth - 1, -beta, -alpha);
             else
             {
@@ -190,20 +380,40 @@ namespace chess
             }
             unmake(position);
             if (score >= beta)
+            {
+                if (!state().stopped)
+                {
+                    update_heuristics<Turn>(move, depth, distance);
+                    transpositions()->store(position.hash, depth, distance, table_bound::Lower, beta, to_table_move(move));
+                }
                 return -*(use.eval = -beta);
+            }
             if (score > alpha)
+            {
                 alpha = score;
+                bestMove = to_table_move(move);
+            }
         }
+        if (validMoves.empty())
+            return quiesce<Player, Turn>(tables, position, ply, depth - 1);
+        if (!state().stopped)
+            transpositions()->store(position.hash, depth, distance, alpha > alphaOriginal ? table_bound::Exact : table_bound::Upper, alpha, bestMove);
         return -*(use.eval = -alpha);
     }
 
     template <player Player, typename Representation>
-    void search(move_tables<Representation> const& tables, basic_position<Representation>& position, game_tree_node& node, int32_t ply)
+    void search(move_tables<Representation> const& tables, basic_position<Representation>& position, game_tree_node& node, int32_t ply, uint32_t helper)
     {
+        // Lazy SMP: every thread searches the whole root. Helpers start on a different root move and
+        // odd helpers run one ply ahead so the shared transposition table fills with work the main
+        // thread (helper 0) is about to need.
+        auto& candidateMoves = *node.children;
+        if (helper != 0u && !candidateMoves.empty())
+            std::rotate(candidateMoves.begin(), std::next(candidateMoves.begin(), helper % candidateMoves.size()), candidateMoves.end());
+        int32_t const stagger = static_cast<int32_t>(helper % 2u);
         // iterative deepening
-        for (int32_t plyIteration = 1; plyIteration <= ply; ++plyIteration)
+        for (int32_t plyIteration = 1 + stagger; plyIteration <= ply + stagger; ++plyIteration)
         {
-            auto& candidateMoves = *node.children;
             for (auto& candidateMove : candidateMoves)
             {
                 make(position, *candidateMove.move);
@@ -216,12 +426,14 @@ namespace chess
                             return m1.eval > m2.eval;
                         });
             }
+            if (state().stopped)
+                return;
         }
     }
         
     template <typename Representation, player Player>
-    ai_thread<Representation, Player>::ai_thread(i_player const& aPlayer, int32_t aPly) :
-        iPlayer{ aPlayer },
+    ai_thread<Representation, Player>::ai_thread(transposition_table& aTable, int32_t aPly) :
+        iTable{ aTable },
         iPly{ aPly },
         iMoveTables{ generate_move_tables<representation_type>() },
         iThread{ [&]() { process(); } }
@@ -240,13 +452,11 @@ namespace chess
     }
 
     template <typename Representation, player Player>
-    std::promise<game_tree_node>& ai_thread<Representation, Player>::eval(position_type const& aPosition, game_tree_node&& aNode)
+    std::future<game_tree_node> ai_thread<Representation, Player>::eval(position_type const& aPosition, game_tree_node&& aNode, uint32_t aHelper)
     {
-        {
-            std::lock_guard<std::mutex> lk{ iMutex };
-            iQueue.emplace_back(aPosition, *aNode.move, std::move(aNode));
-        }
-        return iQueue.back().result;
+        std::lock_guard<std::mutex> lk{ iMutex };
+        iQueue.emplace_back(aPosition, std::move(aNode), aHelper);
+        return iQueue.back().result.get_future();
     }
 
     template <typename Representation, player Player>
@@ -281,47 +491,31 @@ namespace chess
     void ai_thread<Representation, Player>::process()
     {
         iGameState.store(&state());
+        transpositions() = &iTable;
 
         for (;;)
         {
-            std::unique_lock<std::mutex> lk{ iMutex };
-            iSignal.wait(lk, [&]() { return state().finished || !iQueue.empty(); });
-            
-            if (state().finished)
-                return;
-
-            std::map<position_type, game_tree_node> work;
-            
-            for (auto& workItem : iQueue)
+            std::deque<work_item> work;
             {
-                if (work[workItem.position].children == std::nullopt)
-                    work[workItem.position].children.emplace();
-                work[workItem.position].children->push_back(std::move(workItem.node));
-            }
-            
-            auto& evalPosition = eval_board<Representation>();
-            
-            for (auto& workGroup : work)
-            {
-                evalPosition = workGroup.first;
+                std::unique_lock<std::mutex> lk{ iMutex };
+                iSignal.wait(lk, [&]() { return state().finished || !iQueue.empty(); });
+
+                if (state().finished)
+                    return;
 
-                iHash = zobrist::hash(evalPosition);
+                work.swap(iQueue);
+            }
 
-                auto& node = workGroup.second;
-                search<Player>(iMoveTables, evalPosition, node, iPly);
+            auto& evalPosition = eval_board<Representation>();
 
-                for (auto& workItem : iQueue)
-                {
-                    if (workGroup.first == workItem.position)
-                    {
-                        for (auto& childNode : *node.children)
-                            if (workItem.move == childNode.move)
-                                workItem.result.set_value(std::move(childNode));
-                    }
-                }
+            for (auto& workItem : work)
+            {
+                evalPosition = workItem.position;
+                evalPosition.hash = zobrist::hash(evalPosition);
+                new_search_heuristics();
+                search<Player>(iMoveTables, evalPosition, workItem.node, iPly, workItem.helper);
+                workItem.result.set_value(std::move(workItem.node));
             }
-            
-            iQueue.clear();
         }
     }
 
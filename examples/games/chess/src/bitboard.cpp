@@ -62,32 +62,137 @@ namespace chess
         return position;
     }
 
+    namespace
+    {
+        typedef std::array<std::pair<int32_t, int32_t>, 4> directions;
+
+        directions constexpr BISHOP_DIRECTIONS = {{ { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } }};
+        directions constexpr ROOK_DIRECTIONS = {{ { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } }};
+
+        bool on_board(int32_t x, int32_t y)
+        {
+            return x >= 0 && x <= 7 && y >= 0 && y <= 7;
+        }
+
+        bitboard bit_at(int32_t x, int32_t y)
+        {
+            return on_board(x, y) ? bit_from_coordinates({ static_cast<coordinate>(x), static_cast<coordinate>(y) }) : 0ull;
+        }
+
+        bitboard ray_attacks(bit_position aSquare, bitboard aOccupancy, directions const& aDirections)
+        {
+            bitboard result = 0ull;
+            auto const origin = coordinates_from_bit_position(aSquare).as<int32_t>();
+            for (auto const& [dx, dy] : aDirections)
+                for (int32_t x = origin.x + dx, y = origin.y + dy; on_board(x, y); x += dx, y += dy)
+                {
+                    result |= bit_at(x, y);
+                    if (aOccupancy & bit_at(x, y))
+                        break;
+                }
+            return result;
+        }
+
+        void generate_magics(move_tables<bitboard_rep>::slider_magics& aMagics, std::vector<bitboard>& aAttacks, directions const& aDirections)
+        {
+            // fixed seed so every thread's tables come out the same
+            std::mt19937_64 rand64{ 0x6E656F676678ull };
+            std::vector<bitboard> occupancies;
+            std::vector<bitboard> references;
+            std::vector<bitboard> candidate;
+            std::vector<bool> used;
+            for (bit_position sq = 0u; sq < SQUARES; ++sq)
+            {
+                auto const origin = coordinates_from_bit_position(sq);
+                bitboard const rankEdges = (0xFFull | 0xFF00000000000000ull) & ~(0xFFull << (origin.y * 8u));
+                bitboard const fileEdges = (0x0101010101010101ull | 0x8080808080808080ull) & ~(0x0101010101010101ull << origin.x);
+                auto& magic = aMagics[sq];
+                magic.mask = ray_attacks(sq, 0ull, aDirections) & ~(rankEdges | fileEdges);
+                auto const bits = static_cast<uint32_t>(std::popcount(magic.mask));
+                magic.shift = 64u - bits;
+                magic.offset = static_cast<uint32_t>(aAttacks.size());
+                occupancies.clear();
+                references.clear();
+                bitboard occupancy = 0ull;
+                do
+                {
+                    occupancies.push_back(occupancy);
+                    references.push_back(ray_attacks(sq, occupancy, aDirections));
+                    occupancy = (occupancy - magic.mask) & magic.mask;
+                } while (occupancy != 0ull);
+                auto const size = std::size_t{ 1u } << bits;
+                for (bool found = false; !found;)
+                {
+                    magic.magic = rand64() & rand64() & rand64();
+                    if (std::popcount((magic.mask * magic.magic) & 0xFF00000000000000ull) < 6)
+                        continue;
+                    candidate.assign(size, 0ull);
+                    used.assign(size, false);
+                    found = true;
+                    for (std::size_t i = 0u; found && i < occupancies.size(); ++i)
+                    {
+                        auto const index = static_cast<std::size_t>((occupancies[i] * magic.magic) >> magic.shift);
+                        if (!used[index])
+                        {
+                            used[index] = true;
+                            candidate[index] = references[i];
+                        }
+                        else if (candidate[index] != references[i])
+                            found = false;
+                    }
+                }
+                aAttacks.insert(aAttacks.end(), candidate.begin(), candidate.end());
+            }
+        }
+
+        move_tables<bitboard_rep> create_move_tables()
+        {
+            move_tables<bitboard_rep> result = {};
+
+            for (bit_position sq = 0u; sq < SQUARES; ++sq)
+            {
+                auto const origin = coordinates_from_bit_position(sq).as<int32_t>();
+                auto const x = origin.x;
+                auto const y = origin.y;
+                result.pawnAttacks[as_cardinal<>(player::White)][sq] = bit_at(x - 1, y + 1) | bit_at(x + 1, y + 1);
+                result.pawnAttacks[as_cardinal<>(player::Black)][sq] = bit_at(x - 1, y - 1) | bit_at(x + 1, y - 1);
+                result.knightAttacks[sq] =
+                    bit_at(x + 1, y + 2) | bit_at(x + 2, y + 1) | bit_at(x + 2, y - 1) | bit_at(x + 1, y - 2) |
+                    bit_at(x - 1, y - 2) | bit_at(x - 2, y - 1) | bit_at(x - 2, y + 1) | bit_at(x - 1, y + 2);
+                for (int32_t dy = -1; dy <= 1; ++dy)
+                    for (int32_t dx = -1; dx <= 1; ++dx)
+                        if (dx != 0 || dy != 0)
+                            result.kingAttacks[sq] |= bit_at(x + dx, y + dy);
+            }
+
+            generate_magics(result.bishopMagics, result.sliderAttacks, BISHOP_DIRECTIONS);
+            generate_magics(result.rookMagics, result.sliderAttacks, ROOK_DIRECTIONS);
+
+            for (bit_position from = 0u; from < SQUARES; ++from)
+                for (bit_position to = 0u; to < SQUARES; ++to)
+                {
+                    if (from == to)
+                        continue;
+                    auto const toBit = bit_from_bit_position(to);
+                    for (auto const* sliderDirections : { &BISHOP_DIRECTIONS, &ROOK_DIRECTIONS })
+                        if (ray_attacks(from, 0ull, *sliderDirections) & toBit)
+                        {
+                            result.between[from][to] = ray_attacks(from, toBit, *sliderDirections) & ray_attacks(to, bit_from_bit_position(from), *sliderDirections);
+                            result.line[from][to] = (ray_attacks(from, 0ull, *sliderDirections) & ray_attacks(to, 0ull, *sliderDirections)) |
+                                bit_from_bit_position(from) | toBit;
+                        }
+                }
+
+            return result;
+        }
+    }
+
     template<>
     move_tables<bitboard_rep> generate_move_tables<bitboard_rep>()
     {
-        auto const mailboxMoveTables = generate_move_tables<mailbox_rep>();
-
-        move_tables<bitboard_rep> result = {};
-
-        for (std::size_t pieceColorIndex = 0u; pieceColorIndex < PIECE_COLORS; ++pieceColorIndex)
-            for (std::size_t pieceTypeIndex = 0u; pieceTypeIndex < PIECE_TYPES; ++pieceTypeIndex)
-                for (coordinate yFrom = 0u; yFrom <= 7u; ++yFrom)
-                    for (coordinate xFrom = 0u; xFrom <= 7u; ++xFrom)
-                        for (coordinate yTo = 0u; yTo <= 7u; ++yTo)
-                            for (coordinate xTo = 0u; xTo <= 7u; ++xTo)
-                            {
-                                if (mailboxMoveTables.validMoves[pieceColorIndex][pieceTypeIndex][yFrom][xFrom][yTo][xTo])
-                                    result.validMoves[pieceColorIndex][pieceTypeIndex][bit_position_from_coordinates({ xFrom, yFrom })] |= 
-                                        bit_from_coordinates({ xTo, yTo });
-                                if (mailboxMoveTables.validCaptureMoves[pieceColorIndex][pieceTypeIndex][yFrom][xFrom][yTo][xTo])
-                                    result.validCaptureMoves[pieceColorIndex][pieceTypeIndex][bit_position_from_coordinates({ xFrom, yFrom })] |= 
-                                        bit_from_coordinates({ xTo, yTo });
-                                for (std::size_t pathSquareIndex = 0; pathSquareIndex < mailboxMoveTables.movePaths[yFrom][xFrom][yTo][xTo].first; ++pathSquareIndex)
-                                    result.validPaths[bit_position_from_coordinates({ xFrom, yFrom })][bit_position_from_coordinates({ xTo, yTo })] |=
-                                        bit_from_coordinates(mailboxMoveTables.movePaths[yFrom][xFrom][yTo][xTo].second[pathSquareIndex]);
-                            }
-
-        return result;
+        // finding the magics takes a moment so do it once and hand out copies
+        static move_tables<bitboard_rep> const sMoveTables = create_move_tables();
+        return sMoveTables;
     }
 
     template <player Player>
@@ -134,8 +239,8 @@ namespace chess
                 auto playerPieces = pieces & aPosition.rep.byPieceColor[as_cardinal<>(Player)];
                 auto opponentPieces = pieces & aPosition.rep.byPieceColor[as_cardinal<>(opponent_v<Player>)];
 
-                material += std::popcount(playerPieces) * (piece_value<Player>(cardinal_to_piece(playerPieceTypeIndex)));
-                material -= std::popcount(opponentPieces) * (piece_value<opponent_v<Player>>(cardinal_to_piece(playerPieceTypeIndex)));
+                material += std::popcount(playerPieces) * (piece_value<static_cast<piece>(Player)>(cardinal_to_piece(playerPieceTypeIndex)));
+                material -= std::popcount(opponentPieces) * (piece_value<static_cast<piece>(opponent_v<Player>)>(cardinal_to_piece(playerPieceTypeIndex)));
 
                 // todo: pawn promotion value
             }
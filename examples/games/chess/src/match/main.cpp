@@ -0,0 +1,718 @@
+﻿/*
+neogfx C++ App/Game Engine - Examples - Games - Chess
+Copyright(C) 2020 Leigh Johnston
+
+This program is free software: you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Headless test suite runner: searches every position of one or more EPD/FEN suites at a fixed depth
+// and/or for a fixed time and reports nodes per second, time to depth and solved positions as JSON.
+// With --perft it instead counts the legal move tree of the standard perft positions and checks the
+// counts against their known values. Only the search is linked; no app or window is created.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <sstream>
+
+#include <chess/mailbox.hpp>
+#include <chess/bitboard.hpp>
+#include <chess/ai_thread.hpp>
+#include <chess/table.hpp>
+
+namespace chess
+{
+    extern std::atomic<uint64_t> sNodeCounter;
+
+    namespace
+    {
+        // the search keeps a fixed size stack of nodes below USE_STACK_DEPTH
+        int32_t constexpr MAX_DEPTH = 32;
+        int32_t constexpr DEFAULT_DEPTH = 4;
+
+        struct cannot_open_suite : std::runtime_error { cannot_open_suite() : std::runtime_error{ "chess::cannot_open_suite" } {} };
+        struct invalid_epd : std::runtime_error { invalid_epd() : std::runtime_error{ "chess::invalid_epd" } {} };
+
+        struct options
+        {
+            std::optional<int32_t> depth;
+            std::optional<std::chrono::milliseconds> time;
+            uint32_t threads = 1u;
+            std::size_t tableSize = DEFAULT_TABLE_SIZE;
+            bool mailbox = false;
+            bool perft = false;
+            std::optional<uint32_t> minSolved;
+            std::optional<uint64_t> maxNodes;
+            std::vector<std::string> suites;
+        };
+
+        struct test_position
+        {
+            std::string suite;
+            std::size_t line;
+            std::string id;
+            std::string fen;
+            std::vector<std::string> bestMoves;
+            std::vector<std::string> avoidMoves;
+            std::optional<int32_t> directMate;
+            std::optional<std::string> error;
+        };
+
+        struct search_result
+        {
+            std::optional<move> bestMove;
+            std::optional<double> eval;
+            int32_t depth = 0;
+            uint64_t nodes = 0ull;
+            std::chrono::duration<double> time = {};
+            std::vector<std::chrono::duration<double>> timeToDepth;
+            std::optional<bool> solved;
+            std::vector<std::string> unresolved;
+        };
+
+        void usage()
+        {
+            std::cerr << "usage: chess_match [--depth <plies>] [--time <ms>] [--threads <n>] [--table <MiB>] [--mailbox] [--min-solved <n>] [--max-nodes <n>] <suite>..." << std::endl;
+            std::cerr << "       chess_match --perft [--depth <plies>]" << std::endl;
+            std::cerr << "  each suite line is an EPD record (bm/am/dm/id operations are used) or a FEN record" << std::endl;
+            std::cerr << "  --max-nodes fails the run if the whole suite searches more nodes (a single threaded search is deterministic)" << std::endl;
+            std::cerr << "  --perft checks bitboard move generation against known perft counts up to the given depth (default: all)" << std::endl;
+        }
+
+        std::optional<options> parse_options(int argc, char* argv[])
+        {
+            options result;
+            for (int arg = 1; arg < argc; ++arg)
+            {
+                std::string const name = argv[arg];
+                auto const value = [&]() -> std::optional<uint64_t>
+                {
+                    if (arg + 1 >= argc)
+                        return {};
+                    std::string const text = argv[++arg];
+                    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+                        return {};
+                    return std::stoull(text);
+                };
+                if (name == "--mailbox")
+                    result.mailbox = true;
+                else if (name == "--perft")
+                    result.perft = true;
+                else if (name == "--depth" || name == "--time" || name == "--threads" || name == "--table" || name == "--min-solved" || name == "--max-nodes")
+                {
+                    auto const number = value();
+                    if (!number || (*number == 0ull && name != "--min-solved"))
+                        return {};
+                    if (name == "--depth")
+                    {
+                        if (*number > static_cast<uint64_t>(MAX_DEPTH))
+                            return {};
+                        result.depth = static_cast<int32_t>(*number);
+                    }
+                    else if (name == "--time")
+                        result.time = std::chrono::milliseconds{ *number };
+                    else if (name == "--threads")
+                        result.threads = static_cast<uint32_t>(*number);
+                    else if (name == "--table")
+                        result.tableSize = static_cast<std::size_t>(*number) * 1024u * 1024u;
+                    else if (name == "--max-nodes")
+                        result.maxNodes = *number;
+                    else
+                        result.minSolved = static_cast<uint32_t>(*number);
+                }
+                else if (!name.empty() && name[0] == '-')
+                    return {};
+                else
+                    result.suites.push_back(name);
+            }
+            if (result.perft)
+            {
+                // perft counts bitboard move generation only; there is nothing to search
+                if (!result.suites.empty() || result.mailbox || result.time || result.minSolved || result.maxNodes)
+                    return {};
+                return result;
+            }
+            if (result.suites.empty())
+                return {};
+            if (!result.depth && !result.time)
+                result.depth = DEFAULT_DEPTH;
+            return result;
+        }
+
+        bool is_number(std::string const& aText)
+        {
+            return !aText.empty() && aText.find_first_not_of("0123456789") == std::string::npos;
+        }
+
+        // An EPD record is the first four FEN fields followed by "opcode operand...;" operations; a FEN
+        // record has the two move clocks in place of the operations.
+        test_position parse_record(std::string const& aSuite, std::size_t aLine, std::string const& aRecord)
+        {
+            test_position result{ aSuite, aLine };
+            std::istringstream fields{ aRecord };
+            std::string placement, turn, castling, enPassant;
+            if (!(fields >> placement >> turn >> castling >> enPassant))
+                throw invalid_epd();
+            result.fen = placement + " " + turn + " " + castling + " " + enPassant;
+            std::string operations;
+            std::getline(fields, operations);
+            std::istringstream clocks{ operations };
+            std::string halfMoves, fullMoves;
+            if (clocks >> halfMoves >> fullMoves && is_number(halfMoves) && is_number(fullMoves))
+            {
+                result.fen += " " + halfMoves + " " + fullMoves;
+                operations.clear();
+                std::getline(clocks, operations);
+            }
+            std::string operation;
+            bool quoted = false;
+            auto const apply = [&]()
+            {
+                std::istringstream operands{ operation };
+                std::string opcode;
+                if (!(operands >> opcode))
+                    return;
+                std::vector<std::string> values;
+                for (std::string value; operands >> value;)
+                    values.push_back(value);
+                if (opcode == "bm")
+                    result.bestMoves = values;
+                else if (opcode == "am")
+                    result.avoidMoves = values;
+                else if (opcode == "dm" && values.size() == 1u && is_number(values[0]) && values[0].size() < 4u)
+                    result.directMate = std::stoi(values[0]);
+                else if (opcode == "id")
+                {
+                    auto const first = operation.find('"');
+                    auto const last = operation.rfind('"');
+                    result.id = (first != last ? operation.substr(first + 1u, last - first - 1u) : values.empty() ? std::string{} : values[0]);
+                }
+            };
+            for (auto const ch : operations)
+            {
+                if (ch == '"')
+                    quoted = !quoted;
+                if (ch == ';' && !quoted)
+                {
+                    apply();
+                    operation.clear();
+                }
+                else
+                    operation += ch;
+            }
+            apply();
+            if (result.id.empty())
+                result.id = aSuite + ":" + std::to_string(aLine);
+            return result;
+        }
+
+        std::vector<test_position> load_suite(std::string const& aSuite)
+        {
+            std::ifstream input{ aSuite };
+            if (!input)
+                throw cannot_open_suite();
+            std::vector<test_position> result;
+            std::size_t lineNumber = 0u;
+            for (std::string line; std::getline(input, line);)
+            {
+                ++lineNumber;
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                auto const first = line.find_first_not_of(" \t");
+                if (first == std::string::npos || line[first] == '#')
+                    continue;
+                try
+                {
+                    result.push_back(parse_record(aSuite, lineNumber, line));
+                }
+                catch (std::exception const& e)
+                {
+                    result.push_back(test_position{ aSuite, lineNumber, aSuite + ":" + std::to_string(lineNumber), line });
+                    result.back().error = e.what();
+                }
+            }
+            return result;
+        }
+
+        // Resolves a SAN (or UCI) move against the legal moves of the position.
+        template <typename Representation>
+        std::optional<move> resolve_move(basic_position<Representation> const& aPosition, std::vector<game_tree_node> const& aLegalMoves, std::string aText)
+        {
+            while (!aText.empty() && std::string{ "+#!?" }.find(aText.back()) != std::string::npos)
+                aText.pop_back();
+            auto const moving = [&](move const& aMove)
+            {
+                return piece_type(piece_at(aPosition.rep, aMove.from));
+            };
+            std::optional<move> result;
+            auto const match = [&](auto const& aPredicate) -> std::optional<move>
+            {
+                for (auto const& legal : aLegalMoves)
+                    if (aPredicate(*legal.move))
+                    {
+                        if (result)
+                            return {}; // ambiguous
+                        result = *legal.move;
+                    }
+                return result;
+            };
+            if (aText == "O-O" || aText == "0-0")
+                return match([&](move const& aMove) { return moving(aMove) == piece::King && aMove.to.x == aMove.from.x + 2u; });
+            if (aText == "O-O-O" || aText == "0-0-0")
+                return match([&](move const& aMove) { return moving(aMove) == piece::King && aMove.from.x == aMove.to.x + 2u; });
+            if ((aText.size() == 4u || aText.size() == 5u) && aText[0] >= 'a' && aText[0] <= 'h' && aText[2] >= 'a' && aText[2] <= 'h')
+            {
+                try
+                {
+                    auto const uci = parse_uci_move(aText);
+                    return match([&](move const& aMove)
+                    {
+                        return aMove.from == uci.from && aMove.to == uci.to &&
+                            (aMove.promoteTo ? uci.promoteTo && piece_type(*aMove.promoteTo) == *uci.promoteTo : !uci.promoteTo);
+                    });
+                }
+                catch (...)
+                {
+                    // not UCI; try SAN
+                }
+            }
+            try
+            {
+                piece type = piece::Pawn;
+                if (!aText.empty() && std::string{ "NBRQK" }.find(aText[0]) != std::string::npos)
+                {
+                    type = parse_piece_character(aText[0]);
+                    aText.erase(0u, 1u);
+                }
+                std::optional<piece> promotion;
+                if (auto const equals = aText.find('='); equals != std::string::npos && equals + 1u < aText.size())
+                {
+                    promotion = parse_piece_character(aText[equals + 1u]);
+                    aText.erase(equals);
+                }
+                else if (type == piece::Pawn && !aText.empty() && std::string{ "NBRQ" }.find(aText.back()) != std::string::npos)
+                {
+                    promotion = parse_piece_character(aText.back());
+                    aText.pop_back();
+                }
+                std::string squares;
+                for (auto const ch : aText)
+                    if (ch != 'x' && ch != '-' && ch != ':')
+                        squares += ch;
+                if (squares.size() < 2u || squares.size() > 4u)
+                    return {};
+                auto const toFile = squares[squares.size() - 2u];
+                auto const toRank = squares[squares.size() - 1u];
+                if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8')
+                    return {};
+                coordinates const to{ static_cast<coordinate>(toFile - 'a'), static_cast<coordinate>(toRank - '1') };
+                std::optional<coordinate> fromFile;
+                std::optional<coordinate> fromRank;
+                for (auto const ch : squares.substr(0u, squares.size() - 2u))
+                {
+                    if (ch >= 'a' && ch <= 'h')
+                        fromFile = static_cast<coordinate>(ch - 'a');
+                    else if (ch >= '1' && ch <= '8')
+                        fromRank = static_cast<coordinate>(ch - '1');
+                    else
+                        return {};
+                }
+                return match([&](move const& aMove)
+                {
+                    return moving(aMove) == type && aMove.to == to &&
+                        (!fromFile || aMove.from.x == *fromFile) && (!fromRank || aMove.from.y == *fromRank) &&
+                        (aMove.promoteTo ? promotion && piece_type(*aMove.promoteTo) == *promotion : !promotion);
+                });
+            }
+            catch (invalid_piece_character const&)
+            {
+                return {};
+            }
+        }
+
+        // eval scales a mate score down by a factor of ten for every ply between the root and the mate
+        std::optional<int32_t> mate_distance(double aEval)
+        {
+            if (!std::isfinite(aEval) || aEval <= 0.0 || !is_mate_score(aEval))
+                return {};
+            return static_cast<int32_t>(std::lround(std::log10(std::numeric_limits<double>::max() / aEval)));
+        }
+
+        template <typename Representation, player Player>
+        search_result search_position(options const& aOptions, move_tables<Representation> const& aTables, transposition_table& aTable, basic_position<Representation> aPosition, test_position const& aTest)
+        {
+            search_result result;
+            game_tree_node root;
+            root.children.emplace();
+            valid_moves<Player>(aTables, aPosition, root);
+            auto const& legalMoves = *root.children;
+
+            std::vector<move> expected;
+            std::vector<move> avoided;
+            for (auto const& text : aTest.bestMoves)
+                if (auto const resolved = resolve_move(aPosition, legalMoves, text))
+                    expected.push_back(*resolved);
+                else
+                    result.unresolved.push_back(text);
+            for (auto const& text : aTest.avoidMoves)
+                if (auto const resolved = resolve_move(aPosition, legalMoves, text))
+                    avoided.push_back(*resolved);
+                else
+                    result.unresolved.push_back(text);
+
+            if (legalMoves.empty())
+                return result;
+
+            sort_nodes<Player>(aTables, aPosition, root);
+            std::vector<move> rootMoves;
+            rootMoves.reserve(legalMoves.size());
+            for (auto const& child : legalMoves)
+                rootMoves.push_back(*child.move);
+
+            aTable.clear();
+            sNodeCounter = 0;
+            auto const start = std::chrono::steady_clock::now();
+            std::optional<std::chrono::steady_clock::time_point> deadline;
+            if (aOptions.time)
+                deadline = start + *aOptions.time;
+            for (int32_t depth = 1; depth <= aOptions.depth.value_or(MAX_DEPTH); ++depth)
+            {
+                // ai_thread searches to a fixed ply so every depth gets its own threads; the shared table
+                // keeps what the shallower depths found, as iterative deepening would
+                std::list<ai_thread<Representation, Player>> threads;
+                std::vector<std::future<game_tree_node>> futures;
+                for (uint32_t helper = 0u; helper < aOptions.threads; ++helper)
+                {
+                    game_tree_node node;
+                    node.children.emplace();
+                    for (auto const& rootMove : rootMoves)
+                        node.children->emplace_back(rootMove);
+                    futures.push_back(threads.emplace_back(aTable, depth).eval(aPosition, std::move(node), helper));
+                }
+                aTable.new_search();
+                for (auto& thread : threads)
+                    thread.start();
+                bool const completed = !deadline || futures[0].wait_until(*deadline) == std::future_status::ready;
+                for (auto& thread : threads)
+                    thread.stop();
+                auto searched = futures[0].get();
+                for (auto future = std::next(futures.begin()); future != futures.end(); ++future)
+                    (void)future->get();
+                // an interrupted depth has incomplete scores so the previous depth's answer stands
+                if (!completed)
+                    break;
+                result.timeToDepth.push_back(std::chrono::steady_clock::now() - start);
+                auto& bestMoves = *searched.children;
+                std::stable_sort(bestMoves.begin(), bestMoves.end(),
+                    [](auto const& m1, auto const& m2)
+                    {
+                        return m1.eval > m2.eval;
+                    });
+                result.depth = depth;
+                result.bestMove = *bestMoves[0].move;
+                result.eval = bestMoves[0].eval;
+                rootMoves.clear();
+                for (auto const& child : bestMoves)
+                    rootMoves.push_back(*child.move);
+            }
+            result.time = std::chrono::steady_clock::now() - start;
+            result.nodes = sNodeCounter;
+
+            if (result.bestMove && (!expected.empty() || !avoided.empty() || aTest.directMate))
+                result.solved =
+                    (expected.empty() || std::find(expected.begin(), expected.end(), *result.bestMove) != expected.end()) &&
+                    std::find(avoided.begin(), avoided.end(), *result.bestMove) == avoided.end() &&
+                    (!aTest.directMate || mate_distance(*result.eval) == *aTest.directMate * 2 - 1);
+            return result;
+        }
+
+        std::string json_string(std::string const& aText)
+        {
+            std::ostringstream result;
+            result << '"';
+            for (auto const ch : aText)
+            {
+                switch (ch)
+                {
+                case '"':
+                    result << "\\\"";
+                    break;
+                case '\\':
+                    result << "\\\\";
+                    break;
+                case '\t':
+                    result << "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20u)
+                        result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec << std::setfill(' ');
+                    else
+                        result << ch;
+                    break;
+                }
+            }
+            result << '"';
+            return result.str();
+        }
+
+        std::string json_strings(std::vector<std::string> const& aValues)
+        {
+            std::string result = "[";
+            for (auto const& value : aValues)
+                result += (result.size() > 1u ? ", " : "") + json_string(value);
+            return result + "]";
+        }
+
+        double milliseconds(std::chrono::duration<double> aDuration)
+        {
+            return std::chrono::duration<double, std::milli>{ aDuration }.count();
+        }
+
+        uint64_t nodes_per_second(uint64_t aNodes, std::chrono::duration<double> aDuration)
+        {
+            return aDuration.count() > 0.0 ? static_cast<uint64_t>(aNodes / aDuration.count()) : 0ull;
+        }
+
+        // Known leaf counts of the standard perft positions (see https://www.chessprogramming.org/Perft_Results);
+        // nodes[d - 1] is the count at depth d.
+        struct perft_reference
+        {
+            std::string name;
+            std::string fen;
+            std::vector<uint64_t> nodes;
+        };
+
+        std::vector<perft_reference> const& perft_references()
+        {
+            static std::vector<perft_reference> const sReferences =
+            {
+                { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", { 20ull, 400ull, 8902ull, 197281ull, 4865609ull } },
+                { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { 48ull, 2039ull, 97862ull, 4085603ull } },
+                { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { 14ull, 191ull, 2812ull, 43238ull, 674624ull } },
+                { "position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { 6ull, 264ull, 9467ull, 422333ull } },
+                { "position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { 44ull, 1486ull, 62379ull, 2103487ull } },
+                { "position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46ull, 2079ull, 89890ull, 3894594ull } }
+            };
+            return sReferences;
+        }
+
+        int run_perft(options const& aOptions)
+        {
+            auto const tables = generate_move_tables<bitboard_rep>();
+
+            std::ostream& out = std::cout;
+            out << std::fixed << std::setprecision(3);
+            out << "{" << std::endl;
+            out << "  \"perft\": [";
+
+            uint32_t checks = 0u;
+            uint32_t failures = 0u;
+            uint64_t totalNodes = 0ull;
+            std::chrono::duration<double> totalTime = {};
+            auto const& references = perft_references();
+            for (auto reference = references.begin(); reference != references.end(); ++reference)
+            {
+                out << (reference == references.begin() ? "" : ",") << std::endl << "    {" << std::endl;
+                out << "      \"name\": " << json_string(reference->name) << "," << std::endl;
+                out << "      \"fen\": " << json_string(reference->fen) << "," << std::endl;
+                out << "      \"depths\": [";
+                auto position = parse_fen<bitboard_rep>(reference->fen);
+                bool passed = true;
+                auto const depths = std::min<std::size_t>(reference->nodes.size(), aOptions.depth.value_or(MAX_DEPTH));
+                for (std::size_t depth = 1u; depth <= depths; ++depth)
+                {
+                    auto const start = std::chrono::steady_clock::now();
+                    auto const nodes = (position.turn == player::White ?
+                        perft<player::White>(tables, position, static_cast<int32_t>(depth)) :
+                        perft<player::Black>(tables, position, static_cast<int32_t>(depth)));
+                    auto const time = std::chrono::duration<double>{ std::chrono::steady_clock::now() - start };
+                    auto const expected = reference->nodes[depth - 1u];
+                    ++checks;
+                    if (nodes != expected)
+                    {
+                        ++failures;
+                        passed = false;
+                    }
+                    totalNodes += nodes;
+                    totalTime += time;
+                    out << (depth == 1u ? "" : ",") << std::endl;
+                    out << "        { \"depth\": " << depth << ", \"nodes\": " << nodes << ", \"expected\": " << expected <<
+                        ", \"time_ms\": " << milliseconds(time) << ", \"nps\": " << nodes_per_second(nodes, time) << " }";
+                }
+                out << std::endl << "      ]," << std::endl;
+                out << "      \"passed\": " << (passed ? "true" : "false") << std::endl;
+                out << "    }";
+                out.flush();
+            }
+            out << std::endl << "  ]," << std::endl;
+            out << "  \"summary\": {" << std::endl;
+            out << "    \"checks\": " << checks << "," << std::endl;
+            out << "    \"failures\": " << failures << "," << std::endl;
+            out << "    \"nodes\": " << totalNodes << "," << std::endl;
+            out << "    \"time_ms\": " << milliseconds(totalTime) << "," << std::endl;
+            out << "    \"nps\": " << nodes_per_second(totalNodes, totalTime) << std::endl;
+            out << "  }" << std::endl;
+            out << "}" << std::endl;
+
+            return failures == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        template <typename Representation>
+        int run(options const& aOptions)
+        {
+            std::vector<test_position> tests;
+            for (auto const& suite : aOptions.suites)
+            {
+                try
+                {
+                    auto const loaded = load_suite(suite);
+                    tests.insert(tests.end(), loaded.begin(), loaded.end());
+                }
+                catch (std::exception const& e)
+                {
+                    std::cerr << suite << ": " << e.what() << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+
+            auto const tables = generate_move_tables<Representation>();
+            transposition_table table{ aOptions.tableSize };
+
+            std::ostream& out = std::cout;
+            out << std::fixed << std::setprecision(3);
+            out << "{" << std::endl;
+            out << "  \"representation\": " << json_string(std::is_same_v<Representation, mailbox_rep> ? "mailbox" : "bitboard") << "," << std::endl;
+            out << "  \"threads\": " << aOptions.threads << "," << std::endl;
+            out << "  \"table_bytes\": " << aOptions.tableSize << "," << std::endl;
+            out << "  \"limit\": {";
+            if (aOptions.depth)
+                out << " \"depth\": " << *aOptions.depth << (aOptions.time ? "," : "");
+            if (aOptions.time)
+                out << " \"time_ms\": " << aOptions.time->count();
+            out << " }," << std::endl;
+            out << "  \"positions\": [";
+
+            uint32_t errors = 0u;
+            uint32_t scored = 0u;
+            uint32_t solved = 0u;
+            uint64_t totalNodes = 0ull;
+            std::chrono::duration<double> totalTime = {};
+            for (auto test = tests.begin(); test != tests.end(); ++test)
+            {
+                out << (test == tests.begin() ? "" : ",") << std::endl << "    {" << std::endl;
+                out << "      \"suite\": " << json_string(test->suite) << "," << std::endl;
+                out << "      \"line\": " << test->line << "," << std::endl;
+                out << "      \"id\": " << json_string(test->id) << "," << std::endl;
+                out << "      \"fen\": " << json_string(test->fen) << "," << std::endl;
+                std::optional<search_result> result;
+                if (!test->error)
+                {
+                    try
+                    {
+                        auto const position = parse_fen<Representation>(test->fen);
+                        if (position.turn == player::White)
+                            result = search_position<Representation, player::White>(aOptions, tables, table, position, *test);
+                        else
+                            result = search_position<Representation, player::Black>(aOptions, tables, table, position, *test);
+                    }
+                    catch (std::exception const& e)
+                    {
+                        test->error = e.what();
+                    }
+                }
+                if (!result)
+                {
+                    ++errors;
+                    out << "      \"error\": " << json_string(*test->error) << std::endl << "    }";
+                    continue;
+                }
+                totalNodes += result->nodes;
+                totalTime += result->time;
+                if (result->solved)
+                {
+                    ++scored;
+                    if (*result->solved)
+                        ++solved;
+                }
+                out << "      \"best_move\": " << (result->bestMove ? json_string(to_string(*result->bestMove) + (result->bestMove->promoteTo ? to_string(piece::Black | piece_type(*result->bestMove->promoteTo)) : "")) : "null") << "," << std::endl;
+                out << "      \"eval\": ";
+                if (result->eval && std::isfinite(*result->eval))
+                    out << std::defaultfloat << std::setprecision(9) << *result->eval << std::fixed << std::setprecision(3);
+                else
+                    out << "null";
+                out << "," << std::endl;
+                out << "      \"depth\": " << result->depth << "," << std::endl;
+                out << "      \"nodes\": " << result->nodes << "," << std::endl;
+                out << "      \"time_ms\": " << milliseconds(result->time) << "," << std::endl;
+                out << "      \"nps\": " << nodes_per_second(result->nodes, result->time) << "," << std::endl;
+                out << "      \"time_to_depth_ms\": [";
+                for (auto depthTime = result->timeToDepth.begin(); depthTime != result->timeToDepth.end(); ++depthTime)
+                    out << (depthTime == result->timeToDepth.begin() ? "" : ", ") << milliseconds(*depthTime);
+                out << "]," << std::endl;
+                out << "      \"bm\": " << json_strings(test->bestMoves) << "," << std::endl;
+                out << "      \"am\": " << json_strings(test->avoidMoves) << "," << std::endl;
+                if (!result->unresolved.empty())
+                    out << "      \"unresolved\": " << json_strings(result->unresolved) << "," << std::endl;
+                out << "      \"solved\": " << (result->solved ? (*result->solved ? "true" : "false") : "null") << std::endl;
+                out << "    }";
+                out.flush();
+            }
+            out << std::endl << "  ]," << std::endl;
+            out << "  \"summary\": {" << std::endl;
+            out << "    \"positions\": " << tests.size() << "," << std::endl;
+            out << "    \"errors\": " << errors << "," << std::endl;
+            out << "    \"scored\": " << scored << "," << std::endl;
+            out << "    \"solved\": " << solved << "," << std::endl;
+            out << "    \"nodes\": " << totalNodes << "," << std::endl;
+            out << "    \"time_ms\": " << milliseconds(totalTime) << "," << std::endl;
+            out << "    \"nps\": " << nodes_per_second(totalNodes, totalTime) << std::endl;
+            out << "  }" << std::endl;
+            out << "}" << std::endl;
+
+            if (errors != 0u || (aOptions.minSolved && solved < *aOptions.minSolved) || (aOptions.maxNodes && totalNodes > *aOptions.maxNodes))
+                return EXIT_FAILURE;
+            return EXIT_SUCCESS;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    auto const options = chess::parse_options(argc, argv);
+    if (!options)
+    {
+        chess::usage();
+        return 2;
+    }
+    try
+    {
+        if (options->perft)
+            return chess::run_perft(*options);
+        else if (options->mailbox)
+            return chess::run<chess::mailbox_rep>(*options);
+        else
+            return chess::run<chess::bitboard_rep>(*options);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << "chess_match: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
\ No newline at end of file
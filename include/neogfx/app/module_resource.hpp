@@ -52,6 +52,7 @@ namespace neogfx
         string iUri;
         const void* iData;
         std::size_t iSize;
+        std::optional<std::vector<uint8_t>> iWritableData;
         mutable std::optional<data_type> iHash;
     };
 }
\ No newline at end of file
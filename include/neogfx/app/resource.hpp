@@ -21,6 +21,7 @@
 
 #include <neogfx/neogfx.hpp>
 #include <optional>
+#include <memory>
 #include <neogfx/core/event.hpp>
 #include <neogfx/app/i_resource.hpp>
 #include <neogfx/app/i_resource_manager.hpp>
@@ -53,12 +54,19 @@ namespace neogfx
         void* data() override;
         std::size_t size() const override;
         hash_digest_type const& hash() const override;
+    public:
+        static void clear_archive_indices();
+    private:
+        std::size_t loaded_size() const;
+    private:
+        struct mapped_file;
     private:
         i_resource_manager& iManager;
         string iUri;
         std::optional<string> iError;
         std::size_t iSize;
         data_type iData;
+        std::unique_ptr<mapped_file> iMappedFile;
         mutable std::optional<data_type> iHash;
     };
 }
\ No newline at end of file
@@ -45,6 +45,7 @@ namespace neogfx
         void set_envelope(adsr_envelope const& aEnvelope) final;
     protected:
         float apply_envelope(audio_sample_index aIndex, audio_sample_count aLength) const;
+        void apply_envelope(audio_sample_index aIndex, audio_sample_count aLength, float* aSamples, audio_sample_count aSampleCount) const;
     private:
         audio_sample_rate iSampleRate;
         float iAmplitude;
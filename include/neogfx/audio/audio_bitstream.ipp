@@ -113,4 +113,51 @@ namespace neogfx
             return mix(amplitude() * envelope().sustain, 0.0f, static_cast<float>(aIndex) / release);
         return 0.0f;
     }
+
+    template <typename Interface>
+    inline void audio_bitstream<Interface>::apply_envelope(audio_sample_index aIndex, audio_sample_count aLength, float* aSamples, audio_sample_count aSampleCount) const
+    {
+        if (!has_envelope())
+        {
+            for (audio_sample_count i = 0; i < aSampleCount; ++i)
+                aSamples[i] *= amplitude();
+            return;
+        }
+        // The envelope is piecewise linear so walk its segments, ramping the gain by a constant step within each,
+        // rather than evaluating it per sample.
+        auto const length = static_cast<std::int64_t>(aLength);
+        auto const attackEnd = std::min(static_cast<std::int64_t>(envelope().attack * sample_rate()), length);
+        auto const decayEnd = std::min(attackEnd + static_cast<std::int64_t>(envelope().decay * sample_rate()), length);
+        auto const releaseStart = std::max(decayEnd, length - static_cast<std::int64_t>(envelope().release * sample_rate()));
+        auto const sustain = amplitude() * envelope().sustain;
+        struct segment
+        {
+            std::int64_t begin;
+            std::int64_t end;
+            float from;
+            float to;
+        };
+        segment const segments[] =
+        {
+            { 0, attackEnd, 0.0f, amplitude() },
+            { attackEnd, decayEnd, amplitude(), sustain },
+            { decayEnd, releaseStart, sustain, sustain },
+            { releaseStart, length, sustain, 0.0f }
+        };
+        auto const first = static_cast<std::int64_t>(aIndex);
+        auto const last = first + static_cast<std::int64_t>(aSampleCount);
+        for (auto const& s : segments)
+        {
+            auto const begin = std::max(s.begin, first);
+            auto const end = std::min(s.end, last);
+            if (begin >= end)
+                continue;
+            auto const step = (s.to - s.from) / static_cast<float>(s.end - s.begin);
+            auto gain = s.from + step * static_cast<float>(begin - s.begin);
+            for (auto i = begin; i < end; ++i, gain += step)
+                aSamples[i - first] *= gain;
+        }
+        for (auto i = std::max(length, first); i < last; ++i)
+            aSamples[i - first] = 0.0f;
+    }
 }
\ No newline at end of file
@@ -18,6 +18,8 @@
 */
 
 #include <neogfx/neogfx.hpp>
+#include <array>
+#include <atomic>
 #include <neogfx/audio/i_audio.hpp>
 #include <neogfx/audio/i_audio_device.hpp>
 #include <neogfx/audio/i_audio_bitstream.hpp>
@@ -49,8 +51,37 @@ namespace neogfx
 
 	class audio_device : public reference_counted<i_audio_device>
 	{
+	public:
+		struct command_queue_full : std::runtime_error { command_queue_full() : std::runtime_error("neogfx::audio_device::command_queue_full") {} };
+	public:
+		static constexpr std::size_t MaxSources = 256;
+		static constexpr std::size_t CommandQueueCapacity = 1024;
+	private:
+		enum class command_type
+		{
+			Add,
+			Remove
+		};
+		struct command
+		{
+			command_type type;
+			i_audio_bitstream* bitstream;
+			audio_frame_count frames;
+			float leftGain;
+			float rightGain;
+		};
+		struct source
+		{
+			i_audio_bitstream* bitstream;
+			audio_frame_count framesRemaining;
+			float leftGain;
+			float rightGain;
+		};
 	public:
 		audio_device(audio_context aContext, i_audio_device_info const& aDeviceInfo, audio_data_format const& aDataFormat);
+		// A playback device on the null backend: no hardware is opened and the callback is driven in real time by
+		// a thread of the backend's own. For testing.
+		audio_device(audio_data_format const& aDataFormat);
 		~audio_device();
 	public:
 		i_audio_device_info const& info() const final;
@@ -60,17 +91,29 @@ namespace neogfx
 		void stop() final;
 	public:
 		void play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration) final;
+		void play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration, float aGain, float aPan) final;
+		void stop(i_audio_bitstream& aBitstream) final;
+	private:
+		void init(audio_context aContext);
+		void push_command(command const& aCommand);
+		void apply_commands();
+		void mix(float* aOutput, audio_frame_count aFrameCount);
 	private:
-		mutable std::recursive_mutex iMutex;
 		audio_device_info iInfo;
 		audio_data_format iDataFormat;
+		audio_context iOwnContext; ///< Only a null backend device has a context of its own.
 		audio_device_config iConfig;
 		audio_device_handle iHandle;
-		struct source
-		{
-			ref_ptr<i_audio_bitstream> bitstream; // todo: should be i_audio_bitstream
-			std::optional<std::chrono::steady_clock::time_point> expiryTime;
-		};
+		// Commands are passed from the control side to the real-time callback through a single producer
+		// single consumer ring; producers are serialized by iProducerMutex which the callback never takes.
+		// While the device is stopped there is no consumer so producers apply commands themselves.
+		std::mutex iProducerMutex;
+		bool iStarted = false;
+		std::array<command, CommandQueueCapacity> iCommands;
+		std::atomic<std::size_t> iCommandHead = 0;
+		std::atomic<std::size_t> iCommandTail = 0;
+		// owned by the callback thread; preallocated so mixing never allocates
 		std::vector<source> iSources;
+		std::vector<float> iMixBus;
 	};
 }
\ No newline at end of file
@@ -40,6 +40,8 @@ namespace neogfx
         audio_frame_count length() const final;
         void generate(audio_channel aChannel, audio_frame_count aFrameCount, float* aOutputFrames) final;
         void generate_from(audio_channel aChannel, audio_frame_index aFrameFrom, audio_frame_count aFrameCount, float* aOutputFrames) final;
+    private:
+        void update_schedule();
     private:
         neogfx::instrument iInstrument;
         time_point iInputCursor = 0ULL;
@@ -53,5 +55,8 @@ namespace neogfx
             time_interval duration;
         };
         std::vector<part> iComposition;
+        std::vector<std::size_t> iSchedule; ///< Indices of composition notes ordered by start.
+        bool iScheduleDirty = false;
+        time_interval iLongestNote = 0ULL;
     };
 }
\ No newline at end of file
@@ -18,6 +18,14 @@
 */
 
 #include <neogfx/neogfx.hpp>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <neogfx/audio/audio_primitives.hpp>
 #include <neogfx/audio/i_audio_instrument_atlas.hpp>
 
@@ -36,13 +44,49 @@ namespace neogfx
 			note midiKeyPitchCentre;
 			note midiKeyHigh;
 		};
+		typedef std::shared_ptr<std::vector<float> const> pcm_ptr;
+		typedef std::pair<std::string, audio_sample_rate> decoded_sample_key;
+		typedef std::packaged_task<pcm_ptr()> preparation;
+		// Prepared notes are also published in a fixed size open addressed table that the audio callback can
+		// read without taking iMutex: slots are only ever filled (with iMutex held) and never cleared, and a
+		// slot's note is stored before its key is released.
+		struct ready_note
+		{
+			std::atomic<std::uint64_t> key = 0u;
+			std::atomic<i_audio_bitstream*> note = nullptr;
+		};
+		static constexpr std::size_t ReadyNoteCapacity = 16384u;
 	public:
 		audio_instrument_atlas();
+		~audio_instrument_atlas();
 	public:
 		bool load_instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate) override;
+		bool note_ready(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote) const override;
 		i_audio_bitstream& instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote) override;
 	private:
+		static std::optional<std::uint64_t> packed_key(note_key const& aKey);
+		i_audio_bitstream* find_ready(note_key const& aKey) const;
+		i_audio_bitstream& publish(note_key const& aKey, ref_ptr<i_audio_bitstream> const& aNote);
+		void publish_prepared(note_key const& aKey);
+		std::shared_future<pcm_ptr> prepare(note_key const& aKey, sample_info const& aSampleInfo);
+		pcm_ptr prepare_note(note_key const& aKey, sample_info const& aSampleInfo);
+		pcm_ptr decoded_sample(std::string const& aSampleFile, audio_sample_rate aSampleRate);
+		std::string cache_path(note_key const& aKey) const;
+		pcm_ptr read_cache(note_key const& aKey) const;
+		void write_cache(note_key const& aKey, std::vector<float> const& aPcm) const;
+		void process();
+	private:
+		mutable std::mutex iMutex;
+		std::condition_variable iWorkAvailable;
 		std::map<neogfx::instrument, std::map<note, sample_info>> iSamples;
 		std::map<note_key, ref_ptr<i_audio_bitstream>> iNotes;
+		std::array<ready_note, ReadyNoteCapacity> iReadyNotes;
+		std::map<note_key, std::shared_future<pcm_ptr>> iPrepared;
+		std::deque<std::pair<note_key, std::shared_ptr<preparation>>> iQueue;
+		std::map<decoded_sample_key, std::shared_future<pcm_ptr>> iDecodedSamples;
+		std::uint64_t iAtlasFileSize = 0u;
+		std::int64_t iAtlasFileTime = 0;
+		std::vector<std::thread> iWorkers;
+		bool iStopping = false;
 	};
 }
\ No newline at end of file
@@ -42,12 +42,18 @@ namespace neogfx
     public:
         void generate(audio_sample_count aSampleCount, float* aOutputSamples) final;
         void generate_from(audio_sample_index aSampleFrom, audio_sample_count aSampleCount, float* aOutputSamples) final;
+    private:
+        void build_wavetable();
+    private:
+        static constexpr std::size_t WavetableSize = 2048;
     private:
         audio_sample_rate iSampleRate;
         float iFrequency;
         float iAmplitude;
         oscillator_function iFunction;
         std::function<float(float)> iCustomFunction;
+        std::vector<float> iWavetable;
         audio_sample_index iCursor = 0ULL;
+        double iPhase = 0.0; ///< Normalized phase, [0, 1).
     };
 }
\ No newline at end of file
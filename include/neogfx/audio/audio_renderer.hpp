@@ -0,0 +1,73 @@
+// audio_renderer.hpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2021 Leigh Johnston.  All Rights Reserved.
+  
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <neogfx/neogfx.hpp>
+#include <thread>
+#include <neogfx/audio/audio_primitives.hpp>
+#include <neogfx/audio/i_audio_bitstream.hpp>
+
+#pragma once
+
+namespace neogfx
+{
+    // Renders bitstreams (instruments, tracks, waveforms) offline, as fast as the CPU allows, rather than at the
+    // rate a device callback pulls them. The render proceeds a block at a time: the sources' blocks are generated
+    // by worker threads and then summed in the order the sources were added, so the output does not depend on
+    // the thread count. Sources rendered concurrently must not share mutable state.
+    class audio_renderer
+    {
+    public:
+        struct unsupported_channel_count : std::logic_error { unsupported_channel_count() : std::logic_error("neogfx::audio_renderer::unsupported_channel_count") {} };
+        struct unsupported_sample_format : std::logic_error { unsupported_sample_format() : std::logic_error("neogfx::audio_renderer::unsupported_sample_format") {} };
+        struct error_writing_file : std::runtime_error { error_writing_file() : std::runtime_error("neogfx::audio_renderer::error_writing_file") {} };
+    public:
+        typedef std::vector<float> buffer_type; ///< Interleaved frames.
+    private:
+        struct source
+        {
+            i_audio_bitstream* bitstream;
+            audio_frame_index start;
+            float gain;
+        };
+    public:
+        static constexpr audio_frame_count BlockSize = 65536;
+    public:
+        audio_renderer(audio_sample_rate aSampleRate, std::uint32_t aChannels = 2u, std::uint32_t aThreadCount = std::max(1u, std::thread::hardware_concurrency()));
+    public:
+        audio_sample_rate sample_rate() const;
+        std::uint32_t channels() const;
+        void add_source(i_audio_bitstream& aSource, audio_frame_index aStart = 0ULL, float aGain = 1.0f);
+        void clear();
+        audio_frame_count length() const;
+    public:
+        buffer_type render() const;
+        buffer_type render(audio_frame_count aFrameCount) const;
+        void render_to_wav(std::string const& aPath, audio_sample_format aSampleFormat = audio_sample_format::S16) const;
+        void render_to_wav(std::string const& aPath, audio_frame_count aFrameCount, audio_sample_format aSampleFormat = audio_sample_format::S16) const;
+        static void write_wav(std::string const& aPath, buffer_type const& aFrames, audio_sample_rate aSampleRate, std::uint32_t aChannels, audio_sample_format aSampleFormat = audio_sample_format::S16);
+    private:
+        audio_channel channel_mask() const;
+        bool render_source(source const& aSource, audio_frame_count aFrameCount, audio_frame_index aBlockStart, audio_frame_count aBlockFrames, float* aBlock) const;
+    private:
+        audio_sample_rate iSampleRate;
+        std::uint32_t iChannels;
+        std::uint32_t iThreadCount;
+        std::vector<source> iSources;
+    };
+}
\ No newline at end of file
@@ -68,5 +68,7 @@ namespace neogfx
 		virtual void stop() = 0;
 	public:
 		virtual void play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration) = 0;
+		virtual void play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration, float aGain, float aPan) = 0;
+		virtual void stop(i_audio_bitstream& aBitstream) = 0;
 	};
 }
\ No newline at end of file
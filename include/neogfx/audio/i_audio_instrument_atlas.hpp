@@ -36,6 +36,7 @@ namespace neogfx
 		virtual ~i_audio_instrument_atlas() = default;
 	public:
 		virtual bool load_instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate) = 0;
+		virtual bool note_ready(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote) const = 0;
 		virtual i_audio_bitstream& instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote) = 0;
 	};
 }
\ No newline at end of file
@@ -156,9 +156,9 @@ namespace neogfx::game
                                     pos.x + glyphTexture.placement().x,
                                     aGc.logical_coordinates().is_game_orientation() ?
                                         pos.y + (glyphTexture.placement().y + -glyphFont.descender()) :
-                                        pos.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.texture().extents().cy,
+                                        pos.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.extents().cy,
                                     0.0);
-                                add_patch(*mf.mesh, mr, rect{ glyphOrigin, glyphTexture.texture().extents() }, 0.0, glyphTexture.texture());
+                                add_patch(*mf.mesh, mr, rect{ glyphOrigin, glyphTexture.extents() }, 0.0, glyphTexture.texture());
                                 mr.patches.back().material = material{ aMaterial.color, aMaterial.gradient, aMaterial.sharedTexture, mr.patches.back().material.texture, aMaterial.shaderEffect };
                             }
                             pos.x += advance(glyph).cx;
@@ -177,6 +177,7 @@ namespace neogfx::game
                     }
                     mesh_line(point{}, aData.ink);
                 }
+                service<i_font_manager>().flush_glyphs();
             }
         };
     };
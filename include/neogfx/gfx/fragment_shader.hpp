@@ -171,6 +171,7 @@ namespace neogfx
         cache_uniform(uGlyphRenderOutput)
         cache_uniform(uGlyphSubpixel)
         cache_uniform(uGlyphSubpixelFormat)
+        cache_uniform(uGlyphSdf)
         cache_uniform(uGlyphEnabled)
     };
 
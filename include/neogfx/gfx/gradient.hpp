@@ -69,6 +69,7 @@ namespace neogfx
         abstract_color_stop_list& color_stops() override;
         abstract_alpha_stop_list const& alpha_stops() const override;
         abstract_alpha_stop_list& alpha_stops() override;
+        std::size_t stops_hash() const override;
         abstract_color_stop_list::const_iterator find_color_stop(scalar aPos, bool aToInsert = false) const override;
         abstract_color_stop_list::const_iterator find_color_stop(scalar aPos, scalar aStart, scalar aEnd, bool aToInsert = false) const override;
         abstract_alpha_stop_list::const_iterator find_alpha_stop(scalar aPos, bool aToInsert = false) const override;
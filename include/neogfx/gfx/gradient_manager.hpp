@@ -21,6 +21,8 @@
 
 #include <neogfx/neogfx.hpp>
 #include <unordered_set>
+#include <unordered_map>
+#include <list>
 #include <neogfx/gfx/shader_array.hpp>
 #include <neogfx/gfx/gradient.hpp>
 #include <neogfx/gfx/i_gradient_manager.hpp>
@@ -102,9 +104,22 @@ namespace neogfx
         typedef ref_ptr<i_gradient> gradient_pointer;
         typedef neolib::pair<gradient_pointer, uint32_t> gradient_list_entry;
         typedef neolib::jar<gradient_list_entry> gradient_list;
-        typedef std::pair<gradient::color_stop_list, gradient::alpha_stop_list> sampler_key_t;
-        typedef std::map<sampler_key_t, gradient_sampler> sampler_map_t;
-        typedef std::map<scalar, gradient_filter> filter_map_t;
+        struct sampler_entry
+        {
+            std::size_t hash;
+            gradient::color_stop_list colorStops;
+            gradient::alpha_stop_list alphaStops;
+            gradient_sampler sampler;
+        };
+        typedef std::list<sampler_entry> sampler_list_t; // least recently used first
+        typedef std::unordered_multimap<std::size_t, sampler_list_t::iterator> sampler_index_t;
+        struct filter_entry
+        {
+            scalar smoothness;
+            gradient_filter filter;
+        };
+        typedef std::list<filter_entry> filter_list_t; // least recently used first
+        typedef std::unordered_map<scalar, filter_list_t::iterator> filter_index_t;
         // constants
     public:
         static constexpr uint32_t MaxSamplers = 1024;
@@ -142,18 +157,18 @@ namespace neogfx
         void do_create_gradient(i_gradient const& aOther, i_gradient::color_stop_list const& aColorStops, i_gradient::alpha_stop_list const& aAlphaStops, neolib::i_ref_ptr<i_gradient>& aResult) override;
         void do_create_gradient(neolib::i_vector<sRGB_color::abstract_type> const& aColors, gradient_direction aDirection, neolib::i_ref_ptr<i_gradient>& aResult) override;
     private:
-        shader_array<avec4u8>& samplers();
+        shader_array<avec4u8>& sampler_data();
         std::vector<gradient_sampler>& free_samplers();
         std::vector<gradient_filter>& free_filters();
         void cleanup();
     private:
         gradient_list iGradients;
-        std::optional<shader_array<avec4u8>> iSamplers;
-        sampler_map_t iAllocatedSamplers;
+        std::optional<shader_array<avec4u8>> iSamplerData;
+        sampler_list_t iSamplers;
+        sampler_index_t iSamplerIndex;
         std::optional<std::vector<gradient_sampler>> iFreeSamplers;
-        std::deque<sampler_map_t::const_iterator> iSamplerQueue;
-        filter_map_t iAllocatedFilters;
+        filter_list_t iFilters;
+        filter_index_t iFilterIndex;
         std::optional<std::vector<gradient_filter>> iFreeFilters;
-        std::deque<filter_map_t::const_iterator> iFilterQueue;
     };
 }
\ No newline at end of file
@@ -150,6 +150,7 @@ namespace neogfx
         virtual color_stop_list& color_stops() = 0;
         virtual alpha_stop_list const& alpha_stops() const = 0;
         virtual alpha_stop_list& alpha_stops() = 0;
+        virtual std::size_t stops_hash() const = 0;
         virtual color_stop_list::const_iterator find_color_stop(scalar aPos, bool aToInsert = false) const = 0;
         virtual color_stop_list::const_iterator find_color_stop(scalar aPos, scalar aStart, scalar aEnd, bool aToInsert = false) const = 0;
         virtual alpha_stop_list::const_iterator find_alpha_stop(scalar aPos, bool aToInsert = false) const = 0;
@@ -23,6 +23,7 @@
 #include <vector>
 #include <unordered_map>
 #include <optional>
+#include <future>
 #include <neogfx/core/event.hpp>
 #include <neogfx/gfx/i_image.hpp>
 
@@ -42,6 +43,7 @@ namespace neogfx
     public:
         typedef neolib::vector<uint8_t> data_type;
         typedef data_type hash_digest_type;
+        typedef std::shared_future<ref_ptr<i_image>> future_image;
     private:
         struct error_parsing_image_pattern : std::logic_error { error_parsing_image_pattern() : std::logic_error("neogfx::image::error_parsing_image_pattern") {} };
         struct no_resource : std::logic_error { no_resource() : std::logic_error("neogfx::image::no_resource") {} };
@@ -51,6 +53,7 @@ namespace neogfx
         image(std::string const& aUri, dimension aDpiScaleFactor = 1.0, texture_sampling aSampling = texture_sampling::NormalMipmap, neogfx::color_space aColorSpace = neogfx::color_space::sRGB);
         image(std::string const& aImagePattern, const std::unordered_map<std::string, color>& aColorMap, dimension aDpiScaleFactor = 1.0, texture_sampling aSampling = texture_sampling::NormalMipmap, neogfx::color_space aColorSpace = neogfx::color_space::sRGB);
         image(std::string const& aUri, std::string const& aImagePattern, const std::unordered_map<std::string, color>& aColorMap, dimension aDpiScaleFactor = 1.0, texture_sampling aSampling = texture_sampling::NormalMipmap, neogfx::color_space aColorSpace = neogfx::color_space::sRGB);
+        image(std::string const& aUri, const void* aEncodedData, std::size_t aEncodedSize, dimension aDpiScaleFactor = 1.0, texture_sampling aSampling = texture_sampling::NormalMipmap, neogfx::color_space aColorSpace = neogfx::color_space::sRGB);
         image(image const& aOther);
         image(image&& aOther);
         image(image const& aOther, texture_sampling aSampling);
@@ -82,12 +85,16 @@ namespace neogfx
         void* pixels() override;
         color get_pixel(const point& aPoint) const override;
         void set_pixel(const point& aPoint, const color& aColor) override;
+    public:
+        static future_image load_async(std::string const& aUri, dimension aDpiScaleFactor = 1.0, texture_sampling aSampling = texture_sampling::NormalMipmap, neogfx::color_space aColorSpace = neogfx::color_space::sRGB);
+        static void clear_decoded_images();
     private:
         bool has_resource() const;
         const i_resource& resource() const;
-        image_type_e recognize() const;
+        static image_type_e recognize(const void* aEncodedData, std::size_t aEncodedSize);
         bool load();
-        bool load_png();
+        bool load(const void* aEncodedData, std::size_t aEncodedSize);
+        bool load_png(const void* aEncodedData, std::size_t aEncodedSize);
     private:
         ref_ptr<i_resource> iResource;
         string iUri;
@@ -21,6 +21,7 @@
 
 #include <neogfx/neogfx.hpp>
 #include <unordered_map>
+#include <bitset>
 #include <neogfx/gfx/i_texture_manager.hpp>
 #include <neogfx/gfx/i_texture_atlas.hpp>
 #include "i_emoji_atlas.hpp"
@@ -31,7 +32,14 @@ namespace neogfx
     {
     private:
         typedef std::map<dimension, std::string> sets;
-        typedef std::map<std::u32string, sets> emojis;
+        struct emoji_entry
+        {
+            sets files;
+            std::optional<emoji_id> id;
+        };
+        typedef std::unordered_map<std::u32string, emoji_entry> emoji_catalog;
+        // single code point emojis below this limit are also recorded in a bitset for an O(1) test
+        static constexpr char32_t kSingleCodePointLimit = 0x20000;
     public:
         emoji_atlas();
     public:
@@ -40,10 +48,12 @@ namespace neogfx
         virtual emoji_id emoji(char32_t aCodePoint, dimension aDesiredSize) const;
         virtual emoji_id emoji(const std::u32string& aCodePoints, dimension aDesiredSize = 64) const;
         virtual const i_texture& emoji_texture(emoji_id aId) const;
+    private:
+        emoji_id emoji(emoji_entry& aEntry, dimension aDesiredSize) const;
     private:
         const std::string kFilePath;
         std::unique_ptr<i_texture_atlas> iTextureAtlas;
-        emojis iEmojis;
-        mutable std::unordered_map<std::u32string, std::optional<emoji_id>> iEmojiMap;
+        mutable emoji_catalog iCatalog;
+        std::bitset<kSingleCodePointLimit> iSingleCodePoints;
     };
 }
\ No newline at end of file
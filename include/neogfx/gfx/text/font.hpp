@@ -241,6 +241,7 @@ namespace neogfx
         uint32_t num_fixed_sizes() const;
         point_size fixed_size(uint32_t aFixedSizeIndex) const;
     public:
+        void prepare_glyph_texture(const glyph& aGlyph) const;
         const i_glyph_texture& glyph_texture(const glyph& aGlyph) const;
     public:
         bool operator==(const font& aRhs) const;
@@ -22,8 +22,10 @@
 #include <neogfx/neogfx.hpp>
 #include <unordered_map>
 #include <set>
+#include <map>
 #include <neolib/core/jar.hpp>
 #include <neolib/core/string_ci.hpp>
+#include <neolib/task/timer.hpp>
 #include <neogfx/gfx/texture_atlas.hpp>
 #include <neogfx/gfx/text/emoji_atlas.hpp>
 #include <neogfx/gfx/text/i_font_manager.hpp>
@@ -33,6 +35,8 @@ typedef struct FT_LibraryRec_* FT_Library;
 namespace neogfx
 {
     class native_font;
+    class glyph_rasterizer;
+    class persistent_glyph_cache;
 
     class fallback_font_info : public i_fallback_font_info
     {
@@ -53,6 +57,21 @@ namespace neogfx
         typedef std::map<string, std::vector<native_font_list::iterator>, neolib::ci_less> font_family_list;
         typedef font id_cache_entry;
         typedef neolib::small_jar<id_cache_entry> id_cache;
+        struct glyph_upload
+        {
+            i_sub_texture const* texture;
+            std::vector<uint8_t> pixels;
+        };
+        typedef std::vector<glyph_upload> glyph_upload_list;
+        struct sdf_glyph
+        {
+            i_sub_texture const* texture;
+            point placement;
+        };
+        // (font data hash, face index, emulated bold, glyph index); keyed by font data rather than by font object so an
+        // entry can't be found again through a recycled address
+        typedef std::tuple<uint64_t, long, bool, uint32_t> sdf_glyph_key;
+        typedef std::map<sdf_glyph_key, sdf_glyph> sdf_glyph_cache;
         friend neolib::small_cookie item_cookie(const id_cache_entry&);
     public:
         struct error_initializing_font_library : std::runtime_error { error_initializing_font_library() : std::runtime_error("neogfx::font_manager::error_initializing_font_library") {} };
@@ -97,6 +116,19 @@ namespace neogfx
         i_texture_atlas& glyph_atlas() override;
         const i_emoji_atlas& emoji_atlas() const override;
         i_emoji_atlas& emoji_atlas() override;
+    public:
+        bool async_glyph_rasterization() const override;
+        void enable_async_glyph_rasterization(bool aEnable) override;
+        bool glyph_placeholders() const override;
+        void enable_glyph_placeholders(bool aEnable) override;
+        bool sdf_glyphs() const override;
+        void enable_sdf_glyphs(bool aEnable) override;
+        void flush_glyphs() override;
+    public:
+        bool persistent_glyph_cache_enabled() const override;
+        void enable_persistent_glyph_cache(i_string const& aPath) override;
+        void disable_persistent_glyph_cache() override;
+        void save_persistent_glyph_cache() override;
     protected:
         void add_ref(font_id aId) override;
         void release(font_id aId) override;
@@ -107,6 +139,13 @@ namespace neogfx
     private:
         i_native_font_face& add_font(const ref_ptr<i_native_font_face>& aNewFont);
         void cleanup();
+    private:
+        neogfx::glyph_rasterizer& glyph_rasterizer();
+        void queue_glyph_upload(i_sub_texture const& aTexture, std::vector<uint8_t>&& aPixels);
+        void glyph_placeholder_issued();
+        sdf_glyph_cache& sdf_cache();
+        void release_sdf_glyphs(native_font const& aFont);
+        neogfx::persistent_glyph_cache* persistent_glyph_cache() const;
     private:
         mutable std::unordered_map<system_font_role, optional<font_info>> iDefaultSystemFontInfo;
         mutable std::optional<fallback_font_info> iDefaultFallbackFontInfo;
@@ -118,5 +157,14 @@ namespace neogfx
         std::unique_ptr<i_glyph_text_factory> iGlyphTextFactory;
         texture_atlas iGlyphAtlas;
         neogfx::emoji_atlas iEmojiAtlas;
+        bool iAsyncGlyphRasterization;
+        bool iGlyphPlaceholders;
+        std::unique_ptr<neogfx::glyph_rasterizer> iGlyphRasterizer;
+        glyph_upload_list iGlyphUploads;
+        bool iGlyphPlaceholdersIssued;
+        std::optional<neolib::callback_timer> iGlyphPlaceholderUpdater;
+        bool iSdfGlyphs;
+        sdf_glyph_cache iSdfGlyphCache;
+        std::unique_ptr<neogfx::persistent_glyph_cache> iPersistentGlyphCache;
     };
 }
\ No newline at end of file
@@ -97,6 +97,19 @@ namespace neogfx
         virtual i_texture_atlas& glyph_atlas() = 0;
         virtual const i_emoji_atlas& emoji_atlas() const = 0;
         virtual i_emoji_atlas& emoji_atlas() = 0;
+    public:
+        virtual bool async_glyph_rasterization() const = 0;
+        virtual void enable_async_glyph_rasterization(bool aEnable) = 0;
+        virtual bool glyph_placeholders() const = 0;
+        virtual void enable_glyph_placeholders(bool aEnable) = 0;
+        virtual bool sdf_glyphs() const = 0;
+        virtual void enable_sdf_glyphs(bool aEnable) = 0;
+        virtual void flush_glyphs() = 0;
+    public:
+        virtual bool persistent_glyph_cache_enabled() const = 0;
+        virtual void enable_persistent_glyph_cache(i_string const& aPath) = 0;
+        virtual void disable_persistent_glyph_cache() = 0;
+        virtual void save_persistent_glyph_cache() = 0;
     public:
         bool has_font(std::string const& aFamily, std::string const& aStyle) const
         {
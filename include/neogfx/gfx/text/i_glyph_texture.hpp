@@ -35,7 +35,8 @@ namespace neogfx
         Gray = Gray8Bit,
         LCD,
         LCD_V,
-        BGRA
+        BGRA,
+        SDF
     };
 
     class i_glyph_texture
@@ -46,6 +47,7 @@ namespace neogfx
         virtual const i_sub_texture& texture() const = 0;
         virtual bool subpixel() const = 0;
         virtual const point& placement() const = 0;
+        virtual const size& extents() const = 0;
         virtual glyph_pixel_mode pixel_mode() const = 0;
     };
 }
\ No newline at end of file
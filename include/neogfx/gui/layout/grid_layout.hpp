@@ -41,6 +41,11 @@ namespace neogfx
         struct column_major;
         typedef std::map<cell_coordinates, i_layout_item*, std::less<cell_coordinates>, neolib::fast_pool_allocator<std::pair<const cell_coordinates, i_layout_item*>>> cell_list;
         typedef std::vector<std::pair<cell_coordinates, cell_coordinates>> span_list;
+        struct span_lookup
+        {
+            cell_dimensions dimensions;
+            std::vector<uint32_t> spans; // one-based index into span list per cell (row major); zero if not spanned
+        };
     public:
         grid_layout(neogfx::alignment aAlignment = neogfx::alignment::Center | neogfx::alignment::VCenter);
         grid_layout(cell_coordinate aRows, cell_coordinate aColumns, neogfx::alignment aAlignment = neogfx::alignment::Center | neogfx::alignment::VCenter);
@@ -122,6 +127,7 @@ namespace neogfx
         cell_dimensions iDimensions;
         cell_coordinates iCursor;
         span_list iSpans;
+        mutable std::optional<span_lookup> iSpanLookup;
         vertical_layout iRowLayout;
         std::vector<ref_ptr<horizontal_layout>> iRows;
     };
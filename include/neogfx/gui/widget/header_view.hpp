@@ -101,7 +101,6 @@ namespace neogfx
         void update_buttons();
         void request_full_update();
         void full_update();
-        void update_from_row(uint32_t aRow, i_graphics_context& aGc);
         bool update_section_width(uint32_t aColumn, const size& aCellExtents, i_graphics_context& aGc);
     private:
         i_header_view_owner& iOwner;
@@ -310,6 +310,8 @@ namespace neogfx
         virtual bool is_selectable(item_presentation_model_index const& aIndex) const = 0;
         virtual void select(item_presentation_model_index const& aIndex, item_selection_operation aOperation) = 0;
         virtual void select(item_model_index const& aIndex, item_selection_operation aOperation) = 0;
+        virtual void select(item_presentation_model_index const& aFirst, item_presentation_model_index const& aLast, item_selection_operation aOperation) = 0;
+        virtual void select_all() = 0;
     public:
         virtual bool sorting() const = 0;
         virtual bool filtering() const = 0;
@@ -22,9 +22,12 @@
 #include <neogfx/neogfx.hpp>
 #include <vector>
 #include <deque>
+#include <set>
+#include <map>
+#include <string_view>
+#include <regex>
 #include <boost/algorithm/string.hpp>
 #include <neolib/core/vecarray.hpp>
-#include <neolib/core/segmented_array.hpp>
 #include <neolib/core/scoped.hpp>
 #include <neogfx/core/object.hpp>
 #include <neogfx/gfx/i_graphics_context.hpp>
@@ -87,7 +90,6 @@ namespace neogfx
         typedef typename container_traits::sibling_iterator sibling_iterator;
         typedef typename container_traits::allocator_type allocator_type;
         typedef typename container_type::value_type row_type;
-        typedef std::optional<i_scrollbar::value_type> optional_position;
     private:
         typedef std::vector<item_presentation_model_index::optional_row_type, typename std::allocator_traits<allocator_type>:: template rebind_alloc<item_presentation_model_index::optional_row_type>> row_map_type;
         typedef std::vector<item_presentation_model_index::optional_column_type, typename std::allocator_traits<allocator_type>:: template rebind_alloc<item_presentation_model_index::optional_column_type>> column_map_type;
@@ -96,13 +98,25 @@ namespace neogfx
             column_info(const item_model_index::optional_column_type modelColumn = {}) : modelColumn{ modelColumn } {}
             mutable item_model_index::optional_column_type modelColumn;
             item_cell_flags flags = item_cell_flags::Default;
-            mutable optional_dimension width;
+            mutable std::multiset<dimension> cellWidths;
+            mutable std::vector<item_model_index::row_type> unmeasuredRows;
+            mutable bool rescanRows = false;
             mutable std::optional<std::string> headingText;
             mutable font headingFont;
             mutable optional_size headingExtents;
             optional_size imageSize;
         };
         typedef typename container_traits::template rebind<item_presentation_model_index::row_type, column_info>::other::row_cell_array column_info_array;
+        typedef std::vector<std::optional<std::string>> folded_text_list;
+        typedef std::multimap<std::string, item_model_index::row_type> search_index;
+        struct compiled_filter
+        {
+            item_model_index::column_type modelColumn;
+            filter_search_type searchType;
+            case_sensitivity caseSensitivity;
+            std::string key;
+            std::optional<std::regex> regex;
+        };
     public:
         using typename base_type::no_item_model;
         using typename base_type::bad_index;
@@ -164,9 +178,12 @@ namespace neogfx
                         iColumns.clear();
                         for (item_model_index::column_type col = 0; col < item_model().columns(); ++col)
                             iColumns.emplace_back(col);
+                        iFoldedText.clear();
+                        iSearchIndices.clear();
+                        iFilterRefinable = false;
                         iRows.clear();
                         for (item_model_index::row_type row = 0; row < item_model().rows(); ++row)
-                            item_added(item_model_index{ row });
+                            add_row(item_model_index{ row });
                     }
 
                     ItemModelChanged.trigger(item_model());
@@ -180,6 +197,8 @@ namespace neogfx
                 iItemModelSink += item_model().cleared([this]()
                 {  
                     iRows.clear();
+                    iFoldedText.clear();
+                    iSearchIndices.clear();
                     reset_maps();
                     reset_meta();
                     reset_sort();
@@ -254,16 +273,21 @@ namespace neogfx
         {
             if (iColumns.size() < aColumnIndex + 1u)
                 return 0.0;
-            auto& columnWidth = column(aColumnIndex).width;
-            if (columnWidth != std::nullopt)
-                return *columnWidth + (aIncludePadding ? cell_padding(aGc).size().cx : 0.0);
-            columnWidth = 0.0;
-            for (item_presentation_model_index::row_type row = 0u; row < rows(); ++row)
-            {
-                auto const cellWidth = cell_extents(item_presentation_model_index{ row, aColumnIndex }, aGc).cx;
-                columnWidth = std::max(*columnWidth, cellWidth);
-            }
-            return *columnWidth + (aIncludePadding ? cell_padding(aGc).size().cx : 0.0);
+            auto const& cellWidths = column(aColumnIndex).cellWidths;
+            // cells added or changed since the last query are recorded by model row so only those need measuring...
+            auto& unmeasuredRows = column(aColumnIndex).unmeasuredRows;
+            for (auto modelRow : unmeasuredRows)
+                if (has_item_model_index(item_model_index{ modelRow }))
+                    cell_extents(item_presentation_model_index{ from_item_model_index(item_model_index{ modelRow }, true).row(), aColumnIndex }, aGc);
+            unmeasuredRows.clear();
+            // ...every measured cell contributes one width so a rescan is only needed after the cell meta is reset
+            // or once more rows were changed than the column has
+            auto& rescanRows = column(aColumnIndex).rescanRows;
+            for (item_presentation_model_index::row_type row = rows(); row-- > 0u && (rescanRows || cellWidths.size() < rows());)
+                cell_extents(item_presentation_model_index{ row, aColumnIndex }, aGc);
+            rescanRows = false;
+            dimension const columnWidth = (cellWidths.empty() ? 0.0 : units_converter(aGc).from_device_units(size{ *cellWidths.rbegin(), 0.0 }).cx);
+            return columnWidth + (aIncludePadding ? cell_padding(aGc).size().cx : 0.0);
         }
         std::string const& column_heading_text(item_presentation_model_index::column_type aColumnIndex) const override
         {
@@ -530,76 +554,33 @@ namespace neogfx
         }
         double total_height(i_units_context const& aUnitsContext) const override
         {
-            if (iTotalHeight != std::nullopt)
-                return *iTotalHeight;
-            i_scrollbar::value_type height = 0.0;
-            for (item_presentation_model_index::row_type row = 0; row < rows(); ++row)
-                height += item_height(item_presentation_model_index(row, 0), aUnitsContext);
-            iTotalHeight = height;
-            return *iTotalHeight;
+            update_row_heights(rows(), aUnitsContext);
+            return row_height_sum(rows());
         }
         double item_position(item_presentation_model_index const& aIndex, i_units_context const& aUnitsContext) const override
         {
-            if (iPositions[aIndex.row()] == std::nullopt)
-            {
-                auto pred = [](const optional_position& lhs, const optional_position& rhs) -> bool
-                {
-                    if (lhs == std::nullopt && rhs == std::nullopt)
-                        return false;
-                    else if (lhs != std::nullopt && rhs == std::nullopt)
-                        return true;
-                    else if (lhs == std::nullopt && rhs != std::nullopt)
-                        return false;
-                    else
-                        return *lhs < *rhs;
-                };
-                auto i = std::lower_bound(iPositions.begin(), iPositions.end(), optional_position(), pred);
-                auto row = static_cast<item_presentation_model_index::row_type>(std::distance(iPositions.begin(), i));
-                double position = (row == 0 ? 0.0 : **(std::prev(i)) + item_height(item_presentation_model_index(row - 1), aUnitsContext));
-                while (row <= aIndex.row())
-                {
-                    iPositions[row] = position;
-                    position += item_height(item_presentation_model_index(row), aUnitsContext);
-                    ++row;
-                }
-            }
-            return *iPositions[aIndex.row()];
+            update_row_heights(aIndex.row(), aUnitsContext);
+            return row_height_sum(aIndex.row());
         }
         std::pair<item_presentation_model_index::row_type, coordinate> item_at(double aPosition, i_units_context const& aUnitsContext) const override
         {
             if (rows() == 0)
                 return std::pair<item_presentation_model_index::row_type, coordinate>{ 0u, 0.0 };
-            auto pred = [](const optional_position& lhs, const optional_position& rhs) -> bool
-            {
-                if (lhs == std::nullopt && rhs == std::nullopt)
-                    return false;
-                else if (lhs != std::nullopt && rhs == std::nullopt)
-                    return true;
-                else if (lhs == std::nullopt && rhs != std::nullopt)
-                    return false;
-                else
-                    return *lhs < *rhs;
-            };
-            auto i = std::lower_bound(iPositions.begin(), iPositions.end(), aPosition, pred);
-            if ((i == iPositions.end() || (*i != std::nullopt && **i > aPosition)) && i != iPositions.begin())
-                --i;
-            while (*i == std::nullopt)
-            {
-                auto j = std::lower_bound(iPositions.begin(), iPositions.end(), optional_position(), pred);
-                auto row = static_cast<item_presentation_model_index::row_type>(std::distance(iPositions.begin(), j));
-                double position = (row == 0 ? 0.0 : **(std::prev(j)) + item_height(item_presentation_model_index(row - 1), aUnitsContext));
-                while (row < iPositions.size())
+            update_row_heights(rows(), aUnitsContext);
+            // descend the row height tree to find the last row that starts at or before aPosition
+            std::size_t row = 0u;
+            double remaining = aPosition;
+            std::size_t step = 1u;
+            while (step * 2u < iRowHeightTree.size())
+                step *= 2u;
+            for (; step != 0u; step /= 2u)
+                if (row + step < iRowHeightTree.size() && iRowHeightTree[row + step] <= remaining)
                 {
-                    iPositions[row] = position;
-                    position += item_height(item_presentation_model_index(row), aUnitsContext);
-                    ++row;
+                    row += step;
+                    remaining -= iRowHeightTree[row];
                 }
-                i = std::lower_bound(iPositions.begin(), iPositions.end(), aPosition, pred);
-                if ((i == iPositions.end() || (*i != std::nullopt && **i > aPosition)) && i != iPositions.begin())
-                    --i;
-            }
-            auto const result = std::pair<item_presentation_model_index::row_type, coordinate>{ static_cast<item_presentation_model_index::row_type>(std::distance(iPositions.begin(), i)), static_cast<coordinate>(**i - aPosition) };
-            return result;
+            auto const resultRow = static_cast<item_presentation_model_index::row_type>(std::min<std::size_t>(row, rows() - 1u));
+            return std::pair<item_presentation_model_index::row_type, coordinate>{ resultRow, static_cast<coordinate>(row_height_sum(resultRow) - aPosition) };
         }
     public:
         item_cell_flags cell_flags(item_presentation_model_index const& aIndex) const override
@@ -814,7 +795,6 @@ namespace neogfx
         }
         size cell_extents(item_presentation_model_index const& aIndex, i_graphics_context const& aGc) const override
         {
-            auto oldItemHeight = item_height(aIndex, aGc);
             auto const& cellFont = cell_font(aIndex);
             auto const& effectiveFont = (cellFont == std::nullopt ? default_font() : *cellFont);
             auto& cellMeta = cell_meta(aIndex);
@@ -843,8 +823,8 @@ namespace neogfx
             }
             cellExtents.cy = std::max(cellExtents.cy, effectiveFont.height());
             cellMeta.extents = cellExtents.ceil();
-            if (iTotalHeight != std::nullopt)
-                *iTotalHeight += (item_height(aIndex, aGc) - oldItemHeight);
+            column(aIndex.column()).cellWidths.insert(cellMeta.extents->cx);
+            invalidate_row_height(aIndex.row());
             return units_converter(aGc).from_device_units(*cell_meta(aIndex).extents);
         }
         dimension indent(item_presentation_model_index const& aIndex, i_graphics_context const& aGc) const override
@@ -918,22 +898,31 @@ namespace neogfx
     public:
         optional_item_presentation_model_index find_item(filter_search_key const& aFilterSearchKey, item_presentation_model_index::column_type aColumnIndex = 0, filter_search_type aFilterSearchType = filter_search_type::Prefix, case_sensitivity aCaseSensitivity = case_sensitivity::CaseInsensitive) const override
         {
-            for (item_presentation_model_index::row_type row = 0; row < rows(); ++row)
+            auto const searchFilter = compile_filter(filter{ aColumnIndex, aFilterSearchKey, aFilterSearchType, aCaseSensitivity });
+            if (searchFilter == std::nullopt)
+                return optional_item_presentation_model_index{};
+            if (searchFilter->searchType == filter_search_type::Prefix && searchFilter->caseSensitivity == case_sensitivity::CaseInsensitive)
             {
-                auto modelIndex = to_item_model_index(item_presentation_model_index{ row, aColumnIndex });
-                auto const& origValue = item_model().cell_data(modelIndex).to_string();
-                auto const& value = aCaseSensitivity == case_sensitivity::CaseSensitive ? origValue : boost::to_upper_copy<std::string>(origValue);
-                auto const& origKey = aFilterSearchKey;
-                auto const& key = aCaseSensitivity == case_sensitivity::CaseSensitive ? origKey : boost::to_upper_copy<std::string>(origKey);
-                if (key.empty())
-                    continue;
-                switch (aFilterSearchType)
+                // candidates are contiguous in the sorted index; return the one presented first
+                std::optional<item_presentation_model_index::row_type> result;
+                auto const& index = column_search_index(searchFilter->modelColumn);
+                for (auto i = index.lower_bound(searchFilter->key); i != index.end() && i->first.starts_with(searchFilter->key); ++i)
                 {
-                case filter_search_type::Prefix:
-                    if (value.size() >= key.size() && value.substr(0, key.size()) == key)
-                        return from_item_model_index(modelIndex);
+                    auto const modelIndex = item_model_index{ i->second, searchFilter->modelColumn };
+                    if (has_item_model_index(modelIndex))
+                    {
+                        auto const row = from_item_model_index(modelIndex).row();
+                        if (result == std::nullopt || row < *result)
+                            result = row;
+                    }
                 }
+                if (result != std::nullopt)
+                    return item_presentation_model_index{ *result, aColumnIndex };
+                return optional_item_presentation_model_index{};
             }
+            for (item_presentation_model_index::row_type row = 0; row < rows(); ++row)
+                if (matches(*searchFilter, self_type::row(row).value))
+                    return item_presentation_model_index{ row, aColumnIndex };
             return optional_item_presentation_model_index{};
         }
     public:
@@ -948,8 +937,15 @@ namespace neogfx
             else
                 return optional_filter{};
         }
-        void filter_by(item_presentation_model_index::column_type aColumnIndex, filter_search_key const& aFilterSearchKey, filter_search_type aFilterSearchType = filter_search_type::Value, case_sensitivity aCaseSensitivity = case_sensitivity::CaseInsensitive) override
+        void filter_by(item_presentation_model_index::column_type aColumnIndex, filter_search_key const& aFilterSearchKey, filter_search_type aFilterSearchType = filter_search_type::Prefix, case_sensitivity aCaseSensitivity = case_sensitivity::CaseInsensitive) override
         {
+            // a filter on a new column or an extended prefix can only exclude rows that are currently presented
+            bool refine = iFilterRefinable;
+            for (auto const& existing : iFilters)
+                if (std::get<0>(existing) == aColumnIndex)
+                    refine = refine &&
+                        std::get<2>(existing) == filter_search_type::Prefix && aFilterSearchType == filter_search_type::Prefix &&
+                        std::get<3>(existing) == aCaseSensitivity && aFilterSearchKey.starts_with(std::get<1>(existing));
             iFilters.push_back(filter{ aColumnIndex, aFilterSearchKey, aFilterSearchType, aCaseSensitivity });
             for (auto i = iFilters.begin(); i != std::prev(iFilters.end()); ++i)
             {
@@ -959,7 +955,7 @@ namespace neogfx
                     break;
                 }
             }            
-            execute_filter();
+            execute_filter(refine);
         }
         void reset_filter() override
         {
@@ -1027,45 +1023,166 @@ namespace neogfx
             reset_position_meta(0);
             ItemsSorted.trigger();
         }
-        void execute_filter()
+        void execute_filter(bool aRefine = false)
         {
+            compile_filters();
             {
                 scoped_item_update siu{ *this };
                 neolib::scoped_flag sf2{ iFiltering };
                 ItemsFiltering.trigger();
-                iRows.clear();
-                for (item_model_index::row_type row = 0; row < item_model().rows(); ++row)
+                bool refined = false;
+                if constexpr (container_traits::is_flat)
                 {
-                    bool matches = true;
-                    for (auto const& filter : iFilters)
+                    if (aRefine)
                     {
-                        auto const& origValue = item_model().cell_data(item_model_index{ row, model_column(std::get<0>(filter)) }).to_string();
-                        auto const& value = (std::get<3>(filter) == case_sensitivity::CaseSensitive ? origValue : boost::to_upper_copy<std::string>(origValue));
-                        auto const& origKey = std::get<1>(filter);
-                        auto const& key = (std::get<3>(filter) == case_sensitivity::CaseSensitive ? origKey : boost::to_upper_copy<std::string>(origKey));
-                        if (key.empty())
-                            continue;
-                        switch (std::get<2>(filter))
-                        {
-                        case filter_search_type::Prefix:
-                            if (value.size() < key.size() || value.substr(0, key.size()) != key)
-                                matches = false;
-                            break;
-                        case filter_search_type::Glob:
-                            // todo
-                            break;
-                        case filter_search_type::Regex:
-                            // todo
-                            break;
-                        }
+                        iRows.erase(std::remove_if(iRows.begin(), iRows.end(), [&](row_type const& aRow) { return !matches_filters(aRow.value); }), iRows.end());
+                        refined = true;
                     }
-                    if (matches)
-                        item_added(item_model_index{ row });
+                }
+                if (!refined)
+                {
+                    iRows.clear();
+                    for (item_model_index::row_type row = 0; row < item_model().rows(); ++row)
+                        if (matches_filters(row))
+                            add_row(item_model_index{ row });
                 }
             }
+            iFilterRefinable = true;
             ItemsFiltered.trigger();
             execute_sort();
         }
+        void compile_filters()
+        {
+            iCompiledFilters.clear();
+            for (auto const& filter : iFilters)
+            {
+                auto compiled = compile_filter(filter);
+                if (compiled != std::nullopt)
+                    iCompiledFilters.push_back(std::move(*compiled));
+            }
+        }
+        std::optional<compiled_filter> compile_filter(filter const& aFilter) const
+        {
+            auto const& key = std::get<1>(aFilter);
+            if (key.empty())
+                return {};
+            compiled_filter compiled;
+            compiled.modelColumn = model_column(std::get<0>(aFilter));
+            compiled.searchType = std::get<2>(aFilter);
+            compiled.caseSensitivity = std::get<3>(aFilter);
+            compiled.key = (compiled.caseSensitivity == case_sensitivity::CaseSensitive ? key : boost::to_upper_copy<std::string>(key));
+            if (compiled.searchType == filter_search_type::Regex)
+            {
+                // a pattern that is still being typed (e.g. "(") is not an error; it just matches nothing yet
+                try
+                {
+                    compiled.regex.emplace(key, compiled.caseSensitivity == case_sensitivity::CaseSensitive ?
+                        std::regex::ECMAScript | std::regex::optimize : std::regex::ECMAScript | std::regex::optimize | std::regex::icase);
+                }
+                catch (std::regex_error const&)
+                {
+                    compiled.regex = std::nullopt;
+                }
+            }
+            return compiled;
+        }
+        bool matches_filters(item_model_index::row_type aRow) const
+        {
+            for (auto const& filter : iCompiledFilters)
+                if (!matches(filter, aRow))
+                    return false;
+            return true;
+        }
+        bool matches(compiled_filter const& aFilter, item_model_index::row_type aRow) const
+        {
+            std::string caseSensitiveValue;
+            std::string_view value;
+            if (aFilter.caseSensitivity == case_sensitivity::CaseSensitive)
+                value = caseSensitiveValue = item_model().cell_data(item_model_index{ aRow, aFilter.modelColumn }).to_string();
+            else
+                value = folded_text(item_model_index{ aRow, aFilter.modelColumn });
+            switch (aFilter.searchType)
+            {
+            case filter_search_type::Prefix:
+                return value.starts_with(aFilter.key);
+            case filter_search_type::Glob:
+                return glob_match(value, aFilter.key);
+            case filter_search_type::Regex:
+                return aFilter.regex != std::nullopt && std::regex_search(value.data(), value.data() + value.size(), *aFilter.regex);
+            }
+            return false;
+        }
+        static bool glob_match(std::string_view aValue, std::string_view aPattern)
+        {
+            std::size_t v = 0;
+            std::size_t p = 0;
+            std::optional<std::size_t> star;
+            std::size_t starMatch = 0;
+            while (v < aValue.size())
+            {
+                if (p < aPattern.size() && (aPattern[p] == '?' || aPattern[p] == aValue[v]))
+                {
+                    ++v;
+                    ++p;
+                }
+                else if (p < aPattern.size() && aPattern[p] == '*')
+                {
+                    star = p++;
+                    starMatch = v;
+                }
+                else if (star)
+                {
+                    p = *star + 1;
+                    v = ++starMatch;
+                }
+                else
+                    return false;
+            }
+            while (p < aPattern.size() && aPattern[p] == '*')
+                ++p;
+            return p == aPattern.size();
+        }
+        std::string const& folded_text(item_model_index const& aIndex) const
+        {
+            if (aIndex.column() >= iFoldedText.size())
+                iFoldedText.resize(aIndex.column() + 1);
+            auto& column = iFoldedText[aIndex.column()];
+            if (aIndex.row() >= column.size())
+                column.resize(item_model().rows());
+            auto& text = column[aIndex.row()];
+            if (text == std::nullopt)
+                text = boost::to_upper_copy<std::string>(item_model().cell_data(aIndex).to_string());
+            return *text;
+        }
+        search_index const& column_search_index(item_model_index::column_type aColumn) const
+        {
+            if (aColumn >= iSearchIndices.size())
+                iSearchIndices.resize(aColumn + 1);
+            auto& index = iSearchIndices[aColumn];
+            if (index == std::nullopt)
+            {
+                index.emplace();
+                for (item_model_index::row_type row = 0; row < item_model().rows(); ++row)
+                    index->emplace(folded_text(item_model_index{ row, aColumn }), row);
+            }
+            return *index;
+        }
+        void remove_from_search_index(item_model_index const& aIndex) const
+        {
+            auto& index = iSearchIndices[aIndex.column()];
+            if (aIndex.column() < iFoldedText.size() && aIndex.row() < iFoldedText[aIndex.column()].size() &&
+                iFoldedText[aIndex.column()][aIndex.row()] != std::nullopt)
+            {
+                auto const candidates = index->equal_range(*iFoldedText[aIndex.column()][aIndex.row()]);
+                for (auto i = candidates.first; i != candidates.second; ++i)
+                    if (i->second == aIndex.row())
+                    {
+                        index->erase(i);
+                        return;
+                    }
+            }
+            index = std::nullopt;
+        }
     private:
         void item_model_column_info_changed(item_model_index::column_type aColumnIndex)
         {
@@ -1079,13 +1196,54 @@ namespace neogfx
             }
         }
         void item_added(const item_model_index& aItemIndex)
+        {
+            for (auto& column : iFoldedText)
+                if (aItemIndex.row() < column.size())
+                    column.insert(std::next(column.begin(), aItemIndex.row()), std::nullopt);
+            // search indices hold model rows so only an appended row can be indexed without renumbering
+            for (item_model_index::column_type col = 0; col < iSearchIndices.size(); ++col)
+                if (iSearchIndices[col] != std::nullopt)
+                {
+                    if (aItemIndex.row() + 1u == item_model().rows())
+                        iSearchIndices[col]->emplace(folded_text(item_model_index{ aItemIndex.row(), col }), aItemIndex.row());
+                    else
+                        iSearchIndices[col] = std::nullopt;
+                }
+            // a row appended to the end of the model (e.g. during a bulk load) doesn't displace any existing rows
+            bool rowMapShifted = false;
+            if (aItemIndex.row() + 1u < item_model().rows())
+            {
+                for (auto& row : iRows)
+                    if (row.value >= aItemIndex.row())
+                        ++row.value;
+                for (item_presentation_model_index::column_type col = 0; col < iColumns.size(); ++col)
+                    for (auto& row : column(col).unmeasuredRows)
+                        if (row >= aItemIndex.row())
+                            ++row;
+                // flat rows are presented in their existing order so later model rows keep their presentation rows
+                // and only move down one slot in the row map
+                if constexpr (container_traits::is_flat)
+                    if (!updating() && iRowMapDirtyFrom == std::nullopt && aItemIndex.row() < iRowMap.size())
+                    {
+                        iRowMap.insert(std::next(iRowMap.begin(), aItemIndex.row()), std::nullopt);
+                        rowMapShifted = true;
+                    }
+            }
+            if (matches_filters(aItemIndex.row()))
+                add_row(aItemIndex);
+            else if (!updating() && iRowMapDirtyFrom == std::nullopt && aItemIndex.row() == iRowMap.size())
+                iRowMap.push_back(std::nullopt); // keep the row map complete so streaming hidden rows doesn't rebuild it
+            else if (!rowMapShifted)
+                reset_row_map(aItemIndex); // later model rows have still been renumbered
+        }
+        void add_row(const item_model_index& aItemIndex)
         {
             if constexpr (container_traits::is_tree)
                 if (item_model().has_parent(aItemIndex) && !has_item_model_index(item_model().parent(aItemIndex)))
+                {
+                    reset_row_map(aItemIndex);
                     return;
-            for (auto& row : iRows)
-                if (row.value >= aItemIndex.row())
-                    ++row.value;
+                }
             if constexpr (container_traits::is_flat)
                 iRows.push_back(row_type{ aItemIndex.row() });
             else
@@ -1103,50 +1261,120 @@ namespace neogfx
                 }
             }
 
-            if (!updating() || container_traits::is_tree)
+            if constexpr (container_traits::is_flat)
+            {
+                if (!updating())
+                {
+                    if (iRowMapDirtyFrom == std::nullopt && iRowMap.size() == aItemIndex.row())
+                        iRowMap.push_back(rows() - 1u);
+                    else if (iRowMapDirtyFrom == std::nullopt && aItemIndex.row() < iRowMap.size() && iRowMap[aItemIndex.row()] == std::nullopt)
+                        iRowMap[aItemIndex.row()] = rows() - 1u; // slot opened by item_added
+                    else
+                        reset_row_map(aItemIndex);
+                }
+            }
+            else
                 reset_row_map(aItemIndex);
 
             if (!updating())
             {
-                reset_meta(); // todo: optimize
-                execute_sort();
+                // existing cell meta is still valid; only the new row needs measuring
+                for (item_presentation_model_index::column_type col = 0; col < iColumns.size(); ++col)
+                    unmeasured_row_added(col, aItemIndex.row());
+                row_height_inserted(from_item_model_index(aItemIndex, true).row());
+                // notify before sorting: listeners shift row-based state (e.g. the selection) for the insertion
+                // and sorting then remaps it by model index, so the shift must not be applied after the sort
                 ItemAdded.trigger(from_item_model_index(aItemIndex, true));
+                execute_sort();
             }
         }
         void item_changed(const item_model_index& aItemIndex)
         {
+            bool const reindex = aItemIndex.column() < iSearchIndices.size() && iSearchIndices[aItemIndex.column()] != std::nullopt;
+            if (reindex)
+                remove_from_search_index(aItemIndex);
+            if (aItemIndex.column() < iFoldedText.size() && aItemIndex.row() < iFoldedText[aItemIndex.column()].size())
+                iFoldedText[aItemIndex.column()][aItemIndex.row()] = std::nullopt;
+            if (reindex && iSearchIndices[aItemIndex.column()] != std::nullopt)
+                iSearchIndices[aItemIndex.column()]->emplace(folded_text(aItemIndex), aItemIndex.row());
             if (!has_item_model_index(aItemIndex))
+            {
+                // a hidden row that now matches the filter can only be found by a full rescan
+                iFilterRefinable = false;
                 return;
+            }
             if (!updating())
             {
-                reset_row_map();
-                reset_meta(); // todo: optimize
+                auto const index = from_item_model_index(aItemIndex);
+                cell_meta(index).text = std::nullopt;
+                reset_cell_extents(index);
+                invalidate_row_height(index.row());
                 execute_sort();
-                auto& cellMeta = cell_meta(from_item_model_index(aItemIndex));
-                cellMeta.text = std::nullopt;
-                cellMeta.extents = std::nullopt;
-                column(mapped_column(aItemIndex.column())).width = std::nullopt;
                 ItemChanged.trigger(from_item_model_index(aItemIndex));
             }
         }
         void item_removed(const item_model_index& aItemIndex)
         {
+            for (item_model_index::column_type col = 0; col < iSearchIndices.size(); ++col)
+                if (iSearchIndices[col] != std::nullopt)
+                {
+                    if (aItemIndex.row() + 1u == item_model().rows())
+                        remove_from_search_index(item_model_index{ aItemIndex.row(), col });
+                    else
+                        iSearchIndices[col] = std::nullopt;
+                }
+            for (auto& column : iFoldedText)
+                if (aItemIndex.row() < column.size())
+                    column.erase(std::next(column.begin(), aItemIndex.row()));
             if (!has_item_model_index(aItemIndex))
+            {
+                // a filtered out row has no presentation row to remove but later model rows are still renumbered
+                unmeasured_row_removed(aItemIndex.row());
+                if (aItemIndex.row() + 1u < item_model().rows())
+                    for (auto& row : iRows)
+                        if (row.value > aItemIndex.row())
+                            --row.value;
+                if (aItemIndex.row() < iRowMap.size())
+                    iRowMap.erase(std::next(iRowMap.begin(), aItemIndex.row()));
                 return;
+            }
             if (!updating())
                 ItemRemoved.trigger(from_item_model_index(aItemIndex));
             auto const mappedRow = from_item_model_index(aItemIndex).row();
+            for (item_presentation_model_index::column_type col = 0; col < columns(item_presentation_model_index{ mappedRow }); ++col)
+                reset_cell_extents(item_presentation_model_index{ mappedRow, col });
+            unmeasured_row_removed(aItemIndex.row());
             iRows.erase(std::next(begin(), mappedRow));
-            for (auto& row : iRows)
-                if (row.value >= aItemIndex.row())
-                    --row.value;
-            if (iRowMap[aItemIndex.row()])
-                for (auto& row : iRowMap)
-                    if (row && *row >= mappedRow)
-                        --*row;
-            iRowMap.erase(std::next(iRowMap.begin(), aItemIndex.row()));
+            // removing the last model row or the last presentation row doesn't displace any other rows
+            bool const shiftValues = aItemIndex.row() + 1u < item_model().rows();
+            if constexpr (container_traits::is_flat)
+            {
+                // renumber and remap in a single pass: the row map entry of every row presented after the removed
+                // one is rewritten rather than searching the whole row map for them
+                iRowMap.erase(std::next(iRowMap.begin(), aItemIndex.row()));
+                item_presentation_model_index::row_type presentationRow = (shiftValues ? 0u : mappedRow);
+                for (auto row = std::next(iRows.begin(), presentationRow); row != iRows.end(); ++row, ++presentationRow)
+                {
+                    if (shiftValues && row->value >= aItemIndex.row())
+                        --row->value;
+                    if (presentationRow >= mappedRow)
+                        iRowMap[row->value] = presentationRow;
+                }
+            }
+            else
+            {
+                if (shiftValues)
+                    for (auto& row : iRows)
+                        if (row.value >= aItemIndex.row())
+                            --row.value;
+                if (mappedRow < rows())
+                    for (auto& row : iRowMap)
+                        if (row && *row >= mappedRow)
+                            --*row;
+                iRowMap.erase(std::next(iRowMap.begin(), aItemIndex.row()));
+            }
             if (!updating())
-                reset_meta(); // todo: optimize
+                row_height_removed(mappedRow);
         }
     private:
         void reset_maps(const item_model_index& aFrom = {}) const
@@ -1248,16 +1476,63 @@ namespace neogfx
         }
         void reset_cell_meta(const std::optional<item_presentation_model_index::column_type>& aColumn = {}) const
         {
-            for (item_presentation_model_index::row_type row = 0; row < rows(); ++row)
+            // include rows hidden by collapsed tree nodes so that cached extents always match the column width sets
+            for (auto& row : const_cast<container_type&>(iRows))
             {
-                for (item_presentation_model_index::column_type col = 0; col < iColumns.size(); ++col)
+                for (item_presentation_model_index::column_type col = 0; col < row.cells.size(); ++col)
                 {
                     if (aColumn != std::nullopt && col != *aColumn)
                         continue;
-                    cell_meta(item_presentation_model_index(row, col)).text = std::nullopt;
-                    cell_meta(item_presentation_model_index(row, col)).extents = std::nullopt;
+                    row.cells[col].text = std::nullopt;
+                    row.cells[col].extents = std::nullopt;
                 }
             }
+            for (item_presentation_model_index::column_type col = 0; col < iColumns.size(); ++col)
+                if (aColumn == std::nullopt || col == *aColumn)
+                {
+                    column(col).cellWidths.clear();
+                    column(col).unmeasuredRows.clear();
+                    column(col).rescanRows = false;
+                }
+        }
+        void reset_cell_extents(item_presentation_model_index const& aIndex) const
+        {
+            auto& cellMeta = cell_meta(aIndex);
+            if (cellMeta.extents == std::nullopt)
+                return;
+            auto& cellWidths = column(aIndex.column()).cellWidths;
+            auto existing = cellWidths.find(cellMeta.extents->cx);
+            if (existing != cellWidths.end())
+                cellWidths.erase(existing);
+            cellMeta.extents = std::nullopt;
+            unmeasured_row_added(aIndex.column(), to_item_model_index(aIndex).row());
+        }
+        void unmeasured_row_added(item_presentation_model_index::column_type aColumn, item_model_index::row_type aRow) const
+        {
+            auto& columnInfo = column(aColumn);
+            if (columnInfo.rescanRows)
+                return;
+            // a list longer than the column costs more to renumber than rescanning the column costs to measure
+            if (columnInfo.unmeasuredRows.size() >= rows())
+            {
+                columnInfo.unmeasuredRows.clear();
+                columnInfo.rescanRows = true;
+                return;
+            }
+            columnInfo.unmeasuredRows.push_back(aRow);
+        }
+        void unmeasured_row_removed(item_model_index::row_type aRow) const
+        {
+            for (item_presentation_model_index::column_type col = 0; col < iColumns.size(); ++col)
+            {
+                auto& unmeasuredRows = column(col).unmeasuredRows;
+                if (unmeasuredRows.empty())
+                    continue;
+                unmeasuredRows.erase(std::remove(unmeasuredRows.begin(), unmeasuredRows.end(), aRow), unmeasuredRows.end());
+                for (auto& row : unmeasuredRows)
+                    if (row > aRow)
+                        --row;
+            }
         }
         void reset_column_meta(const std::optional<item_presentation_model_index::column_type>& aColumn = {}) const
         {
@@ -1265,16 +1540,67 @@ namespace neogfx
             {
                 if (aColumn != std::nullopt && col != *aColumn)
                     continue;
-                column(col).width = std::nullopt;
                 column(col).headingExtents = std::nullopt;
             }
         }
         void reset_position_meta(item_presentation_model_index::row_type aFromRow) const
         {
-            iTotalHeight = std::nullopt;
-            iPositions.resize(rows());
-            for (std::size_t i = aFromRow; i < iPositions.size(); ++i)
-                iPositions[i] = std::nullopt;
+            iRowHeights.resize(std::min<std::size_t>(iRowHeights.size(), aFromRow));
+            iRowHeightTree.resize(std::min<std::size_t>(iRowHeightTree.size(), aFromRow + 1u));
+        }
+        void row_height_inserted(item_presentation_model_index::row_type aRow) const
+        {
+            if (aRow <= iRowHeights.size())
+                iRowHeights.insert(std::next(iRowHeights.begin(), aRow), std::nullopt);
+            iRowHeightTree.resize(std::min<std::size_t>(iRowHeightTree.size(), aRow + 1u));
+        }
+        void row_height_removed(item_presentation_model_index::row_type aRow) const
+        {
+            if (aRow < iRowHeights.size())
+                iRowHeights.erase(std::next(iRowHeights.begin(), aRow));
+            iRowHeightTree.resize(std::min<std::size_t>(iRowHeightTree.size(), aRow + 1u));
+        }
+        void invalidate_row_height(item_presentation_model_index::row_type aRow) const
+        {
+            if (aRow < iRowHeights.size() && iRowHeights[aRow] != std::nullopt)
+            {
+                iRowHeights[aRow] = std::nullopt;
+                iStaleRowHeights.push_back(aRow);
+            }
+        }
+        // Row heights are held in a Fenwick tree (iRowHeightTree[0] is unused) covering the first
+        // iRowHeightTree.size() - 1 rows; the tree is truncated when rows are inserted or removed and
+        // extended on demand, using cached heights where available.
+        void update_row_heights(item_presentation_model_index::row_type aRows, i_units_context const& aUnitsContext) const
+        {
+            for (auto row : iStaleRowHeights)
+                if (row + 1u < iRowHeightTree.size())
+                {
+                    auto const newHeight = item_height(item_presentation_model_index{ row }, aUnitsContext);
+                    auto const delta = newHeight - (row_height_sum(row + 1u) - row_height_sum(row));
+                    iRowHeights[row] = newHeight;
+                    for (std::size_t i = row + 1u; i < iRowHeightTree.size(); i += (i & (~i + 1u)))
+                        iRowHeightTree[i] += delta;
+                }
+            iStaleRowHeights.clear();
+            if (iRowHeights.size() < rows())
+                iRowHeights.resize(rows());
+            while (iRowHeightTree.size() <= aRows)
+            {
+                auto const row = static_cast<item_presentation_model_index::row_type>(iRowHeightTree.size() - 1u);
+                auto& height = iRowHeights[row];
+                if (height == std::nullopt)
+                    height = item_height(item_presentation_model_index{ row }, aUnitsContext);
+                auto const node = iRowHeightTree.size();
+                iRowHeightTree.push_back(*height + row_height_sum(row) - row_height_sum(node - (node & (~node + 1u))));
+            }
+        }
+        double row_height_sum(std::size_t aRows) const
+        {
+            double sum = 0.0;
+            for (std::size_t i = aRows; i > 0u; i -= (i & (~i + 1u)))
+                sum += iRowHeightTree[i];
+            return sum;
         }
     private:
         const_iterator cbegin() const
@@ -1352,11 +1678,16 @@ namespace neogfx
         mutable column_info_array iColumns;
         mutable column_map_type iColumnMap;
         mutable optional_font iDefaultFont;
-        mutable std::optional<i_scrollbar::value_type> iTotalHeight;
-        mutable neolib::segmented_array<optional_position, 256> iPositions;
+        mutable std::vector<optional_dimension> iRowHeights;
+        mutable std::vector<double> iRowHeightTree = { 0.0 };
+        mutable std::vector<item_presentation_model_index::row_type> iStaleRowHeights;
         bool iAlternatingRowColor;
         std::deque<sort_by_param> iSortOrder;
         std::vector<filter> iFilters;
+        std::vector<compiled_filter> iCompiledFilters;
+        mutable std::vector<folded_text_list> iFoldedText;
+        mutable std::vector<std::optional<search_index>> iSearchIndices;
+        bool iFilterRefinable = false;
         sink iSink;
         std::uint32_t iUpdating = 0u;
         bool iFiltering = false;
@@ -42,13 +42,14 @@ namespace neogfx
         typedef Alloc allocator_type;
     private:
         using concrete_item_selection = neolib::map<item_presentation_model_index, selection_area, std::less<item_presentation_model_index>, allocator_type>;
-        typedef std::deque<std::pair<item_presentation_model_index, item_selection_operation>> operation_queue_t;
+        typedef std::deque<std::tuple<item_presentation_model_index, item_presentation_model_index, item_selection_operation>> operation_queue_t;
     public:
         basic_item_selection_model(item_selection_mode aMode = item_selection_mode::SingleSelection) :
             iModel{ nullptr },
             iMode{ aMode },
             iSorting{ false },
             iFiltering{ false },
+            iSelectionSaves{ 0u },
             iNotifying{ false },
             iInQueue{ false }
         {
@@ -59,6 +60,7 @@ namespace neogfx
             iMode{ aMode },
             iSorting{ false },
             iFiltering{ false },
+            iSelectionSaves{ 0u },
             iNotifying{ false },
             iInQueue{ false }
         {
@@ -96,9 +98,15 @@ namespace neogfx
             iSink += presentation_model().item_model_changed([this](const i_item_model&)
             {
                 iCurrentIndex = std::nullopt;
-                reindex();
+                iSelection.clear();
+                iPreviousSelection.clear();
             });
-            iSink += presentation_model().item_removed([this](item_presentation_model_index const&)
+            iSink += presentation_model().item_added([this](item_presentation_model_index const& aIndex)
+            {
+                rows_inserted(iSelection, aIndex.row());
+                rows_inserted(iPreviousSelection, aIndex.row());
+            });
+            iSink += presentation_model().item_removed([this](item_presentation_model_index const& aIndex)
             {
                 if (has_current_index())
                 {
@@ -107,49 +115,62 @@ namespace neogfx
                     else if (iCurrentIndex->row() >= presentation_model().rows() - 1u)
                         iCurrentIndex->set_row(iCurrentIndex->row() - 1u);
                 }
-                reindex();
+                row_removed(iSelection, aIndex.row());
+                row_removed(iPreviousSelection, aIndex.row());
+            });
+            iSink += presentation_model().item_expanding([this](item_presentation_model_index const&)
+            {
+                save_selection();
             });
             iSink += presentation_model().item_expanded([this](item_presentation_model_index const& aIndex)
             {
                 if (has_current_index() && current_index().row() > aIndex.row())
                     iCurrentIndex = std::nullopt;
-                reindex();
+                restore_selection();
+            });
+            iSink += presentation_model().item_collapsing([this](item_presentation_model_index const&)
+            {
+                save_selection();
             });
             iSink += presentation_model().item_collapsed([this](item_presentation_model_index const& aIndex)
             {
                 if (has_current_index() && current_index().row() > aIndex.row())
                     iCurrentIndex = std::nullopt;
-                reindex();
+                restore_selection();
             });
             iSink += presentation_model().items_sorting([this]()
             {
                 neolib::scoped_flag sf{ iSorting };
-                iSavedModelIndex = has_current_index() ? presentation_model().to_item_model_index(current_index()) : optional_item_model_index{};
-                clear_current_index();
+                save_selection(true);
             });
             iSink += presentation_model().items_sorted([this]()
             {
                 neolib::scoped_flag sf{ iSorting };
-                if (iSavedModelIndex != std::nullopt)
-                    set_current_index(presentation_model().from_item_model_index(*iSavedModelIndex));
-                iSavedModelIndex = std::nullopt;
-                reindex();
+                restore_selection(true);
             });
             iSink += presentation_model().items_filtering([this]()
             {
                 neolib::scoped_flag sf{ iFiltering };
-                iSavedModelIndex = has_current_index() ? presentation_model().to_item_model_index(current_index()) : optional_item_model_index{};
-                clear_current_index();
+                save_selection(true);
             });
             iSink += presentation_model().items_filtered([this]()
             {
                 neolib::scoped_flag sf{ iFiltering };
-                if (iSavedModelIndex != std::nullopt && presentation_model().has_item_model_index(*iSavedModelIndex))
-                    set_current_index(presentation_model().from_item_model_index(*iSavedModelIndex));
-                else if (presentation_model().rows() >= 1)
-                    set_current_index(item_presentation_model_index{ 0u, 0u });
-                iSavedModelIndex = std::nullopt;
-                reindex();
+                restore_selection(true, true);
+            });
+            iSink += presentation_model().items_updated([this]()
+            {
+                // rows added or removed during a bulk update are not notified individually
+                if (presentation_model().rows() == 0u)
+                {
+                    iSelection.clear();
+                    iPreviousSelection.clear();
+                }
+                else
+                {
+                    remove_rows(iSelection, presentation_model().rows(), std::numeric_limits<item_presentation_model_index::row_type>::max());
+                    remove_rows(iPreviousSelection, presentation_model().rows(), std::numeric_limits<item_presentation_model_index::row_type>::max());
+                }
             });
             iSink += neolib::destroying(presentation_model(), [this]()
             {
@@ -157,6 +178,8 @@ namespace neogfx
                 iModel = nullptr;
                 iCurrentIndex = std::nullopt;
                 iSavedModelIndex = std::nullopt;
+                iSavedSelection.clear();
+                iSelectionSaves = 0u;
                 iSelection = {};
                 PresentationModelRemoved.trigger(*oldModel);
             });
@@ -326,13 +349,22 @@ namespace neogfx
         }
         bool is_selected(item_presentation_model_index const& aIndex) const override
         {
-            return (presentation_model().cell_meta(aIndex).selection & item_cell_selection_flags::Selected) == item_cell_selection_flags::Selected;
+            return find_area(iSelection, aIndex.row()) != iSelection.end();
         }    
         bool is_selectable(item_presentation_model_index const& aIndex) const override
         {
             return (presentation_model().cell_flags(aIndex) & item_cell_flags::Selectable) == item_cell_flags::Selectable;
         }
         void select(item_presentation_model_index const& aIndex, item_selection_operation aOperation) override
+        {
+            select(aIndex, aIndex, aOperation);
+        }
+        void select(item_model_index const& aIndex, item_selection_operation aOperation) override
+        {
+            presentation_model().expand_to(aIndex);
+            select(presentation_model().from_item_model_index(aIndex), aOperation);
+        }
+        void select(item_presentation_model_index const& aFirst, item_presentation_model_index const& aLast, item_selection_operation aOperation) override
         {
             if (aOperation == item_selection_operation::None)
                 return;
@@ -340,136 +372,53 @@ namespace neogfx
                 aOperation |= item_selection_operation::Queued;
             if ((aOperation & item_selection_operation::Queued) == item_selection_operation::Queued)
             {
-                iOperationQueue.push_back(std::make_pair(aIndex, aOperation));
+                iOperationQueue.emplace_back(aFirst, aLast, aOperation);
                 return;
             }
             if ((aOperation & item_selection_operation::CurrentIndex) == item_selection_operation::CurrentIndex)
             {
                 if ((aOperation & item_selection_operation::Select) == item_selection_operation::Select)
-                    set_current_index(aIndex);
+                    set_current_index(aLast);
                 else
                     clear_current_index();
             }
             if (mode() == item_selection_mode::NoSelection)
                 aOperation = item_selection_operation::Clear;
             // todo: cell and column
-            static auto find = [](item_presentation_model_index const& aIndex, concrete_item_selection& aSelection)
-            {
-                if (aSelection.empty())
-                    return aSelection.end();
-                auto iterExisting = aSelection.lower_bound(aIndex.with_column(0u));
-                if (iterExisting == aSelection.end())
-                    iterExisting = std::prev(iterExisting);
-                if (iterExisting != aSelection.begin())
-                {
-                    auto previous = std::prev(iterExisting);
-                    if (previous->second().topLeft.row() <= aIndex.row() &&
-                        previous->second().bottomRight.row() >= aIndex.row())
-                        return previous;
-                }
-                if (iterExisting->second().topLeft.row() <= aIndex.row() &&
-                    iterExisting->second().bottomRight.row() >= aIndex.row())
-                    return iterExisting;
-                return aSelection.end();
-            };
-            static auto find_adjacent = [](item_presentation_model_index const& aIndex, concrete_item_selection& aSelection)
+            auto const firstRow = std::min(aFirst.row(), aLast.row());
+            auto const lastRow = std::max(aFirst.row(), aLast.row());
+            bool const clear = (aOperation & item_selection_operation::Clear) == item_selection_operation::Clear;
+            bool const currentlySelected = find_area(iSelection, firstRow) != iSelection.end();
+            bool const select = (aOperation & item_selection_operation::Select) == item_selection_operation::Select ||
+                ((aOperation & item_selection_operation::Toggle) == item_selection_operation::Toggle && !currentlySelected);
+            bool const deselect = (aOperation & item_selection_operation::Deselect) == item_selection_operation::Deselect ||
+                ((aOperation & item_selection_operation::Toggle) == item_selection_operation::Toggle && currentlySelected);
+            auto update = [&, this](concrete_item_selection& aSelection)
             {
-                if (aSelection.empty())
-                    return aSelection.end();
-                auto iterExisting = find(aIndex.with_row(aIndex.row() - 1u), aSelection);
-                if (iterExisting != aSelection.end())
-                    return iterExisting;
-                return find(aIndex.with_row(aIndex.row() + 1u), aSelection);
-            };
-            auto update = [&, this](concrete_item_selection& aSelection, bool aUpdateCells)
-            {
-                bool const clear = (aOperation & item_selection_operation::Clear) == item_selection_operation::Clear;
-                bool const rowCurrentlySelected = aIndex.row() < presentation_model().rows() && (presentation_model().cell_meta(aIndex.with_column(0u)).selection & item_cell_selection_flags::Selected) ==
-                    item_cell_selection_flags::Selected;
-                bool const select = (aOperation & item_selection_operation::Select) == item_selection_operation::Select ||
-                    ((aOperation & item_selection_operation::Toggle) == item_selection_operation::Toggle && !rowCurrentlySelected);
-                bool const deselect = (aOperation & item_selection_operation::Deselect) == item_selection_operation::Deselect ||
-                    ((aOperation & item_selection_operation::Toggle) == item_selection_operation::Toggle && rowCurrentlySelected);
                 if (clear)
-                {
-                    if (aUpdateCells)
-                    {
-                        struct selection_clearer : i_item_presentation_model::i_meta_visitor
-                        {
-                            void visit(i_item_presentation_model::cell_meta_type& aMeta) override
-                            {
-                                aMeta.selection &= ~item_cell_selection_flags::Selected;
-                            }
-                        } selectionClearer;
-                        presentation_model().accept(selectionClearer, true);
-                    }
                     aSelection.clear();
-                }
                 if (select)
-                {
-                    if (find(aIndex, aSelection) == aSelection.end())
-                    {
-                        auto iterAdjacent = find_adjacent(aIndex, aSelection);
-                        if (iterAdjacent == aSelection.end())
-                            aSelection.emplace(aIndex.with_column(0u), selection_area{ aIndex.with_column(0u), aIndex.with_column(presentation_model().columns() - 1u) });
-                        else
-                        {
-                            auto& adjacent = *iterAdjacent;
-                            if (adjacent.second().bottomRight.row() == aIndex.row() - 1u)
-                                adjacent.second().bottomRight = aIndex.with_column(presentation_model().columns() - 1u);
-                            else
-                            {
-                                aSelection.emplace(aIndex.with_column(0u), selection_area{ aIndex.with_column(0u), adjacent.second().bottomRight });
-                                aSelection.erase(iterAdjacent);
-                            }
-                        }
-                    }
-                    if (aUpdateCells)
-                        for (auto& cellIndex : *this)
-                            if (cellIndex.row() == aIndex.row())
-                                presentation_model().cell_meta(cellIndex).selection |= item_cell_selection_flags::Selected;
-                }
+                    add_rows(aSelection, firstRow, lastRow);
                 else if (deselect)
-                {
-                    if (aUpdateCells)
-                        for (auto& cellIndex : *this)
-                            if (cellIndex.row() == aIndex.row())
-                                presentation_model().cell_meta(cellIndex).selection &= ~item_cell_selection_flags::Selected;
-                    auto iterExisting = find(aIndex, aSelection);
-                    if (iterExisting != aSelection.end())
-                    {
-                        auto& existing = *iterExisting;
-                        if (existing.second().topLeft.row() == existing.second().bottomRight.row())
-                            aSelection.erase(iterExisting);
-                        else if (existing.second().topLeft.row() == aIndex.row())
-                        {
-                            aSelection.emplace(aIndex.with_row(aIndex.row() + 1u).with_column(0u), selection_area{ aIndex.with_row(aIndex.row() + 1u).with_column(0u), existing.second().bottomRight });
-                            aSelection.erase(iterExisting);
-                        }
-                        else if (existing.second().bottomRight.row() == aIndex.row())
-                            existing.second().bottomRight.set_row(aIndex.row() - 1u);
-                        else
-                        {
-                            aSelection.emplace(aIndex.with_row(aIndex.row() + 1u).with_column(0u), selection_area{ aIndex.with_row(aIndex.row() + 1u).with_column(0u), existing.second().bottomRight });
-                            existing.second().bottomRight.set_row(aIndex.row() - 1u);
-                        }
-                    }
-                }
+                    remove_rows(aSelection, firstRow, lastRow);
             };
-            update(iSelection, true);
+            update(iSelection);
             if ((aOperation & item_selection_operation::Internal) != item_selection_operation::Internal)
             {
                 neolib::scoped_flag sf{ iNotifying };
                 SelectionChanged.trigger(iSelection, iPreviousSelection);
             }
-            update(iPreviousSelection, false);
+            update(iPreviousSelection);
             if ((aOperation & item_selection_operation::Internal) != item_selection_operation::Internal)
                 process_queue();
         }
-        void select(item_model_index const& aIndex, item_selection_operation aOperation) override
+        void select_all() override
         {
-            presentation_model().expand_to(aIndex);
-            select(presentation_model().from_item_model_index(aIndex), aOperation);
+            if (mode() != item_selection_mode::MultipleSelection && mode() != item_selection_mode::ExtendedSelection)
+                return;
+            if (presentation_model().rows() == 0u)
+                return;
+            select(item_presentation_model_index{ 0u, 0u }, item_presentation_model_index{ presentation_model().rows() - 1u, 0u }, item_selection_operation::ClearAndSelect);
         }
     public:
         bool sorting() const override
@@ -503,14 +452,139 @@ namespace neogfx
                 CurrentIndexChanged.trigger(iCurrentIndex, previousIndex);
             }
         }
-        void reindex()
+        // Selections are kept as row intervals keyed by their top left index; intervals never overlap or touch.
+        typename concrete_item_selection::const_iterator find_area(concrete_item_selection const& aSelection, item_presentation_model_index::row_type aRow) const
         {
-            iPreviousSelection.clear();
+            auto existing = aSelection.lower_bound(item_presentation_model_index{ aRow, 0u });
+            if (existing != aSelection.end() && existing->second().topLeft.row() == aRow)
+                return existing;
+            if (existing != aSelection.begin() && std::prev(existing)->second().bottomRight.row() >= aRow)
+                return std::prev(existing);
+            return aSelection.end();
+        }
+        void add_rows(concrete_item_selection& aSelection, item_presentation_model_index::row_type aFirst, item_presentation_model_index::row_type aLast) const
+        {
+            auto existing = aSelection.lower_bound(item_presentation_model_index{ aFirst, 0u });
+            if (existing != aSelection.begin() && std::prev(existing)->second().bottomRight.row() + 1u >= aFirst)
+                --existing;
+            while (existing != aSelection.end() && existing->second().topLeft.row() <= aLast + 1u)
+            {
+                aFirst = std::min(aFirst, existing->second().topLeft.row());
+                aLast = std::max(aLast, existing->second().bottomRight.row());
+                auto next = std::next(existing);
+                aSelection.erase(existing);
+                existing = next;
+            }
+            auto const lastColumn = std::max(presentation_model().columns(), 1u) - 1u;
+            aSelection.emplace(item_presentation_model_index{ aFirst, 0u }, selection_area{ item_presentation_model_index{ aFirst, 0u }, item_presentation_model_index{ aLast, lastColumn } });
+        }
+        void remove_rows(concrete_item_selection& aSelection, item_presentation_model_index::row_type aFirst, item_presentation_model_index::row_type aLast) const
+        {
+            auto existing = aSelection.lower_bound(item_presentation_model_index{ aFirst, 0u });
+            if (existing != aSelection.begin() && std::prev(existing)->second().bottomRight.row() >= aFirst)
+                --existing;
+            while (existing != aSelection.end() && existing->second().topLeft.row() <= aLast)
+            {
+                auto const area = existing->second();
+                auto next = std::next(existing);
+                aSelection.erase(existing);
+                if (area.topLeft.row() < aFirst)
+                    aSelection.emplace(area.topLeft, selection_area{ area.topLeft, area.bottomRight.with_row(aFirst - 1u) });
+                if (area.bottomRight.row() > aLast)
+                {
+                    auto const topLeft = area.topLeft.with_row(aLast + 1u);
+                    aSelection.emplace(topLeft, selection_area{ topLeft, area.bottomRight });
+                }
+                existing = next;
+            }
+        }
+        void rows_inserted(concrete_item_selection& aSelection, item_presentation_model_index::row_type aRow) const
+        {
+            if (aSelection.empty() || std::prev(aSelection.end())->second().bottomRight.row() < aRow)
+                return;
+            std::vector<std::pair<item_presentation_model_index::row_type, item_presentation_model_index::row_type>> areas;
+            for (auto const& area : aSelection)
+                areas.emplace_back(area.second().topLeft.row(), area.second().bottomRight.row());
+            aSelection.clear();
+            for (auto [top, bottom] : areas)
+            {
+                if (top >= aRow)
+                    ++top;
+                else if (bottom >= aRow)
+                {
+                    // the new row splits the area and is not itself selected
+                    add_rows(aSelection, top, aRow - 1u);
+                    top = aRow + 1u;
+                }
+                if (bottom >= aRow)
+                    ++bottom;
+                add_rows(aSelection, top, bottom);
+            }
+        }
+        void row_removed(concrete_item_selection& aSelection, item_presentation_model_index::row_type aRow) const
+        {
+            remove_rows(aSelection, aRow, aRow);
+            if (aSelection.empty() || std::prev(aSelection.end())->second().bottomRight.row() < aRow)
+                return;
+            std::vector<std::pair<item_presentation_model_index::row_type, item_presentation_model_index::row_type>> areas;
+            for (auto const& area : aSelection)
+                areas.emplace_back(area.second().topLeft.row(), area.second().bottomRight.row());
+            aSelection.clear();
+            for (auto [top, bottom] : areas)
+            {
+                if (top > aRow)
+                {
+                    --top;
+                    --bottom;
+                }
+                add_rows(aSelection, top, bottom);
+            }
+        }
+        // Sorting, filtering, expanding and collapsing can nest (filtering a sortable model re-sorts it
+        // before items_filtered); only the outermost change saves and restores the selection.
+        void save_selection(bool aCurrentIndex = false)
+        {
+            if (iSelectionSaves++ != 0u)
+                return;
+            if (aCurrentIndex)
+            {
+                iSavedModelIndex = has_current_index() ? presentation_model().to_item_model_index(current_index()) : optional_item_model_index{};
+                clear_current_index();
+            }
+            iSavedSelection.clear();
+            for (auto const& area : iSelection)
+                for (auto row = area.second().topLeft.row(); row <= area.second().bottomRight.row() && row < presentation_model().rows(); ++row)
+                    iSavedSelection.push_back(presentation_model().to_item_model_index(item_presentation_model_index{ row, 0u }));
+        }
+        void restore_selection(bool aCurrentIndex = false, bool aFirstRowIfLost = false)
+        {
+            if (iSelectionSaves == 0u || --iSelectionSaves != 0u)
+                return;
+            if (aCurrentIndex)
+            {
+                if (iSavedModelIndex != std::nullopt && presentation_model().has_item_model_index(*iSavedModelIndex))
+                    set_current_index(presentation_model().from_item_model_index(*iSavedModelIndex));
+                else if (aFirstRowIfLost && presentation_model().rows() >= 1)
+                    set_current_index(item_presentation_model_index{ 0u, 0u });
+                iSavedModelIndex = std::nullopt;
+            }
+            std::vector<item_presentation_model_index::row_type> rows;
+            for (auto const& modelIndex : iSavedSelection)
+                if (presentation_model().has_item_model_index(modelIndex))
+                    rows.push_back(presentation_model().from_item_model_index(modelIndex).row());
+            iSavedSelection.clear();
+            std::sort(rows.begin(), rows.end());
             iSelection.clear();
-            for (item_presentation_model_index::row_type row = 0; row < presentation_model().rows(); ++row)
-                for (item_presentation_model_index::column_type column = 0; column < presentation_model().columns(); ++column)
-                    if ((presentation_model().cell_meta(item_presentation_model_index{ row, column }).selection & item_cell_selection_flags::Selected) == item_cell_selection_flags::Selected)
-                        select(item_presentation_model_index{ row, column }, item_selection_operation::Select | item_selection_operation::Internal);
+            iPreviousSelection.clear();
+            for (auto run = rows.begin(); run != rows.end();)
+            {
+                auto runEnd = std::next(run);
+                while (runEnd != rows.end() && *runEnd == *std::prev(runEnd) + 1u)
+                    ++runEnd;
+                add_rows(iSelection, *run, *std::prev(runEnd));
+                add_rows(iPreviousSelection, *run, *std::prev(runEnd));
+                run = runEnd;
+            }
         }
         void process_queue()
         {
@@ -521,7 +595,7 @@ namespace neogfx
             {
                 auto next = iOperationQueue.front();
                 iOperationQueue.pop_front();
-                select(next.first, next.second & ~item_selection_operation::Queued);
+                select(std::get<0>(next), std::get<1>(next), std::get<2>(next) & ~item_selection_operation::Queued);
             }
         }
     private:
@@ -529,10 +603,12 @@ namespace neogfx
         item_selection_mode iMode;
         optional_item_presentation_model_index iCurrentIndex;
         optional_item_model_index iSavedModelIndex;
+        std::vector<item_model_index> iSavedSelection;
         concrete_item_selection iPreviousSelection;
         concrete_item_selection iSelection;
         bool iSorting;
         bool iFiltering;
+        uint32_t iSelectionSaves;
         bool iNotifying;
         bool iInQueue;
         operation_queue_t iOperationQueue;
@@ -197,6 +197,7 @@ namespace neogfx
         optional_item_presentation_model_index iClickedItem;
         optional_item_presentation_model_index iClickedCheckBox;
         optional_item_model_index iSavedModelIndex;
+        optional_item_model_index iSelectionAnchor;
         basic_size<i_scrollbar::value_type> iOldPositionForScrollbarVisibility;
         std::optional<drag_drop_item> iDragDropItem;
     };
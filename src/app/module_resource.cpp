@@ -71,7 +71,15 @@ namespace neogfx
 
     void* module_resource::data()
     {
-        throw const_data();
+        // module data is read only so it is copied the first time write access is asked for
+        if (!iWritableData)
+        {
+            auto const bytes = static_cast<const uint8_t*>(iData);
+            iWritableData.emplace(bytes, bytes + iSize);
+            iData = iWritableData->data();
+            iHash = std::nullopt;
+        }
+        return iWritableData->data();
     }
 
     std::size_t module_resource::size() const
@@ -18,8 +18,13 @@
 */
 
 #include <neogfx/neogfx.hpp>
-#include <sstream>
+#include <fstream>
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <openssl/sha.h>
 #include <neolib/io/uri.hpp>
 #include <neolib/file/zip.hpp>
@@ -27,6 +32,121 @@
 
 namespace neogfx
 {
+    namespace
+    {
+        // An asset archive's central directory indexed by entry path so that resolving one entry neither scans nor
+        // decompresses the rest of the archive. Indices are kept most recently used first and evicted once the
+        // archive data they hold exceeds the memory budget (embedded archives cost nothing as their data lives
+        // in the module). Decompressed entries are owned by the resources that request them. Archives are loaded
+        // without the cache locked as loading an embedded archive goes through the resource manager; the cache
+        // is emptied when the resource manager is cleaned so that no archive resource outlives it.
+        class archive_index_cache
+        {
+        private:
+            struct archive_index
+            {
+                std::string key;
+                ref_ptr<i_resource> source;
+                std::unique_ptr<neolib::zip> archive;
+                std::unordered_map<std::string, std::size_t> entries;
+                std::size_t cost = 0;
+            };
+            typedef std::list<archive_index> index_list;
+        public:
+            static constexpr std::size_t MemoryBudget = 64 * 1024 * 1024;
+        public:
+            static archive_index_cache& instance()
+            {
+                static archive_index_cache sInstance;
+                return sInstance;
+            }
+        public:
+            bool extract_file_entry(std::string const& aPath, std::string const& aEntry, neolib::zip::buffer_type& aResult)
+            {
+                return extract("file:" + aPath, aEntry, aResult, [&](archive_index& aIndex)
+                {
+                    aIndex.archive = std::make_unique<neolib::zip>(aPath);
+                    aIndex.cost = static_cast<std::size_t>(boost::filesystem::file_size(aPath));
+                });
+            }
+            bool extract_embedded_entry(i_resource_manager& aManager, std::string const& aArchiveUri, std::string const& aEntry, neolib::zip::buffer_type& aResult)
+            {
+                return extract(aArchiveUri, aEntry, aResult, [&](archive_index& aIndex)
+                {
+                    aIndex.source = aManager.load_resource(string{ aArchiveUri });
+                    aIndex.archive = std::make_unique<neolib::zip>(aIndex.source->cdata(), aIndex.source->size());
+                });
+            }
+            void clear()
+            {
+                index_list released;
+                std::unique_lock<std::mutex> lock{ iMutex };
+                released.swap(iIndices);
+                iCost = 0;
+            }
+        private:
+            template <typename Loader>
+            bool extract(std::string const& aKey, std::string const& aEntry, neolib::zip::buffer_type& aResult, Loader aLoader)
+            {
+                // declared before the lock so that loaded and evicted archive resources are released after it
+                index_list loaded;
+                index_list evicted;
+                {
+                    std::unique_lock<std::mutex> lock{ iMutex };
+                    auto existing = find(aKey);
+                    if (existing != iIndices.end())
+                        return extract(*existing, aEntry, aResult);
+                }
+                auto& newIndex = loaded.emplace_back(archive_index{ aKey });
+                aLoader(newIndex);
+                for (std::size_t i = 0; i < newIndex.archive->file_count(); ++i)
+                    newIndex.entries.emplace(newIndex.archive->file_path(i), i);
+                std::unique_lock<std::mutex> lock{ iMutex };
+                auto existing = find(aKey); // another thread may have loaded the archive meanwhile
+                if (existing == iIndices.end())
+                {
+                    iIndices.splice(iIndices.begin(), loaded);
+                    iCost += iIndices.front().cost;
+                    while (iCost > MemoryBudget && iIndices.size() > 1u)
+                    {
+                        iCost -= iIndices.back().cost;
+                        evicted.splice(evicted.end(), iIndices, std::prev(iIndices.end()));
+                    }
+                    existing = iIndices.begin();
+                }
+                return extract(*existing, aEntry, aResult);
+            }
+            index_list::iterator find(std::string const& aKey)
+            {
+                for (auto existing = iIndices.begin(); existing != iIndices.end(); ++existing)
+                    if (existing->key == aKey)
+                    {
+                        iIndices.splice(iIndices.begin(), iIndices, existing);
+                        return iIndices.begin();
+                    }
+                return iIndices.end();
+            }
+            static bool extract(archive_index& aIndex, std::string const& aEntry, neolib::zip::buffer_type& aResult)
+            {
+                auto entry = aIndex.entries.find(aEntry);
+                if (entry == aIndex.entries.end())
+                    return false;
+                aIndex.archive->extract_to(entry->second, aResult);
+                return true;
+            }
+        private:
+            std::mutex iMutex;
+            index_list iIndices;
+            std::size_t iCost = 0;
+        };
+    }
+
+    struct resource::mapped_file
+    {
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+    };
+
     resource::resource(i_resource_manager& aManager, std::string const& aUri) : 
         iManager{aManager}, iUri{aUri}, iSize{0}
     {
@@ -35,48 +155,38 @@ namespace neogfx
         {
             if (uri.fragment().empty()) // individual asset file
             { 
-                iData.resize(static_cast<std::size_t>(boost::filesystem::file_size(uri.path())));
-                std::ifstream input(uri.path(), std::ios::binary | std::ios::in);
-                input.read(reinterpret_cast<char*>(data()), iData.size());
-                iSize = iData.size();
-            }
-            else // asset archive
-            {
-                neolib::zip archive{uri.path()};
-                for (std::size_t i = 0; i < archive.file_count(); ++i)
+                auto const fileSize = static_cast<std::size_t>(boost::filesystem::file_size(uri.path()));
+                if (fileSize != 0)
                 {
-                    if (archive.file_path(i) == uri.fragment())
+                    try
                     {
-                        archive.extract_to(i, iData.to_std_vector());
-                        iSize = iData.size();
+                        // map a private (copy-on-write) view of the file rather than copying it into memory
+                        boost::interprocess::file_mapping file{ uri.path().c_str(), boost::interprocess::read_only };
+                        boost::interprocess::mapped_region region{ file, boost::interprocess::copy_on_write, 0, fileSize };
+                        iMappedFile = std::make_unique<mapped_file>(mapped_file{ std::move(file), std::move(region) });
                     }
+                    catch (boost::interprocess::interprocess_exception const&)
+                    {
+                        iData.resize(fileSize);
+                        std::ifstream input(uri.path(), std::ios::binary | std::ios::in);
+                        input.read(reinterpret_cast<char*>(&iData[0]), iData.size());
+                    }
+                    iSize = fileSize;
                 }
             }
+            else // asset archive
+            {
+                if (archive_index_cache::instance().extract_file_entry(uri.path(), uri.fragment(), iData.to_std_vector()))
+                    iSize = iData.size();
+            }
         }
         else if (uri.scheme().empty())
         {
             if (!uri.fragment().empty()) // asset archive
             {
-                auto assetArchive = aManager.load_resource(string{ ":/" + uri.path() });
-                neolib::zip archive{assetArchive->cdata(), assetArchive->size()};
-                for (std::size_t i = 0; i < archive.file_count(); ++i)
-                {
-                    if (archive.file_path(i) == uri.fragment())
-                    {
-                        archive.extract_to(i, iData.to_std_vector());
-                        iSize = iData.size();
-                    }
-                    else
-                    {
-                        neolib::uri otherResource(uri);
-                        otherResource.set_fragment(archive.file_path(i));
-                        std::ostringstream oss;
-                        oss << otherResource;
-                        neolib::zip::buffer_type buffer;
-                        archive.extract_to(i, buffer);
-                        aManager.add_resource(string{ oss.str() }, & buffer[0], buffer.size());
-                    }
-                }
+                // other entries are extracted on demand when they are themselves requested
+                if (archive_index_cache::instance().extract_embedded_entry(aManager, ":/" + uri.path(), uri.fragment(), iData.to_std_vector()))
+                    iSize = iData.size();
             }
         }
     }
@@ -91,16 +201,21 @@ namespace neogfx
         iManager.cleanup();
     }
 
+    void resource::clear_archive_indices()
+    {
+        archive_index_cache::instance().clear();
+    }
+
     bool resource::available() const
     {
-        return iSize != 0 && iData.size() == iSize;
+        return iSize != 0 && loaded_size() == iSize;
     }
 
     bool resource::downloading() const
     {
         if (iSize == 0)
             return false;
-        else if (iData.size() != iSize)
+        else if (loaded_size() != iSize)
             return true;
         else
             return false;
@@ -110,8 +225,8 @@ namespace neogfx
     {
         if (iSize == 0)
             return 0.0;
-        else if (iData.size() != iSize)
-            return 100.0 * iData.size() / iSize;
+        else if (loaded_size() != iSize)
+            return 100.0 * loaded_size() / iSize;
         else
             return 100.0;
     }
@@ -136,6 +251,8 @@ namespace neogfx
     
     const void* resource::cdata() const
     {
+        if (iMappedFile)
+            return iMappedFile->region.get_address();
         if (iData.empty())
             throw no_data();
         return &iData[0];
@@ -153,7 +270,7 @@ namespace neogfx
 
     std::size_t resource::size() const
     {
-        return iData.size();
+        return loaded_size();
     }
 
     resource::hash_digest_type const& resource::hash() const
@@ -166,4 +283,11 @@ namespace neogfx
         }
         return *iHash;
     }
+
+    std::size_t resource::loaded_size() const
+    {
+        if (iMappedFile)
+            return iMappedFile->region.get_size();
+        return iData.size();
+    }
 }
\ No newline at end of file
@@ -55,7 +55,8 @@ namespace neogfx
 
     void resource_manager::add_module_resource(i_string const& aUri, const void* aResourceData, std::size_t aResourceSize)
     {
-        iResources.insert(aUri, decltype(iResources)::mapped_type{ ref_ptr<i_resource>{ make_ref<resource>(*this, aUri, aResourceData, aResourceSize) } });
+        // module data lives as long as the module so is referenced in place rather than copied
+        iResources.insert(aUri, decltype(iResources)::mapped_type{ ref_ptr<i_resource>{ make_ref<module_resource>(aUri.to_std_string(), aResourceData, aResourceSize) } });
     }
 
     void resource_manager::load_resource(i_string const& aUri, i_ref_ptr<i_resource>& aResult)
@@ -98,6 +99,7 @@ namespace neogfx
 
     void resource_manager::clean()
     {
+        resource::clear_archive_indices();
         decltype(iResources) resources;
         resources.to_std_map().swap(iResources.to_std_map());
         decltype(iResourceArchives) resourceArchives;
@@ -106,37 +106,61 @@ namespace neogfx
 
 	audio_device::audio_device(audio_context aContext, i_audio_device_info const& aDeviceInfo, audio_data_format const& aDataFormat) :
 		iInfo{ aDeviceInfo }, iDataFormat{ aDataFormat }
+	{
+		init(audio_context{});
+	}
+
+	audio_device::audio_device(audio_data_format const& aDataFormat) :
+		iInfo{ audio_device_id{}, audio_device_type::Playback, string{ "Null" }, false, vector<audio_data_format>{} }, iDataFormat{ aDataFormat }, iOwnContext{ ma_context{} }
+	{
+		ma_backend const backend = ma_backend_null;
+		if (ma_context_init(&backend, 1, NULL, std::any_cast<ma_context>(&iOwnContext)) != MA_SUCCESS)
+			throw std::runtime_error("neogfx::audio_device::audio_device");
+		try
+		{
+			init(std::any_cast<ma_context>(&iOwnContext));
+		}
+		catch (...)
+		{
+			ma_context_uninit(std::any_cast<ma_context>(&iOwnContext));
+			throw;
+		}
+	}
+
+	void audio_device::init(audio_context aContext)
 	{
 		auto callback = [](ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 		{
 			auto& device = *static_cast<audio_device*>(pDevice->pUserData);
-			std::unique_lock lock{ device.iMutex };
-			for (auto& source : device.iSources)
-			{
-				// todo: channel mapping
-				if (source.expiryTime > std::chrono::steady_clock::now())
-					source.bitstream->generate(audio_channel::Left | audio_channel::Right, frameCount, static_cast<float*>(pOutput));
-			}
+			device.apply_commands();
+			device.mix(static_cast<float*>(pOutput), frameCount);
 		};
 
-		iConfig = ma_device_config_init(from_audio_device_type(aDeviceInfo.type()));
+		iConfig = ma_device_config_init(from_audio_device_type(iInfo.type()));
 		auto& config = *std::any_cast<ma_device_config>(&iConfig);
-		config.playback.format = from_audio_sample_format(aDataFormat.sampleFormat);
-		config.playback.channels = aDataFormat.channels;
-		config.capture.format = from_audio_sample_format(aDataFormat.sampleFormat);
-		config.capture.channels = aDataFormat.channels;
-		config.sampleRate = static_cast<decltype(config.sampleRate)>(aDataFormat.sampleRate);
+		config.playback.format = from_audio_sample_format(iDataFormat.sampleFormat);
+		config.playback.channels = iDataFormat.channels;
+		config.capture.format = from_audio_sample_format(iDataFormat.sampleFormat);
+		config.capture.channels = iDataFormat.channels;
+		config.sampleRate = static_cast<decltype(config.sampleRate)>(iDataFormat.sampleRate);
 		config.dataCallback = callback;
 		config.pUserData = this;
 		
 		iHandle = ma_device{};
-		if (ma_device_init(NULL, &config, std::any_cast<ma_device>(&iHandle)) != MA_SUCCESS)
+		auto const context = aContext.has_value() ? std::any_cast<ma_context*>(aContext) : nullptr;
+		if (ma_device_init(context, &config, std::any_cast<ma_device>(&iHandle)) != MA_SUCCESS)
 			throw std::runtime_error("neogfx::audio_device::audio_device");
+
+		iSources.reserve(MaxSources);
+		auto const periodFrames = std::max<std::size_t>(std::any_cast<ma_device>(&iHandle)->playback.internalPeriodSizeInFrames, 1024u);
+		iMixBus.resize(periodFrames * 2u);
 	}
 		
 	audio_device::~audio_device()
 	{
 		ma_device_uninit(std::any_cast<ma_device>(&iHandle));
+		if (iOwnContext.has_value())
+			ma_context_uninit(std::any_cast<ma_context>(&iOwnContext));
 	}
 
 	i_audio_device_info const& audio_device::info() const
@@ -151,19 +175,120 @@ namespace neogfx
 
 	void audio_device::start()
 	{
+		std::unique_lock lock{ iProducerMutex };
 		ma_device_start(std::any_cast<ma_device>(&iHandle));
+		iStarted = (ma_device_is_started(std::any_cast<ma_device>(&iHandle)) != MA_FALSE);
 	}
 
 	void audio_device::stop()
 	{
+		std::unique_lock lock{ iProducerMutex };
+		// ma_device_stop waits for the callback to return so the ring has no consumer afterwards
 		ma_device_stop(std::any_cast<ma_device>(&iHandle));
+		iStarted = false;
+		apply_commands();
 	}
 
 	void audio_device::play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration)
 	{
-		std::unique_lock lock{ iMutex };
-		iSources.push_back(source{
-			ref_ptr<i_audio_bitstream>{ ref_ptr<i_audio_bitstream>{}, &aBitstream },
-			std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::milliseconds>(aDuration) });
+		play(aBitstream, aDuration, 1.0f, 0.0f);
+	}
+
+	void audio_device::play(i_audio_bitstream& aBitstream, std::chrono::duration<double> const& aDuration, float aGain, float aPan)
+	{
+		// balance pan: centre is unity gain on both channels, panning attenuates the opposite channel
+		auto const pan = std::clamp(aPan, -1.0f, 1.0f);
+		auto const frames = static_cast<audio_frame_count>(std::llround(aDuration.count() * iDataFormat.sampleRate));
+		push_command(command{ command_type::Add, &aBitstream, frames, aGain * std::min(1.0f, 1.0f - pan), aGain * std::min(1.0f, 1.0f + pan) });
+	}
+
+	void audio_device::stop(i_audio_bitstream& aBitstream)
+	{
+		push_command(command{ command_type::Remove, &aBitstream });
+	}
+
+	void audio_device::push_command(command const& aCommand)
+	{
+		std::unique_lock lock{ iProducerMutex };
+		auto const tail = iCommandTail.load(std::memory_order_relaxed);
+		auto const next = (tail + 1u) % CommandQueueCapacity;
+		// a stopped device's ring is always drained so it can only fill if the callback has stalled; don't block
+		// the caller on it
+		if (next == iCommandHead.load(std::memory_order_acquire))
+			throw command_queue_full();
+		iCommands[tail] = aCommand;
+		iCommandTail.store(next, std::memory_order_release);
+		if (!iStarted)
+			apply_commands();
+	}
+
+	void audio_device::apply_commands()
+	{
+		auto head = iCommandHead.load(std::memory_order_relaxed);
+		auto const tail = iCommandTail.load(std::memory_order_acquire);
+		for (; head != tail; head = (head + 1u) % CommandQueueCapacity)
+		{
+			auto const& next = iCommands[head];
+			switch (next.type)
+			{
+			case command_type::Add:
+				if (iSources.size() < MaxSources && next.frames != 0u)
+					iSources.push_back(source{ next.bitstream, next.frames, next.leftGain, next.rightGain });
+				break;
+			case command_type::Remove:
+				for (std::size_t s = 0u; s < iSources.size();)
+				{
+					if (iSources[s].bitstream == next.bitstream)
+					{
+						iSources[s] = iSources.back();
+						iSources.pop_back();
+					}
+					else
+						++s;
+				}
+				break;
+			}
+		}
+		iCommandHead.store(head, std::memory_order_release);
+	}
+
+	void audio_device::mix(float* aOutput, audio_frame_count aFrameCount)
+	{
+		// todo: channel mapping beyond mono and stereo
+		auto const channels = static_cast<std::size_t>(iDataFormat.channels);
+		auto const busFrames = static_cast<audio_frame_count>(iMixBus.size() / 2u);
+		for (audio_frame_count offset = 0u; offset < aFrameCount; offset += busFrames)
+		{
+			auto const chunk = std::min(busFrames, aFrameCount - offset);
+			auto output = aOutput + offset * channels;
+			for (std::size_t index = 0u; index < iSources.size();)
+			{
+				auto& s = iSources[index];
+				auto const frames = std::min(chunk, s.framesRemaining);
+				std::fill(iMixBus.begin(), iMixBus.begin() + frames * 2u, 0.0f);
+				s.bitstream->generate(audio_channel::Left | audio_channel::Right, frames, iMixBus.data());
+				auto bus = iMixBus.data();
+				auto out = output;
+				for (audio_frame_count frame = 0u; frame < frames; ++frame, bus += 2, out += channels)
+				{
+					if (channels == 1u)
+						out[0] += (bus[0] * s.leftGain + bus[1] * s.rightGain) * 0.5f;
+					else
+					{
+						out[0] += bus[0] * s.leftGain;
+						out[1] += bus[1] * s.rightGain;
+					}
+				}
+				// expiry is sample accurate: a source stops on the exact frame its duration elapses
+				s.framesRemaining -= frames;
+				if (s.framesRemaining == 0u)
+				{
+					s = iSources.back();
+					iSources.pop_back();
+				}
+				else
+					++index;
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -49,6 +49,12 @@ namespace neogfx
         auto noteLength = service<i_audio>().instrument_atlas().instrument(iInstrument, sample_rate(), aNote).length();
 
         iComposition.emplace_back(aNote, noteLength, aAmplitude, aWhen, static_cast<time_interval>(aDuration.count() * sample_rate()));
+        // notes are usually composed in order so the schedule can simply be extended
+        if (!iScheduleDirty && (iSchedule.empty() || iComposition[iSchedule.back()].start <= aWhen))
+            iSchedule.push_back(iComposition.size() - 1u);
+        else
+            iScheduleDirty = true;
+        iLongestNote = std::max(iLongestNote, noteLength);
         iInputCursor = aWhen + iComposition.back().duration;
         return iInputCursor;
     }
@@ -75,22 +81,49 @@ namespace neogfx
 
     void audio_instrument::generate_from(audio_channel aChannel, audio_frame_index aFrameFrom, audio_frame_count aFrameCount, float* aOutputFrames)
     {
-        for (auto next = iComposition.begin(); next != iComposition.end(); ++next)
+        update_schedule();
+        auto const channels = channel_count(aChannel);
+        auto const frameTo = aFrameFrom + aFrameCount;
+        // only notes starting no earlier than the longest note before the window can overlap it
+        auto const earliestStart = aFrameFrom > iLongestNote ? aFrameFrom - iLongestNote : 0ULL;
+        auto& atlas = service<i_audio>().instrument_atlas();
+        auto next = std::lower_bound(iSchedule.begin(), iSchedule.end(), earliestStart,
+            [&](std::size_t aPart, time_point aStart) { return iComposition[aPart].start < aStart; });
+        for (; next != iSchedule.end() && iComposition[*next].start < frameTo; ++next)
         {
-            if (aFrameFrom < next->start || aFrameFrom > next->start + next->noteLength.value())
+            auto const& part = iComposition[*next];
+            auto const noteEnd = part.start + part.noteLength.value();
+            if (noteEnd <= aFrameFrom)
+                continue;
+            auto const from = std::max(aFrameFrom, part.start);
+            auto const count = std::min(frameTo, noteEnd) - from;
+            auto const pos = from - part.start;
+            // this runs on the audio callback so it mustn't wait for a note to be prepared; play_note waits for
+            // each note so one that still isn't ready here is skipped rather than blocking the device
+            if (!atlas.note_ready(iInstrument, sample_rate(), part.note.value()))
                 continue;
-            auto pos = aFrameFrom - next->start;
-            auto count = std::min(next->noteLength.value() - pos, aFrameCount);
             thread_local std::vector<float> buffer;
             buffer.resize(count);
-            if (next->note)
-                service<i_audio>().instrument_atlas().instrument(iInstrument, sample_rate(), next->note.value()).generate_from(
-                    aChannel, pos, count, buffer.data());
-            auto output = aOutputFrames;
+            atlas.instrument(iInstrument, sample_rate(), part.note.value()).generate_from(aChannel, pos, count, buffer.data());
+            apply_envelope(pos, part.duration, buffer.data(), count);
+            auto output = aOutputFrames + (from - aFrameFrom) * channels;
             for (auto const& sample : buffer)
-                for (int channel = 0; channel < channel_count(aChannel); ++channel)
-                    (*output++) += (sample * next->amplitude.value() * apply_envelope(pos + &sample - &buffer[0], next->duration));
+                for (int channel = 0; channel < channels; ++channel)
+                    (*output++) += (sample * part.amplitude.value());
         }
-        iOutputCursor += aFrameCount;
+        iOutputCursor = frameTo;
+    }
+
+    void audio_instrument::update_schedule()
+    {
+        if (!iScheduleDirty)
+            return;
+        iSchedule.clear();
+        for (std::size_t i = 0u; i < iComposition.size(); ++i)
+            if (iComposition[i].note)
+                iSchedule.push_back(i);
+        std::stable_sort(iSchedule.begin(), iSchedule.end(),
+            [&](std::size_t aLhs, std::size_t aRhs) { return iComposition[aLhs].start < iComposition[aRhs].start; });
+        iScheduleDirty = false;
     }
 }
\ No newline at end of file
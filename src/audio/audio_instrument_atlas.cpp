@@ -19,6 +19,7 @@
 
 #include <neogfx/neogfx.hpp>
 #include <sstream>
+#include <fstream>
 #include <filesystem>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -48,6 +49,8 @@ namespace neogfx
 
 		if (std::filesystem::exists(atlasFile))
 		{
+			iAtlasFileSize = std::filesystem::file_size(atlasFile);
+			iAtlasFileTime = static_cast<std::int64_t>(std::filesystem::last_write_time(atlasFile).time_since_epoch().count());
 			neolib::zip zipFile(atlasFile);
 			std::istringstream metaDataFile{ zipFile.extract_to_string(zipFile.index_of("meta.json")) };
 			boost::property_tree::ptree metaData;
@@ -108,18 +111,36 @@ namespace neogfx
 		}
 	}
 
-	bool audio_instrument_atlas::load_instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate)
+	audio_instrument_atlas::~audio_instrument_atlas()
 	{
-		if (iSamples.find(aInstrument) == iSamples.end())
-			return false;
-		for (auto key = note::MIDI0; key <= note::Ab9; key = static_cast<note>(static_cast<std::uint32_t>(key) + 1))
 		{
-			if (iSamples[aInstrument].find(key) != iSamples[aInstrument].end())
-				(void)instrument(aInstrument, aSampleRate, key);
+			std::unique_lock lock{ iMutex };
+			iStopping = true;
+			iQueue.clear();
 		}
+		iWorkAvailable.notify_all();
+		for (auto& worker : iWorkers)
+			worker.join();
+	}
+
+	bool audio_instrument_atlas::load_instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate)
+	{
+		std::unique_lock lock{ iMutex };
+		auto existingInstrument = iSamples.find(aInstrument);
+		if (existingInstrument == iSamples.end())
+			return false;
+		// notes are prepared in the background; instrument() waits only for the note it is asked for
+		for (auto const& sampleInfo : existingInstrument->second)
+			(void)prepare(note_key{ aInstrument, aSampleRate, sampleInfo.first }, sampleInfo.second);
 		return true;
 	}
 
+	bool audio_instrument_atlas::note_ready(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote) const
+	{
+		// called from the audio callback so must not lock
+		return find_ready(note_key{ aInstrument, aSampleRate, aNote }) != nullptr;
+	}
+
 	class pure_tone : public audio_bitstream<i_audio_bitstream>
 	{
 	public:
@@ -139,7 +160,9 @@ namespace neogfx
 		}
 		void generate_from(audio_channel aChannel, audio_frame_index aFrameFrom, audio_frame_count aFrameCount, float* aOutputFrames) override
 		{
-			iOscillator.generate_from(aFrameFrom, aFrameCount, aOutputFrames);
+			// notes are shared so seeking must not touch our state (offline renders generate from several threads)
+			audio_oscillator oscillator{ sample_rate(), iOscillator.frequency() };
+			oscillator.generate_from(aFrameFrom, aFrameCount, aOutputFrames);
 		}
 	private:
 		audio_oscillator iOscillator;
@@ -148,7 +171,7 @@ namespace neogfx
 	class sample : public audio_bitstream<i_audio_bitstream>
 	{
 	public:
-		sample(audio_sample_rate aSampleRate, std::vector<float>&& aPcmFrames) :
+		sample(audio_sample_rate aSampleRate, std::shared_ptr<std::vector<float> const> const& aPcmFrames) :
 			audio_bitstream<i_audio_bitstream>{ aSampleRate },
 			iPcmFrames{ aPcmFrames }
 		{
@@ -156,82 +179,332 @@ namespace neogfx
 	public:
 		audio_frame_count length() const override
 		{
-			return iPcmFrames.size();
+			return iPcmFrames->size();
 		}
 		void generate(audio_channel aChannel, audio_frame_count aFrameCount, float* aOutputFrames) override
 		{
 			generate_from(aChannel, iCursor, aFrameCount, aOutputFrames);
+			iCursor = std::min<audio_frame_index>(iCursor + aFrameCount, iPcmFrames->size());
 		}
 		void generate_from(audio_channel aChannel, audio_frame_index aFrameFrom, audio_frame_count aFrameCount, float* aOutputFrames) override
 		{
 			std::fill(aOutputFrames, aOutputFrames + aFrameCount, 0.0f);
-			if (aFrameFrom >= iPcmFrames.size())
+			if (aFrameFrom >= iPcmFrames->size())
 				return;
-			auto count = std::min(iPcmFrames.size() - aFrameFrom, aFrameCount);
-			std::copy(std::next(iPcmFrames.begin(), aFrameFrom), std::next(iPcmFrames.begin(), aFrameFrom + count), aOutputFrames);
-			iCursor = aFrameFrom + count;
+			auto count = std::min(iPcmFrames->size() - aFrameFrom, aFrameCount);
+			std::copy(std::next(iPcmFrames->begin(), aFrameFrom), std::next(iPcmFrames->begin(), aFrameFrom + count), aOutputFrames);
 		}
 	private:
-		std::vector<float> iPcmFrames;
+		std::shared_ptr<std::vector<float> const> iPcmFrames;
 		audio_frame_index iCursor = 0ULL;
 	};
 
 	i_audio_bitstream& audio_instrument_atlas::instrument(neogfx::instrument aInstrument, audio_sample_rate aSampleRate, note aNote)
 	{
 		note_key const key{ aInstrument, aSampleRate, aNote };
+		if (auto ready = find_ready(key))
+			return *ready;
 
+		std::unique_lock lock{ iMutex };
 		auto existing = iNotes.find(key);
 		if (existing != iNotes.end())
 			return *existing->second;
 
 		if (aInstrument == neogfx::instrument::PureTone)
-		{
-			iNotes[key] = make_ref<pure_tone>(aSampleRate, frequency(aNote));
-			return *iNotes[key];
-		}
+			return publish(key, make_ref<pure_tone>(aSampleRate, frequency(aNote)));
 
 		auto existingInstrument = iSamples.find(aInstrument);
 		if (existingInstrument == iSamples.end())
 			throw audio_instrument_not_found(aInstrument);
 		auto existingNote = existingInstrument->second.find(aNote);
-		if (existingNote == iSamples[aInstrument].end())
+		if (existingNote == existingInstrument->second.end())
 			throw audio_instrument_note_not_found(aInstrument, aNote);
-		auto atlasFile = neolib::program_directory() + "/music.zip";
-		if (!std::filesystem::exists(atlasFile))
-			throw audio_instrument_atlas_file_found();
-		thread_local neolib::zip zipFile(atlasFile);
-		thread_local std::vector<std::uint8_t> buffer;
-		buffer.clear();
-		zipFile.extract_to(zipFile.index_of(existingNote->second.sampleFile), buffer);
-
-		ma_decoder decoder;
-		ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, static_cast<ma_uint32>(aSampleRate));
-		ma_result result = ma_decoder_init_memory(buffer.data(), buffer.size(), &config, &decoder);
-		if (result != MA_SUCCESS)
-			throw audio_instrument_sample_decode_failure();
-
-		std::vector<float> entireSample;
-
-		thread_local std::array<float, 16384> partSample;
-		std::uint64_t framesRead;
-		for (;;)
+
+		auto prepared = prepare(key, existingNote->second);
+		// if the note is still queued prepare it here rather than waiting behind unrelated notes
+		auto queued = std::find_if(iQueue.begin(), iQueue.end(), [&](auto const& aJob) { return aJob.first == key; });
+		if (queued != iQueue.end())
+		{
+			auto job = queued->second;
+			iQueue.erase(queued);
+			lock.unlock();
+			(*job)();
+			lock.lock();
+		}
+		else
+		{
+			lock.unlock();
+			prepared.wait();
+			lock.lock();
+		}
+
+		existing = iNotes.find(key);
+		if (existing != iNotes.end())
+			return *existing->second;
+		return publish(key, make_ref<sample>(aSampleRate, prepared.get()));
+	}
+
+	namespace
+	{
+		inline std::size_t ready_note_hash(std::uint64_t aPackedKey)
+		{
+			return static_cast<std::size_t>((aPackedKey * 0x9E3779B97F4A7C15ull) >> 32u);
+		}
+	}
+
+	std::optional<std::uint64_t> audio_instrument_atlas::packed_key(note_key const& aKey)
+	{
+		auto const& [instrument, sampleRate, note] = aKey;
+		auto const instrumentValue = static_cast<std::uint64_t>(instrument);
+		auto const noteValue = static_cast<std::uint64_t>(note);
+		if (sampleRate > 0xFFFFFFFFu || instrumentValue > 0xFFFFu || noteValue > 0x7FFFu)
+			return {};
+		// bit 0 is always set so a packed key is never the empty slot key
+		return (sampleRate << 32u) | (instrumentValue << 16u) | (noteValue << 1u) | 1u;
+	}
+
+	i_audio_bitstream* audio_instrument_atlas::find_ready(note_key const& aKey) const
+	{
+		auto const key = packed_key(aKey);
+		if (key == std::nullopt)
+			return nullptr;
+		auto slot = ready_note_hash(*key) % ReadyNoteCapacity;
+		for (std::size_t probe = 0u; probe < ReadyNoteCapacity; ++probe, slot = (slot + 1u) % ReadyNoteCapacity)
+		{
+			auto const slotKey = iReadyNotes[slot].key.load(std::memory_order_acquire);
+			if (slotKey == *key)
+				return iReadyNotes[slot].note.load(std::memory_order_relaxed);
+			if (slotKey == 0u)
+				break;
+		}
+		return nullptr;
+	}
+
+	i_audio_bitstream& audio_instrument_atlas::publish(note_key const& aKey, ref_ptr<i_audio_bitstream> const& aNote)
+	{
+		// called with iMutex held; iNotes keeps the note alive for the lifetime of the atlas
+		auto& result = *(iNotes[aKey] = aNote);
+		auto const key = packed_key(aKey);
+		if (key == std::nullopt)
+			return result;
+		auto slot = ready_note_hash(*key) % ReadyNoteCapacity;
+		for (std::size_t probe = 0u; probe < ReadyNoteCapacity; ++probe, slot = (slot + 1u) % ReadyNoteCapacity)
 		{
-			ma_decoder_read_pcm_frames(&decoder, &partSample[0], partSample.size(), &framesRead);
-			std::copy(partSample.begin(), std::next(partSample.begin(), framesRead), std::back_inserter(entireSample));
-			if (framesRead < partSample.size())
+			auto const slotKey = iReadyNotes[slot].key.load(std::memory_order_relaxed);
+			if (slotKey == *key)
+				break;
+			if (slotKey == 0u)
+			{
+				iReadyNotes[slot].note.store(&result, std::memory_order_relaxed);
+				iReadyNotes[slot].key.store(*key, std::memory_order_release);
 				break;
+			}
+		}
+		return result;
+	}
+
+	void audio_instrument_atlas::publish_prepared(note_key const& aKey)
+	{
+		// called with iMutex held once a worker has prepared a note so the audio callback can play it
+		if (iNotes.find(aKey) != iNotes.end())
+			return;
+		auto prepared = iPrepared.find(aKey);
+		if (prepared == iPrepared.end())
+			return;
+		try
+		{
+			publish(aKey, make_ref<sample>(std::get<1>(aKey), prepared->second.get()));
+		}
+		catch (...)
+		{
+			// a note that failed to prepare is reported by instrument() when it is asked for
+		}
+	}
+
+	std::shared_future<audio_instrument_atlas::pcm_ptr> audio_instrument_atlas::prepare(note_key const& aKey, sample_info const& aSampleInfo)
+	{
+		// called with iMutex held
+		auto existing = iPrepared.find(aKey);
+		if (existing != iPrepared.end())
+			return existing->second;
+		if (iWorkers.empty())
+		{
+			auto const threadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1u));
+			for (std::uint32_t t = 0; t < threadCount; ++t)
+				iWorkers.emplace_back([this]() { process(); });
 		}
+		auto job = std::make_shared<preparation>([this, aKey, sampleInfo = aSampleInfo]() { return prepare_note(aKey, sampleInfo); });
+		auto result = iPrepared.emplace(aKey, job->get_future().share()).first->second;
+		iQueue.emplace_back(aKey, job);
+		iWorkAvailable.notify_one();
+		return result;
+	}
+
+	audio_instrument_atlas::pcm_ptr audio_instrument_atlas::prepare_note(note_key const& aKey, sample_info const& aSampleInfo)
+	{
+		auto const& [instrument, sampleRate, note] = aKey;
+		auto source = decoded_sample(aSampleInfo.sampleFile, sampleRate);
+		if (note == aSampleInfo.midiKeyPitchCentre)
+			return source;
 
-		if (aNote != existingNote->second.midiKeyPitchCentre)
+		auto cached = read_cache(aKey);
+		if (cached)
+			return cached;
+
+		auto const frequencyShift = frequency(note) / frequency(aSampleInfo.midiKeyPitchCentre);
+		std::vector<float> shifted;
+		if (frequencyShift >= 0.89f && frequencyShift <= 1.13f)
+		{
+			// within two semitones plain resampling is indistinguishable and far cheaper than a phase vocoder
+			auto const frames = static_cast<std::size_t>(source->size() / frequencyShift);
+			shifted.resize(frames);
+			for (std::size_t i = 0; i < frames; ++i)
+			{
+				auto const position = i * frequencyShift;
+				auto const index = static_cast<std::size_t>(position);
+				auto const next = std::min(index + 1u, source->size() - 1u);
+				shifted[i] = mix((*source)[index], (*source)[next], position - index);
+			}
+		}
+		else
 		{
+			shifted = *source;
 			auto context = smbCreateContext(4096);
-			auto const frequencyShift = frequency(aNote) / frequency(existingNote->second.midiKeyPitchCentre);
-			smbPitchShift(context, frequencyShift, static_cast<long>(entireSample.size()), 4096, 32, static_cast<float>(aSampleRate), entireSample.data(), entireSample.data());
+			smbPitchShift(context, frequencyShift, static_cast<long>(shifted.size()), 4096, 32, static_cast<float>(sampleRate), shifted.data(), shifted.data());
 			smbDestroyContext(context);
 		}
+		write_cache(aKey, shifted);
+		return std::make_shared<std::vector<float> const>(std::move(shifted));
+	}
+
+	audio_instrument_atlas::pcm_ptr audio_instrument_atlas::decoded_sample(std::string const& aSampleFile, audio_sample_rate aSampleRate)
+	{
+		// source samples are decoded once and shared by all the notes pitched from them
+		std::promise<pcm_ptr> decoding;
+		{
+			std::unique_lock lock{ iMutex };
+			auto existing = iDecodedSamples.find(decoded_sample_key{ aSampleFile, aSampleRate });
+			if (existing != iDecodedSamples.end())
+			{
+				auto decoded = existing->second;
+				lock.unlock();
+				return decoded.get();
+			}
+			iDecodedSamples.emplace(decoded_sample_key{ aSampleFile, aSampleRate }, decoding.get_future().share());
+		}
+		try
+		{
+			auto atlasFile = neolib::program_directory() + "/music.zip";
+			if (!std::filesystem::exists(atlasFile))
+				throw audio_instrument_atlas_file_found();
+			thread_local neolib::zip zipFile(atlasFile);
+			thread_local std::vector<std::uint8_t> buffer;
+			buffer.clear();
+			zipFile.extract_to(zipFile.index_of(aSampleFile), buffer);
+
+			ma_decoder decoder;
+			ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, static_cast<ma_uint32>(aSampleRate));
+			ma_result result = ma_decoder_init_memory(buffer.data(), buffer.size(), &config, &decoder);
+			if (result != MA_SUCCESS)
+				throw audio_instrument_sample_decode_failure();
+
+			std::vector<float> entireSample;
+
+			thread_local std::array<float, 16384> partSample;
+			std::uint64_t framesRead;
+			for (;;)
+			{
+				ma_decoder_read_pcm_frames(&decoder, &partSample[0], partSample.size(), &framesRead);
+				std::copy(partSample.begin(), std::next(partSample.begin(), framesRead), std::back_inserter(entireSample));
+				if (framesRead < partSample.size())
+					break;
+			}
+			ma_decoder_uninit(&decoder);
+
+			auto decoded = std::make_shared<std::vector<float> const>(std::move(entireSample));
+			decoding.set_value(decoded);
+			return decoded;
+		}
+		catch (...)
+		{
+			decoding.set_exception(std::current_exception());
+			throw;
+		}
+	}
+
+	std::string audio_instrument_atlas::cache_path(note_key const& aKey) const
+	{
+		auto const& [instrument, sampleRate, note] = aKey;
+		std::ostringstream result;
+		result << (std::filesystem::temp_directory_path() / "neogfx" / "instrument_cache").string() << "/" <<
+			static_cast<std::uint32_t>(instrument) << "_" << static_cast<std::uint32_t>(note) << "_" << sampleRate << ".pcm";
+		return result.str();
+	}
+
+	namespace
+	{
+		struct pcm_cache_header
+		{
+			char magic[4];
+			std::uint64_t atlasFileSize;
+			std::int64_t atlasFileTime;
+			std::uint64_t frames;
+		};
+	}
+
+	audio_instrument_atlas::pcm_ptr audio_instrument_atlas::read_cache(note_key const& aKey) const
+	{
+		std::ifstream input{ cache_path(aKey), std::ios::binary | std::ios::in };
+		if (!input)
+			return {};
+		pcm_cache_header header;
+		if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			std::string_view{ header.magic, 4 } != "NPCM" || header.atlasFileSize != iAtlasFileSize || header.atlasFileTime != iAtlasFileTime)
+			return {};
+		std::vector<float> pcm(static_cast<std::size_t>(header.frames));
+		if (!input.read(reinterpret_cast<char*>(pcm.data()), pcm.size() * sizeof(float)))
+			return {};
+		return std::make_shared<std::vector<float> const>(std::move(pcm));
+	}
 
-		iNotes[key] = make_ref<sample>(aSampleRate, std::move(entireSample));
+	void audio_instrument_atlas::write_cache(note_key const& aKey, std::vector<float> const& aPcm) const
+	{
+		// the cache is an optimization; failing to write it is not an error
+		std::error_code ec;
+		auto const path = std::filesystem::path{ cache_path(aKey) };
+		std::filesystem::create_directories(path.parent_path(), ec);
+		auto const temporaryPath = path.string() + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+		{
+			std::ofstream output{ temporaryPath, std::ios::binary | std::ios::out | std::ios::trunc };
+			if (!output)
+				return;
+			pcm_cache_header const header{ { 'N', 'P', 'C', 'M' }, iAtlasFileSize, iAtlasFileTime, aPcm.size() };
+			output.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			output.write(reinterpret_cast<char const*>(aPcm.data()), aPcm.size() * sizeof(float));
+			if (!output)
+				return;
+		}
+		std::filesystem::rename(temporaryPath, path, ec);
+	}
 
-		return *iNotes[key];
+	void audio_instrument_atlas::process()
+	{
+		for (;;)
+		{
+			std::optional<note_key> key;
+			std::shared_ptr<preparation> job;
+			{
+				std::unique_lock lock{ iMutex };
+				iWorkAvailable.wait(lock, [&]() { return iStopping || !iQueue.empty(); });
+				if (iStopping)
+					return;
+				key = iQueue.front().first;
+				job = iQueue.front().second;
+				iQueue.pop_front();
+			}
+			(*job)();
+			std::unique_lock lock{ iMutex };
+			publish_prepared(*key);
+		}
 	}
 }
\ No newline at end of file
@@ -31,6 +31,7 @@ namespace neogfx
     audio_oscillator::audio_oscillator(audio_sample_rate aSampleRate, float aFrequency, float aAmplitude, std::function<float(float)> const& aFunction) :
         iSampleRate{ aSampleRate }, iFrequency{ aFrequency }, iAmplitude{ aAmplitude }, iFunction{ oscillator_function::Custom }, iCustomFunction{ aFunction }
     {
+        build_wavetable();
     }
 
     audio_sample_rate audio_oscillator::sample_rate() const
@@ -52,6 +53,7 @@ namespace neogfx
     {
         iFrequency = aFrequency;
         iCursor = 0ULL;
+        iPhase = 0.0;
     }
 
     float audio_oscillator::amplitude() const
@@ -73,15 +75,21 @@ namespace neogfx
     {
         iFunction = aFunction;
         if (iFunction != oscillator_function::Custom)
+        {
             iCustomFunction = nullptr;
+            iWavetable.clear();
+        }
         iCursor = 0ULL;
+        iPhase = 0.0;
     }
 
     void audio_oscillator::set_function(std::function<float(float)> const& aFunction)
     {
         iFunction = oscillator_function::Custom;
         iCustomFunction = aFunction;
+        build_wavetable();
         iCursor = 0ULL;
+        iPhase = 0.0;
     }
 
     void audio_oscillator::generate(audio_sample_count aSampleCount, float* aOutputSamples)
@@ -89,35 +97,135 @@ namespace neogfx
         generate_from(iCursor, aSampleCount, aOutputSamples);
     }
 
+    namespace
+    {
+        // polynomial band-limited step residual (for a step of height 2) at normalized phase t
+        inline float poly_blep(float t, float dt)
+        {
+            if (t < dt)
+            {
+                t /= dt;
+                return t + t - t * t - 1.0f;
+            }
+            else if (t > 1.0f - dt)
+            {
+                t = (t - 1.0f) / dt;
+                return t * t + t + t + 1.0f;
+            }
+            return 0.0f;
+        }
+
+        // integrated poly_blep: band-limited ramp residual for a change of slope
+        inline float poly_blamp(float t, float dt)
+        {
+            if (t < dt)
+            {
+                t = t / dt - 1.0f;
+                return -1.0f / 3.0f * t * t * t;
+            }
+            else if (t > 1.0f - dt)
+            {
+                t = (t - 1.0f) / dt + 1.0f;
+                return 1.0f / 3.0f * t * t * t;
+            }
+            return 0.0f;
+        }
+
+        inline float wrap_phase(float aPhase)
+        {
+            return aPhase >= 1.0f ? aPhase - 1.0f : aPhase;
+        }
+    }
+
     void audio_oscillator::generate_from(audio_sample_index aSampleFrom, audio_sample_count aSampleCount, float* aOutputSamples)
     {
+        // The phase is accumulated rather than derived from the sample cursor so precision does not degrade
+        // (and the pitch does not drift) however long the oscillator runs; it is only recomputed on a seek.
+        double const increment = static_cast<double>(frequency()) / sample_rate();
+        if (aSampleFrom != iCursor)
+        {
+            double integral;
+            iPhase = std::modf(static_cast<double>(aSampleFrom) * increment, &integral);
+        }
         iCursor = aSampleFrom;
 
-        switch (function())
+        float const dt = static_cast<float>(std::min(increment, 0.5));
+        float const gain = amplitude();
+
+        // generate in fixed size blocks: first the phases, then the waveform, so each loop is simple enough to vectorize
+        constexpr std::size_t BlockSize = 64;
+        float phases[BlockSize];
+        for (audio_sample_count offset = 0; offset < aSampleCount; offset += BlockSize)
         {
-        case oscillator_function::Custom:
-            // todo
-            break;
-        case oscillator_function::Sine:
-            for (auto cursor = iCursor; cursor < iCursor + aSampleCount; ++cursor)
+            auto const count = static_cast<std::size_t>(std::min<audio_sample_count>(BlockSize, aSampleCount - offset));
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                phases[i] = static_cast<float>(iPhase);
+                iPhase += increment;
+                if (iPhase >= 1.0)
+                    iPhase -= 1.0;
+            }
+            float* output = aOutputSamples + offset;
+            switch (function())
             {
-                auto x = static_cast<float>(cursor) / sample_rate() * math::two_pi<float>() * frequency();
-                *(aOutputSamples++) = std::sin(x) * amplitude();
+            case oscillator_function::Custom:
+                if (!iWavetable.empty())
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        auto const position = phases[i] * WavetableSize;
+                        auto const index = std::min(static_cast<std::size_t>(position), WavetableSize - 1u);
+                        auto const fraction = position - index;
+                        output[i] = mix(iWavetable[index], iWavetable[index + 1u], fraction) * gain;
+                    }
+                else
+                    std::fill(output, output + count, 0.0f);
+                break;
+            case oscillator_function::Sine:
+                for (std::size_t i = 0; i < count; ++i)
+                    output[i] = std::sin(phases[i] * math::two_pi<float>()) * gain;
+                break;
+            case oscillator_function::Square:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto const t = phases[i];
+                    auto value = t < 0.5f ? 1.0f : -1.0f;
+                    value += poly_blep(t, dt);
+                    value -= poly_blep(wrap_phase(t + 0.5f), dt);
+                    output[i] = value * gain;
+                }
+                break;
+            case oscillator_function::Triangle:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto const t = phases[i];
+                    auto value = 2.0f * std::abs(2.0f * t - 1.0f) - 1.0f;
+                    value -= 4.0f * dt * poly_blamp(t, dt);
+                    value += 4.0f * dt * poly_blamp(wrap_phase(t + 0.5f), dt);
+                    output[i] = value * gain;
+                }
+                break;
+            case oscillator_function::Sawtooth:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto const t = phases[i];
+                    output[i] = (2.0f * t - 1.0f - poly_blep(t, dt)) * gain;
+                }
+                break;
+            default:
+                std::fill(output, output + count, 0.0f);
+                break;
             }
-            break;
-        case oscillator_function::Square:
-            // todo
-            break;
-        case oscillator_function::Triangle:
-            // todo
-            break;
-        case oscillator_function::Sawtooth:
-            // todo
-            break;
-        default:
-            break;
         }
 
         iCursor += aSampleCount;
     }
+
+    void audio_oscillator::build_wavetable()
+    {
+        // custom functions take the phase in radians, [0, 2pi); the extra guard point simplifies interpolation
+        iWavetable.resize(WavetableSize + 1u);
+        for (std::size_t i = 0; i < WavetableSize; ++i)
+            iWavetable[i] = iCustomFunction ? iCustomFunction(static_cast<float>(i) / WavetableSize * math::two_pi<float>()) : 0.0f;
+        iWavetable[WavetableSize] = iWavetable[0];
+    }
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+// audio_renderer.cpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2021 Leigh Johnston.  All Rights Reserved.
+  
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <neogfx/neogfx.hpp>
+#include <fstream>
+#include <bit>
+#include <neogfx/audio/audio_renderer.hpp>
+
+namespace neogfx
+{
+    audio_renderer::audio_renderer(audio_sample_rate aSampleRate, std::uint32_t aChannels, std::uint32_t aThreadCount) :
+        iSampleRate{ aSampleRate }, iChannels{ aChannels }, iThreadCount{ std::max(1u, aThreadCount) }
+    {
+        if (iChannels != 1u && iChannels != 2u)
+            throw unsupported_channel_count();
+    }
+
+    audio_sample_rate audio_renderer::sample_rate() const
+    {
+        return iSampleRate;
+    }
+
+    std::uint32_t audio_renderer::channels() const
+    {
+        return iChannels;
+    }
+
+    void audio_renderer::add_source(i_audio_bitstream& aSource, audio_frame_index aStart, float aGain)
+    {
+        iSources.push_back(source{ &aSource, aStart, aGain });
+    }
+
+    void audio_renderer::clear()
+    {
+        iSources.clear();
+    }
+
+    audio_frame_count audio_renderer::length() const
+    {
+        audio_frame_count result = 0ULL;
+        for (auto const& s : iSources)
+            result = std::max(result, s.start + s.bitstream->length());
+        return result;
+    }
+
+    audio_renderer::buffer_type audio_renderer::render() const
+    {
+        return render(length());
+    }
+
+    audio_renderer::buffer_type audio_renderer::render(audio_frame_count aFrameCount) const
+    {
+        buffer_type result(static_cast<std::size_t>(aFrameCount * iChannels), 0.0f);
+        auto const workerCount = static_cast<std::size_t>(std::min<std::size_t>(iThreadCount, iSources.size()));
+        // every source has a block of its own so that they can be summed in source order whichever worker
+        // generated them; sources are assigned to workers round robin
+        std::vector<buffer_type> blocks(iSources.size(), buffer_type(static_cast<std::size_t>(BlockSize * iChannels)));
+        std::vector<char> active(iSources.size());
+        std::vector<std::exception_ptr> errors(workerCount);
+        auto generate = [&](std::size_t aWorker, audio_frame_index aFrame, audio_frame_count aCount)
+        {
+            try
+            {
+                for (std::size_t s = aWorker; s < iSources.size(); s += workerCount)
+                    active[s] = render_source(iSources[s], aFrameCount, aFrame, aCount, blocks[s].data());
+            }
+            catch (...)
+            {
+                errors[aWorker] = std::current_exception();
+            }
+        };
+        for (audio_frame_index frame = 0ULL; frame < aFrameCount; frame += BlockSize)
+        {
+            auto const count = std::min(BlockSize, aFrameCount - frame);
+            if (workerCount <= 1u)
+                generate(0u, frame, count);
+            else
+            {
+                std::vector<std::thread> workers;
+                for (std::size_t w = 0u; w < workerCount; ++w)
+                    workers.emplace_back(generate, w, frame, count);
+                for (auto& worker : workers)
+                    worker.join();
+            }
+            for (auto const& error : errors)
+                if (error)
+                    std::rethrow_exception(error);
+            auto const output = result.data() + frame * iChannels;
+            for (std::size_t s = 0u; s < iSources.size(); ++s)
+                if (active[s])
+                    for (std::size_t i = 0u; i < count * iChannels; ++i)
+                        output[i] += blocks[s][i];
+        }
+        return result;
+    }
+
+    void audio_renderer::render_to_wav(std::string const& aPath, audio_sample_format aSampleFormat) const
+    {
+        render_to_wav(aPath, length(), aSampleFormat);
+    }
+
+    void audio_renderer::render_to_wav(std::string const& aPath, audio_frame_count aFrameCount, audio_sample_format aSampleFormat) const
+    {
+        write_wav(aPath, render(aFrameCount), iSampleRate, iChannels, aSampleFormat);
+    }
+
+    void audio_renderer::write_wav(std::string const& aPath, buffer_type const& aFrames, audio_sample_rate aSampleRate, std::uint32_t aChannels, audio_sample_format aSampleFormat)
+    {
+        std::uint16_t formatTag;
+        std::uint16_t bitsPerSample;
+        switch (aSampleFormat)
+        {
+        case audio_sample_format::S16:
+            formatTag = 1u; // WAVE_FORMAT_PCM
+            bitsPerSample = 16u;
+            break;
+        case audio_sample_format::F32:
+            formatTag = 3u; // WAVE_FORMAT_IEEE_FLOAT
+            bitsPerSample = 32u;
+            break;
+        default:
+            throw unsupported_sample_format();
+        }
+        std::ofstream output{ aPath, std::ios::binary | std::ios::out };
+        if (!output)
+            throw error_writing_file();
+        // RIFF is little endian
+        auto write = [&](auto aValue, std::size_t aBytes)
+        {
+            for (std::size_t b = 0u; b < aBytes; ++b)
+                output.put(static_cast<char>((static_cast<std::uint64_t>(aValue) >> (b * 8u)) & 0xFFu));
+        };
+        auto const blockAlign = static_cast<std::uint16_t>(aChannels * bitsPerSample / 8u);
+        auto const dataSize = static_cast<std::uint32_t>(aFrames.size() * bitsPerSample / 8u);
+        output.write("RIFF", 4);
+        write(36u + dataSize, 4u);
+        output.write("WAVE", 4);
+        output.write("fmt ", 4);
+        write(16u, 4u);
+        write(formatTag, 2u);
+        write(aChannels, 2u);
+        write(aSampleRate, 4u);
+        write(aSampleRate * blockAlign, 4u);
+        write(blockAlign, 2u);
+        write(bitsPerSample, 2u);
+        output.write("data", 4);
+        write(dataSize, 4u);
+        for (auto sample : aFrames)
+        {
+            if (aSampleFormat == audio_sample_format::S16)
+                write(static_cast<std::uint16_t>(static_cast<std::int16_t>(std::lround(std::clamp(sample, -1.0f, 1.0f) * 32767.0f))), 2u);
+            else
+                write(std::bit_cast<std::uint32_t>(sample), 4u);
+        }
+        if (!output)
+            throw error_writing_file();
+    }
+
+    audio_channel audio_renderer::channel_mask() const
+    {
+        return iChannels == 1u ? audio_channel::Mono : audio_channel::Left | audio_channel::Right;
+    }
+
+    bool audio_renderer::render_source(source const& aSource, audio_frame_count aFrameCount, audio_frame_index aBlockStart, audio_frame_count aBlockFrames, float* aBlock) const
+    {
+        // a source with no intrinsic length plays until the end of the render
+        auto const sourceLength = aSource.bitstream->length();
+        auto const end = sourceLength != 0ULL ? std::min(aFrameCount, aSource.start + sourceLength) : aFrameCount;
+        auto const first = std::max(aBlockStart, aSource.start);
+        auto const last = std::min(aBlockStart + aBlockFrames, end);
+        if (first >= last)
+            return false;
+        std::fill(aBlock, aBlock + aBlockFrames * iChannels, 0.0f);
+        auto const output = aBlock + (first - aBlockStart) * iChannels;
+        aSource.bitstream->generate_from(channel_mask(), first - aSource.start, last - first, output);
+        for (std::size_t i = 0u; i < (last - first) * iChannels; ++i)
+            output[i] *= aSource.gain;
+        return true;
+    }
+}
\ No newline at end of file
@@ -551,6 +551,11 @@ namespace neogfx
                 "        else\n"
                 "        {\n"
                 "            a = texture(tex, TexCoord).r;\n"
+                "            if (uGlyphSdf)\n"
+                "            {\n"
+                "                float w = fwidth(a);\n"
+                "                a = smoothstep(0.5 - w, 0.5 + w, a);\n"
+                "            }\n"
                 "            if (a == 0)\n"
                 "                discard;\n"
                 "            color = vec4(color.xyz, color.a * a);\n"
@@ -580,6 +585,7 @@ namespace neogfx
         uGlyphRenderOutput = sampler2DMS{ 7 };
         uGlyphSubpixel = aText.glyph_texture(aGlyph).subpixel();
         uGlyphSubpixelFormat = subpixelRender ? aContext.subpixel_format() : subpixel_format::None;
+        uGlyphSdf = aText.glyph_texture(aGlyph).pixel_mode() == glyph_pixel_mode::SDF;
         uGlyphEnabled = true;
     }
 
@@ -18,6 +18,7 @@
 */
 
 #include <neogfx/neogfx.hpp>
+#include <boost/functional/hash.hpp>
 #include <neogfx/gfx/i_graphics_context.hpp>
 #include <neogfx/gfx/gradient_manager.hpp>
 
@@ -37,6 +38,49 @@ template<> void services::teardown_service<neogfx::i_gradient_manager>()
 
 namespace neogfx
 {
+    namespace
+    {
+        template <typename ColorStops, typename AlphaStops>
+        std::size_t hash_stops(ColorStops const& aColorStops, AlphaStops const& aAlphaStops)
+        {
+            std::size_t seed = 0;
+            for (auto const& stop : aColorStops)
+            {
+                boost::hash_combine(seed, stop.first());
+                for (std::size_t component = 0; component < sRGB_color::component_count; ++component)
+                    boost::hash_combine(seed, stop.second()[component]);
+            }
+            boost::hash_combine(seed, aColorStops.size());
+            for (auto const& stop : aAlphaStops)
+            {
+                boost::hash_combine(seed, stop.first());
+                boost::hash_combine(seed, stop.second());
+            }
+            boost::hash_combine(seed, aAlphaStops.size());
+            return seed;
+        }
+
+        template <typename ColorStops1, typename AlphaStops1, typename ColorStops2, typename AlphaStops2>
+        bool same_stops(ColorStops1 const& aColorStops1, AlphaStops1 const& aAlphaStops1, ColorStops2 const& aColorStops2, AlphaStops2 const& aAlphaStops2)
+        {
+            return std::equal(aColorStops1.begin(), aColorStops1.end(), aColorStops2.begin(), aColorStops2.end(),
+                    [](auto const& aLeft, auto const& aRight)
+                    {
+                        if (aLeft.first() != aRight.first())
+                            return false;
+                        for (std::size_t component = 0; component < sRGB_color::component_count; ++component)
+                            if (aLeft.second()[component] != aRight.second()[component])
+                                return false;
+                        return true;
+                    }) &&
+                std::equal(aAlphaStops1.begin(), aAlphaStops1.end(), aAlphaStops2.begin(), aAlphaStops2.end(),
+                    [](auto const& aLeft, auto const& aRight)
+                    {
+                        return aLeft.first() == aRight.first() && aLeft.second() == aRight.second();
+                    });
+        }
+    }
+
     class gradient_object : public reference_counted<i_gradient>
     {
         // types
@@ -191,6 +235,7 @@ namespace neogfx
         }
         color_stop_list& color_stops() override
         {
+            iStopsHash = std::nullopt;
             if (iSampler)
             {
                 iSampler->release(id());
@@ -210,6 +255,7 @@ namespace neogfx
         }
         alpha_stop_list& alpha_stops() override
         {
+            iStopsHash = std::nullopt;
             if (iSampler)
             {
                 iSampler->release(id());
@@ -222,6 +268,13 @@ namespace neogfx
             }
             return iAlphaStops;
         }
+        std::size_t stops_hash() const override
+        {
+            iFixer();
+            if (iStopsHash == std::nullopt)
+                iStopsHash = hash_stops(iColorStops, iAlphaStops);
+            return *iStopsHash;
+        }
         color_stop_list::const_iterator find_color_stop(scalar aPos, bool aToInsert = false) const override
         {
             auto colorStop = std::lower_bound(color_stops().begin(), color_stops().end(), color_stop{ aPos, sRGB_color{} },
@@ -556,6 +609,7 @@ namespace neogfx
         scalar iSmoothness = 0.0;
         optional_rect iBoundingBox;
         mutable const i_gradient_sampler* iSampler = nullptr;
+        mutable std::optional<std::size_t> iStopsHash;
         mutable bool iColorStopsNeedFixing = true;
         mutable bool iAlphaStopsNeedFixing = true;
         bool iInFixer = false;
@@ -578,66 +632,85 @@ namespace neogfx
 
     i_gradient_sampler const& gradient_manager::sampler(i_gradient const& aGradient)
     {
-        thread_local std::pair<gradient::color_stop_list, gradient::alpha_stop_list> key;
-        key.first = aGradient.color_stops();
-        key.second = aGradient.alpha_stops();
-        auto allocated = iAllocatedSamplers.find(key);
-        if (allocated == iAllocatedSamplers.end())
+        auto const hash = aGradient.stops_hash();
+        auto const& colorStops = aGradient.color_stops();
+        auto const& alphaStops = aGradient.alpha_stops();
+        std::optional<sampler_list_t::iterator> allocated;
+        for (auto candidates = iSamplerIndex.equal_range(hash); candidates.first != candidates.second; ++candidates.first)
+        {
+            auto const& entry = *candidates.first->second;
+            if (same_stops(entry.colorStops, entry.alphaStops, colorStops, alphaStops))
+            {
+                allocated = candidates.first->second;
+                break;
+            }
+        }
+        if (allocated == std::nullopt)
         {
             if (!free_samplers().empty())
             {
-                allocated = iAllocatedSamplers.insert(std::make_pair(key, free_samplers().back())).first;
+                allocated = iSamplers.insert(iSamplers.end(), sampler_entry{ hash, {}, {}, free_samplers().back() });
                 free_samplers().pop_back();
             }
             else
             {
-                allocated = iAllocatedSamplers.insert(std::make_pair(key, iSamplerQueue.front()->second)).first;
-                iAllocatedSamplers.erase(iSamplerQueue.front());
-                iSamplerQueue.pop_front();
+                // evict the least recently used sampler, reusing its list node so that gradients still
+                // pointing at it just see it is no longer used by them
+                allocated = iSamplers.begin();
+                for (auto candidates = iSamplerIndex.equal_range((*allocated)->hash); candidates.first != candidates.second; ++candidates.first)
+                    if (candidates.first->second == *allocated)
+                    {
+                        iSamplerIndex.erase(candidates.first);
+                        break;
+                    }
+                (*allocated)->hash = hash;
             }
-            allocated->second.release_all();
+            auto& entry = **allocated;
+            entry.colorStops = colorStops;
+            entry.alphaStops = alphaStops;
+            iSamplerIndex.emplace(hash, *allocated);
+            entry.sampler.release_all();
             avec4u8 colorValues[i_gradient::MaxStops];
-            auto const cx = static_cast<uint32_t>(samplers().data().extents().cx);
+            auto const cx = static_cast<uint32_t>(sampler_data().data().extents().cx);
             for (uint32_t x = 0u; x < cx; ++x)
             {
                 auto const color = aGradient.at(x, 0u, cx - 1u);
                 colorValues[x] = avec4u8{ color.red(), color.green(), color.blue(), color.alpha() };
             }
-            samplers().data().set_pixels(rect{ basic_point<uint32_t>{ 0u, allocated->second.sampler_row() }, size_u32{ i_gradient::MaxStops, 1u } }, &colorValues[0]);
-        }
-        auto existingQueueEntry = std::find(iSamplerQueue.begin(), iSamplerQueue.end(), allocated);
-        if (existingQueueEntry != iSamplerQueue.end())
-            iSamplerQueue.erase(existingQueueEntry);
-        iSamplerQueue.push_back(allocated);
-        allocated->second.add_ref(aGradient.id());
-        return allocated->second;
+            sampler_data().data().set_pixels(rect{ basic_point<uint32_t>{ 0u, entry.sampler.sampler_row() }, size_u32{ i_gradient::MaxStops, 1u } }, &colorValues[0]);
+        }
+        iSamplers.splice(iSamplers.end(), iSamplers, *allocated);
+        auto& result = (*allocated)->sampler;
+        result.add_ref(aGradient.id());
+        return result;
     }
 
     i_gradient_filter const& gradient_manager::filter(i_gradient const& aGradient)
     {
         scalar const key{ aGradient.smoothness()};
-        auto allocated = iAllocatedFilters.find(key);
-        if (allocated == iAllocatedFilters.end())
+        auto existing = iFilterIndex.find(key);
+        filter_list_t::iterator allocated;
+        if (existing != iFilterIndex.end())
+            allocated = existing->second;
+        else
         {
             if (!free_filters().empty())
             {
-                allocated = iAllocatedFilters.insert(std::make_pair(key, free_filters().back())).first;
+                allocated = iFilters.insert(iFilters.end(), filter_entry{ key, free_filters().back() });
                 free_filters().pop_back();
             }
             else
             {
-                allocated = iAllocatedFilters.insert(std::make_pair(key, iFilterQueue.front()->second)).first;
-                iAllocatedFilters.erase(iFilterQueue.front());
-                iFilterQueue.pop_front();
+                allocated = iFilters.begin();
+                iFilterIndex.erase(allocated->smoothness);
+                allocated->smoothness = key;
             }
+            iFilterIndex.emplace(key, allocated);
             auto const filterValues = static_gaussian_filter<float, GRADIENT_FILTER_SIZE>(static_cast<float>(aGradient.smoothness() * 10.0));
-            allocated->second.sampler().data().set_pixels(rect{ point{}, size_u32{ GRADIENT_FILTER_SIZE, GRADIENT_FILTER_SIZE } }, &filterValues[0][0]);
+            allocated->filter.sampler().data().set_pixels(rect{ point{}, size_u32{ GRADIENT_FILTER_SIZE, GRADIENT_FILTER_SIZE } }, &filterValues[0][0]);
         }
-        auto existingQueueEntry = std::find(iFilterQueue.begin(), iFilterQueue.end(), allocated);
-        if (existingQueueEntry != iFilterQueue.end())
-            iFilterQueue.erase(existingQueueEntry);
-        iFilterQueue.push_back(allocated);
-        return allocated->second;
+        iFilters.splice(iFilters.end(), iFilters, allocated);
+        return allocated->filter;
     }
 
     void gradient_manager::add_ref(gradient_id aId)
@@ -743,11 +816,11 @@ namespace neogfx
         aResult = add_gradient(make_ref<gradient_object>(allocate_gradient_id(), aColors, aDirection));
     }
 
-    shader_array<avec4u8>& gradient_manager::samplers()
+    shader_array<avec4u8>& gradient_manager::sampler_data()
     {
-        if (iSamplers == std::nullopt)
-            iSamplers.emplace(size_u32{ gradient::MaxStops, MaxSamplers });
-        return *iSamplers;
+        if (iSamplerData == std::nullopt)
+            iSamplerData.emplace(size_u32{ gradient::MaxStops, MaxSamplers });
+        return *iSamplerData;
     }
 
     std::vector<gradient_sampler>& gradient_manager::free_samplers()
@@ -756,7 +829,7 @@ namespace neogfx
         {
             iFreeSamplers.emplace();
             for (uint32_t row = 0; row < MaxSamplers; ++row)
-                free_samplers().emplace_back(samplers(), row);
+                free_samplers().emplace_back(sampler_data(), row);
         }
         return *iFreeSamplers;
     }
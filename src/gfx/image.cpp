@@ -18,6 +18,16 @@
 */
 
 #include <neogfx/neogfx.hpp>
+#include <deque>
+#include <map>
+#include <vector>
+#include <memory>
+#include <future>
+#include <tuple>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <libpng/png.h>
 #include <openssl/sha.h>
 #include <neolib/core/vecarray.hpp>
@@ -27,6 +37,160 @@
 
 namespace neogfx
 {
+    namespace
+    {
+        // Decodes images on a bounded pool of worker threads so that large assets do not stall the event loop.
+        // Resources are loaded and reference counted on the requesting thread only; workers see just the
+        // encoded bytes. Decoded images are cached by resource URI and decoding parameters and every request
+        // is given its own copy of the cached image; textures are created from it by the requester once the
+        // future is ready. Failed decodes and resources that aren't available yet are not cached.
+        class image_decoder
+        {
+        private:
+            typedef std::tuple<std::string, dimension, texture_sampling, color_space> cache_key;
+            typedef std::shared_ptr<std::promise<ref_ptr<i_image>>> request;
+            struct cache_entry
+            {
+                ref_ptr<i_resource> resource;
+                std::shared_ptr<image const> decoded;
+                bool failed = false;
+                std::vector<request> waiting;
+            };
+        public:
+            static image_decoder& instance()
+            {
+                static image_decoder sInstance;
+                return sInstance;
+            }
+        public:
+            image_decoder(uint32_t aThreadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1u)))
+            {
+                // make sure the resource manager outlives the resources we cache
+                service<i_resource_manager>();
+                for (uint32_t t = 0; t < aThreadCount; ++t)
+                    iWorkers.emplace_back([this]() { process(); });
+            }
+            ~image_decoder()
+            {
+                {
+                    std::unique_lock<std::mutex> lock{ iMutex };
+                    iStopping = true;
+                }
+                iWorkAvailable.notify_all();
+                for (auto& w : iWorkers)
+                    w.join();
+            }
+        public:
+            image::future_image decode(std::string const& aUri, dimension aDpiScaleFactor, texture_sampling aSampling, color_space aColorSpace)
+            {
+                auto promise = std::make_shared<std::promise<ref_ptr<i_image>>>();
+                image::future_image result = promise->get_future().share();
+                std::unique_lock<std::mutex> cacheLock{ iCacheMutex };
+                cache_key const key{ aUri, aDpiScaleFactor, aSampling, aColorSpace };
+                auto existing = iCache.find(key);
+                if (existing != iCache.end() && existing->second.failed)
+                    iCache.erase(existing); // try again
+                else if (existing != iCache.end())
+                {
+                    if (existing->second.decoded)
+                        promise->set_value(make_ref<image>(*existing->second.decoded));
+                    else
+                        existing->second.waiting.push_back(promise);
+                    return result;
+                }
+                auto resource = service<i_resource_manager>().load_resource(aUri);
+                if (!resource->available())
+                {
+                    // still downloading (or failed to); the next request for it will try again
+                    promise->set_exception(std::make_exception_ptr(i_resource::not_available()));
+                    return result;
+                }
+                auto& entry = iCache[key];
+                entry.resource = resource;
+                entry.waiting.push_back(promise);
+                auto const encodedData = resource->cdata();
+                auto const encodedSize = resource->size();
+                {
+                    std::unique_lock<std::mutex> lock{ iMutex };
+                    iQueue.push_back([=]()
+                    {
+                        std::shared_ptr<image const> decoded;
+                        std::exception_ptr failure;
+                        try
+                        {
+                            decoded = std::make_shared<image const>(aUri, encodedData, encodedSize, aDpiScaleFactor, aSampling, aColorSpace);
+                        }
+                        catch (...)
+                        {
+                            failure = std::current_exception();
+                        }
+                        decoded_image(key, decoded, failure);
+                    });
+                }
+                iWorkAvailable.notify_one();
+                return result;
+            }
+            void clear()
+            {
+                std::unique_lock<std::mutex> cacheLock{ iCacheMutex };
+                // entries still being decoded keep their resource alive
+                for (auto i = iCache.begin(); i != iCache.end();)
+                {
+                    if (i->second.decoded || i->second.failed)
+                        i = iCache.erase(i);
+                    else
+                        ++i;
+                }
+            }
+        private:
+            void decoded_image(cache_key const& aKey, std::shared_ptr<image const> const& aDecoded, std::exception_ptr aFailure)
+            {
+                // a failed entry is only marked here and erased by the next request so that its resource is still
+                // released on a requesting thread
+                std::vector<request> waiting;
+                {
+                    std::unique_lock<std::mutex> cacheLock{ iCacheMutex };
+                    auto& entry = iCache.at(aKey);
+                    std::swap(waiting, entry.waiting);
+                    if (aDecoded)
+                        entry.decoded = aDecoded;
+                    else
+                        entry.failed = true;
+                }
+                for (auto& request : waiting)
+                    if (aDecoded)
+                        request->set_value(make_ref<image>(*aDecoded));
+                    else
+                        request->set_exception(aFailure);
+            }
+        private:
+            void process()
+            {
+                for (;;)
+                {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lock{ iMutex };
+                        iWorkAvailable.wait(lock, [&]() { return iStopping || !iQueue.empty(); });
+                        if (iStopping)
+                            return;
+                        job = std::move(iQueue.front());
+                        iQueue.pop_front();
+                    }
+                    job();
+                }
+            }
+        private:
+            std::mutex iCacheMutex;
+            std::map<cache_key, cache_entry> iCache;
+            std::mutex iMutex;
+            std::condition_variable iWorkAvailable;
+            std::deque<std::function<void()>> iQueue;
+            std::vector<std::thread> iWorkers;
+            bool iStopping = false;
+        };
+    }
+
     image::image(dimension aDpiScaleFactor, texture_sampling aSampling, neogfx::color_space aColorSpace) :
         iDpiScaleFactor{ aDpiScaleFactor }, 
         iColorSpace{ aColorSpace },
@@ -116,6 +280,16 @@ namespace neogfx
         }
     }
 
+    image::image(std::string const& aUri, const void* aEncodedData, std::size_t aEncodedSize, dimension aDpiScaleFactor, texture_sampling aSampling, neogfx::color_space aColorSpace) :
+        iUri{ aUri },
+        iDpiScaleFactor{ aDpiScaleFactor },
+        iColorSpace{ aColorSpace },
+        iColorFormat{ neogfx::color_format::RGBA8 },
+        iSampling{ aSampling }
+    {
+        load(aEncodedData, aEncodedSize);
+    }
+
     image::image(image const& aOther) :
         iResource{ aOther.iResource },
         iUri{ aOther.iUri },
@@ -322,6 +496,16 @@ namespace neogfx
         }
     }
 
+    image::future_image image::load_async(std::string const& aUri, dimension aDpiScaleFactor, texture_sampling aSampling, neogfx::color_space aColorSpace)
+    {
+        return image_decoder::instance().decode(aUri, aDpiScaleFactor, aSampling, aColorSpace);
+    }
+
+    void image::clear_decoded_images()
+    {
+        image_decoder::instance().clear();
+    }
+
     bool image::has_resource() const
     {
         return iResource != nullptr;
@@ -334,19 +518,13 @@ namespace neogfx
         return *iResource;
     }
 
-    image::image_type_e image::recognize() const
+    image::image_type_e image::recognize(const void* aEncodedData, std::size_t aEncodedSize)
     {
-        if (has_resource())
+        if (aEncodedSize >= 4)
         {
-            if (resource().size() > 0)
-            {
-                if (resource().size() >= 4)
-                {
-                    const uint8_t* magic = static_cast<const uint8_t*>(resource().data());
-                    if (magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G')
-                        return PngImage;
-                }
-            }
+            const uint8_t* magic = static_cast<const uint8_t*>(aEncodedData);
+            if (magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G')
+                return PngImage;
         }
         return UnknownImage;
     }
@@ -355,21 +533,26 @@ namespace neogfx
     {
         if (!available())
             throw not_available();
-        switch (recognize())
+        return load(resource().cdata(), resource().size());
+    }
+
+    bool image::load(const void* aEncodedData, std::size_t aEncodedSize)
+    {
+        switch (recognize(aEncodedData, aEncodedSize))
         {
         case PngImage:
-            return load_png();
+            return load_png(aEncodedData, aEncodedSize);
         default:
             throw unknown_image_format();
         }
     }
 
-    bool image::load_png()
+    bool image::load_png(const void* aEncodedData, std::size_t aEncodedSize)
     {
         png_image image;
         std::memset(&image, 0, (sizeof image));
         image.version = PNG_IMAGE_VERSION;
-        if (png_image_begin_read_from_memory(&image, resource().data(), resource().size()) != 0)
+        if (png_image_begin_read_from_memory(&image, aEncodedData, aEncodedSize) != 0)
         {
             image.format = PNG_FORMAT_RGBA;
             iData.resize(PNG_IMAGE_SIZE(image));
@@ -1665,6 +1665,16 @@ namespace neogfx
         thread_local std::vector<game::mesh_renderer> meshRenderers;
         thread_local std::vector<mesh_drawable> drawables;
 
+        // Queue all glyphs first so that any not yet in the atlas are rasterized in parallel, then
+        // resolve them and upload the new ones as a single batch before drawing.
+        for (auto op = aBegin; op != aEnd; ++op)
+            if (!is_whitespace(*op->glyph) && !is_emoji(*op->glyph))
+                op->glyphText->glyph_font(*op->glyph).prepare_glyph_texture(*op->glyph);
+        for (auto op = aBegin; op != aEnd; ++op)
+            if (!is_whitespace(*op->glyph) && !is_emoji(*op->glyph))
+                op->glyphText->glyph_texture(*op->glyph);
+        service<i_font_manager>().flush_glyphs();
+
         auto draw = [&]()
         {
             for (std::size_t i = 0; i < meshFilters.size(); ++i)
@@ -1697,10 +1707,10 @@ namespace neogfx
                         drawOp.point.x + glyphTexture.placement().x,
                         logical_coordinate_system() == neogfx::logical_coordinate_system::AutomaticGame ?
                             drawOp.point.y + (glyphTexture.placement().y + -glyphFont.descender()) :
-                            drawOp.point.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.texture().extents().cy
+                            drawOp.point.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.extents().cy
                     } + glyph.offset.as<scalar>();
                     vec3 const glyphOrigin{ glyphOrigin2D.x, glyphOrigin2D.y, drawOp.point.z };
-                    glyphRect = rect{ point{ glyphOrigin }, glyphTexture.texture().extents() };
+                    glyphRect = rect{ point{ glyphOrigin }, glyphTexture.extents() };
                 }
 
                 if (result == std::nullopt)
@@ -1860,7 +1870,7 @@ namespace neogfx
                             drawOp.point.x + glyphTexture.placement().x,
                             logical_coordinate_system() == neogfx::logical_coordinate_system::AutomaticGame ?
                                 drawOp.point.y + (glyphTexture.placement().y + -glyphFont.descender()) :
-                                drawOp.point.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.texture().extents().cy
+                                drawOp.point.y + glyphFont.height() - (glyphTexture.placement().y + -glyphFont.descender()) - glyphTexture.extents().cy
                         } + glyph.offset.as<scalar>();
 
                         vec3 const glyphOrigin{ glyphOrigin2D.x, glyphOrigin2D.y, drawOp.point.z };
@@ -1893,7 +1903,7 @@ namespace neogfx
                                 {
                                     rect const outputRect = {
                                             point{ glyphOrigin } + offsetOrigin + point{ static_cast<coordinate>(offset % scanlineOffsets), static_cast<coordinate>(offset / scanlineOffsets) },
-                                            glyphTexture.texture().extents() };
+                                            glyphTexture.extents() };
                                     auto mesh = logical_coordinate_system() == neogfx::logical_coordinate_system::AutomaticGui ?
                                         to_ecs_component(
                                             outputRect,
@@ -1924,7 +1934,7 @@ namespace neogfx
                             continue;
                         }
 
-                        rect const outputRect = { point{ glyphOrigin }, glyphTexture.texture().extents() };
+                        rect const outputRect = { point{ glyphOrigin }, glyphTexture.extents() };
                         auto mesh = logical_coordinate_system() == neogfx::logical_coordinate_system::AutomaticGui ?
                             to_ecs_component(
                                 outputRect,
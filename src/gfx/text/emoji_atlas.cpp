@@ -19,6 +19,8 @@
 
 #include <neogfx/neogfx.hpp>
 #include <sstream>
+#include <charconv>
+#include <string_view>
 #include <filesystem>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -48,32 +50,44 @@ namespace neogfx
                     std::string location = set.second.get<std::string>("location");
                     std::string prefix = set.second.get<std::string>("prefix", "");
                     std::string separator = set.second.get<std::string>("separator", "-");
+                    if (separator.empty())
+                        continue;
+                    std::u32string codePoints;
                     for (std::size_t i = 0; i < zipFile.file_count(); ++i)
                     {
                         auto const& filePath = zipFile.file_path(i);
-                        if (filePath.find(location) == 0)
+                        if (filePath.compare(0, location.size(), location) != 0)
+                            continue;
+                        // stem of the file name, parsed in place
+                        std::string_view filename{ filePath };
+                        auto const lastSlash = filename.find_last_of("/\\");
+                        if (lastSlash != std::string_view::npos)
+                            filename.remove_prefix(lastSlash + 1);
+                        auto const lastDot = filename.rfind('.');
+                        if (lastDot != std::string_view::npos && lastDot != 0)
+                            filename = filename.substr(0, lastDot);
+                        if (filename.size() <= prefix.size() || filename.compare(0, prefix.size(), prefix) != 0)
+                            continue;
+                        filename.remove_prefix(prefix.size());
+                        codePoints.clear();
+                        while (!filename.empty())
                         {
-                            std::u32string codePoints;
-                            std::vector<std::string> hexCodePoints;
-                            auto filename = boost::filesystem::path(filePath).stem().string();
-                            if (filename.size() <= prefix.size() || (!prefix.empty() && filename.find(prefix) != 0))
-                                continue;
-                            neolib::tokens(filename.substr(prefix.size()), separator, hexCodePoints);
-                            for (auto const& hexCodePoint : hexCodePoints)
-                            {
-                                std::stringstream ss;
-                                ss << std::hex << hexCodePoint;
-                                uint32_t x;
-                                ss >> x;
-                                if (x < 256)
-                                    break;
-                                codePoints.push_back(x);
-                            }
-                            if (!codePoints.empty())
-                            {
-                                iEmojis[codePoints][size] = filePath;
-                                iEmojiMap[codePoints] = std::optional<emoji_id>{};
-                            }
+                            auto const next = filename.find(separator);
+                            auto const hexCodePoint = filename.substr(0, next);
+                            uint32_t x = 0;
+                            std::from_chars(hexCodePoint.data(), hexCodePoint.data() + hexCodePoint.size(), x, 16);
+                            if (x < 256)
+                                break;
+                            codePoints.push_back(static_cast<char32_t>(x));
+                            if (next == std::string_view::npos)
+                                break;
+                            filename.remove_prefix(next + separator.size());
+                        }
+                        if (!codePoints.empty())
+                        {
+                            iCatalog[codePoints].files[size] = filePath;
+                            if (codePoints.size() == 1 && codePoints[0] < kSingleCodePointLimit)
+                                iSingleCodePoints.set(codePoints[0]);
                         }
                     }
                 }
@@ -86,37 +100,44 @@ namespace neogfx
 
     bool emoji_atlas::is_emoji(char32_t aCodePoint) const
     {
-        std::u32string str;
-        str += aCodePoint;
-        return is_emoji(str);
+        if (aCodePoint < kSingleCodePointLimit)
+            return iSingleCodePoints.test(aCodePoint);
+        return iCatalog.find(std::u32string(1, aCodePoint)) != iCatalog.end();
     }
 
     bool emoji_atlas::is_emoji(const std::u32string& aCodePoints) const
     {
-        return iEmojiMap.find(aCodePoints) != iEmojiMap.end();
+        if (aCodePoints.size() == 1 && aCodePoints[0] < kSingleCodePointLimit)
+            return iSingleCodePoints.test(aCodePoints[0]);
+        return iCatalog.find(aCodePoints) != iCatalog.end();
     }
 
     emoji_atlas::emoji_id emoji_atlas::emoji(char32_t aCodePoint, dimension aDesiredSize) const
     {
-        std::u32string str;
-        str += aCodePoint;
-        return emoji(str, aDesiredSize);
+        if (!is_emoji(aCodePoint))
+            throw emoji_not_found();
+        return emoji(iCatalog.find(std::u32string(1, aCodePoint))->second, aDesiredSize);
     }
 
     emoji_atlas::emoji_id emoji_atlas::emoji(const std::u32string& aCodePoints, dimension aDesiredSize) const
     {
-        auto iterEmoji = iEmojiMap.find(aCodePoints);
-        if (iterEmoji == iEmojiMap.end())
+        auto existing = iCatalog.find(aCodePoints);
+        if (existing == iCatalog.end())
             throw emoji_not_found();
-        if (iterEmoji->second == std::nullopt)
+        return emoji(existing->second, aDesiredSize);
+    }
+
+    emoji_atlas::emoji_id emoji_atlas::emoji(emoji_entry& aEntry, dimension aDesiredSize) const
+    {
+        // the emoji image is only extracted from the archive the first time it is drawn
+        if (aEntry.id == std::nullopt)
         {
-            auto emojiFiles = iEmojis.find(aCodePoints);
-            auto emojiFile = emojiFiles->second.lower_bound(aDesiredSize);
-            if (emojiFile == emojiFiles->second.end())
+            auto emojiFile = aEntry.files.lower_bound(aDesiredSize);
+            if (emojiFile == aEntry.files.end())
                 --emojiFile;
-            iterEmoji->second = iTextureAtlas->create_sub_texture(neogfx::image{ "file:///" + kFilePath + "#" + emojiFile->second }).atlas_id();
+            aEntry.id = iTextureAtlas->create_sub_texture(neogfx::image{ "file:///" + kFilePath + "#" + emojiFile->second }).atlas_id();
         }
-        return *iterEmoji->second;
+        return *aEntry.id;
     }
 
     const i_texture& emoji_atlas::emoji_texture(emoji_id aId) const
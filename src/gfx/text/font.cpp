@@ -608,6 +608,11 @@ namespace neogfx
         return native_font_face().fixed_size(aFixedSizeIndex);
     }
 
+    void font::prepare_glyph_texture(const glyph& aGlyph) const
+    {
+        native_font_face().prepare_glyph_texture(aGlyph);
+    }
+
     const i_glyph_texture& font::glyph_texture(const glyph& aGlyph) const
     {
         return native_font_face().glyph_texture(aGlyph);
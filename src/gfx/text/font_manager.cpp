@@ -44,10 +44,14 @@
 #include <neogfx/app/i_app.hpp>
 #include <neogfx/gfx/i_rendering_engine.hpp>
 #include <neogfx/gfx/i_graphics_context.hpp>
+#include <neogfx/hid/i_surface_manager.hpp>
 #include <neogfx/gfx/text/font_manager.hpp>
 #include <neogfx/gfx/text/text_category_map.hpp>
 #include "../../gfx/text/native/native_font_face.hpp"
 #include "../../gfx/text/native/native_font.hpp"
+#include "../../gfx/text/native/glyph_rasterizer.hpp"
+#include "../../gfx/text/native/persistent_glyph_cache.hpp"
+#include "../../gfx/native/i_native_texture.hpp"
 
 template <>
 neogfx::i_font_manager& services::start_service<neogfx::i_font_manager>()
@@ -199,11 +203,38 @@ namespace neogfx
                 iParent{ aParent },
                 iFont{ static_cast<font_face_handle*>(aFont.native_font_face().handle())->harfbuzzFont },
                 iGlyphRun{ aGlyphRun },
-                iBuf{ static_cast<font_face_handle*>(aFont.native_font_face().handle())->harfbuzzBuf },
-                iGlyphCount{ 0u },
-                iGlyphInfo{ nullptr },
-                iGlyphPos{ nullptr }
+                iBuf{ static_cast<font_face_handle*>(aFont.native_font_face().handle())->harfbuzzBuf }
             {
+                auto const persistentCache = static_cast<font_manager&>(service<i_font_manager>()).persistent_glyph_cache();
+                std::optional<persistent_glyph_cache::shaping_key> shapingKey;
+                if (persistentCache != nullptr && static_cast<std::size_t>(std::get<1>(aGlyphRun) - std::get<0>(aGlyphRun)) <= persistent_glyph_cache::kMaxShapedRunLength)
+                {
+                    shapingKey = persistent_glyph_cache::shaping_key{
+                        static_cast<native_font_face&>(aFont.native_font_face()).persistent_key(),
+                        static_cast<uint32_t>(std::get<2>(aGlyphRun)),
+                        static_cast<uint32_t>(std::get<4>(aGlyphRun)),
+                        aFont.kerning(),
+                        std::u32string{ std::get<0>(aGlyphRun), std::get<1>(aGlyphRun) } };
+                    auto const cachedRun = persistentCache->find_shaped_run(*shapingKey);
+                    if (cachedRun != nullptr)
+                    {
+                        iGlyphInfo.resize(cachedRun->size());
+                        iGlyphPos.resize(cachedRun->size());
+                        for (std::size_t i = 0; i < cachedRun->size(); ++i)
+                        {
+                            auto const& sg = (*cachedRun)[i];
+                            iGlyphInfo[i] = hb_glyph_info_t{};
+                            iGlyphInfo[i].codepoint = sg.codepoint;
+                            iGlyphInfo[i].cluster = sg.cluster;
+                            iGlyphPos[i] = hb_glyph_position_t{};
+                            iGlyphPos[i].x_advance = sg.xAdvance;
+                            iGlyphPos[i].y_advance = sg.yAdvance;
+                            iGlyphPos[i].x_offset = sg.xOffset;
+                            iGlyphPos[i].y_offset = sg.yOffset;
+                        }
+                        return;
+                    }
+                }
                 hb_buffer_set_direction(iBuf, std::get<2>(aGlyphRun) == text_direction::RTL ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
                 hb_buffer_set_script(iBuf, std::get<4>(aGlyphRun));
                 std::vector<uint32_t> reversed;
@@ -243,21 +274,30 @@ namespace neogfx
                 scoped_kerning sk{ aFont.kerning() };
                 hb_shape(iFont, iBuf, NULL, 0);
                 unsigned int glyphCount = 0;
-                iGlyphInfo = hb_buffer_get_glyph_infos(iBuf, &glyphCount);
-                iGlyphPos = hb_buffer_get_glyph_positions(iBuf, &glyphCount);
-                iGlyphCount = glyphCount;
-                if (std::get<2>(aGlyphRun) == text_direction::None_RTL)
-                    for (uint32_t i = 0; i < iGlyphCount; ++i)
-                        iGlyphInfo[i].cluster = static_cast<uint32_t>(std::get<1>(aGlyphRun) - std::get<0>(aGlyphRun) - 1 - iGlyphInfo[i].cluster);
-            }
-            ~glyphs()
-            {
+                auto const glyphInfo = hb_buffer_get_glyph_infos(iBuf, &glyphCount);
+                auto const glyphPos = hb_buffer_get_glyph_positions(iBuf, &glyphCount);
+                // Copied out of the buffer as the buffer is shared by all runs shaped with this face.
+                iGlyphInfo.assign(glyphInfo, glyphInfo + glyphCount);
+                iGlyphPos.assign(glyphPos, glyphPos + glyphCount);
                 hb_buffer_clear_contents(iBuf);
+                if (std::get<2>(aGlyphRun) == text_direction::None_RTL)
+                    for (auto& gi : iGlyphInfo)
+                        gi.cluster = static_cast<uint32_t>(std::get<1>(aGlyphRun) - std::get<0>(aGlyphRun) - 1 - gi.cluster);
+                if (shapingKey)
+                {
+                    persistent_glyph_cache::shaped_run shapedRun;
+                    shapedRun.reserve(iGlyphInfo.size());
+                    for (std::size_t i = 0; i < iGlyphInfo.size(); ++i)
+                        shapedRun.push_back(persistent_glyph_cache::shaped_glyph{ 
+                            iGlyphInfo[i].codepoint, iGlyphInfo[i].cluster, 
+                            iGlyphPos[i].x_advance, iGlyphPos[i].y_advance, iGlyphPos[i].x_offset, iGlyphPos[i].y_offset });
+                    persistentCache->add_shaped_run(*shapingKey, shapedRun);
+                }
             }
         public:
             uint32_t glyph_count() const
             {
-                return iGlyphCount;
+                return static_cast<uint32_t>(iGlyphInfo.size());
             }
             const hb_glyph_info_t& glyph_info(uint32_t aIndex) const
             {
@@ -282,9 +322,8 @@ namespace neogfx
             hb_font_t* iFont;
             const glyph_text_factory::glyph_run& iGlyphRun;
             hb_buffer_t* iBuf;
-            uint32_t iGlyphCount;
-            hb_glyph_info_t* iGlyphInfo;
-            hb_glyph_position_t* iGlyphPos;
+            std::vector<hb_glyph_info_t> iGlyphInfo;
+            std::vector<hb_glyph_position_t> iGlyphPos;
         };
         typedef std::list<glyphs> glyphs_list;
         typedef std::vector<std::pair<glyphs_list::const_iterator, uint32_t>> result_type;
@@ -790,7 +829,11 @@ namespace neogfx
     font_manager::font_manager() :
         iGlyphTextFactory{ std::make_unique<neogfx::glyph_text_factory>() },
         iGlyphAtlas{ size{1024.0, 1024.0} },
-        iEmojiAtlas{}
+        iEmojiAtlas{},
+        iAsyncGlyphRasterization{ true },
+        iGlyphPlaceholders{ false },
+        iGlyphPlaceholdersIssued{ false },
+        iSdfGlyphs{ false }
     {
         FT_Error error = FT_Init_FreeType(&iFontLib);
         if (error)
@@ -863,9 +906,21 @@ namespace neogfx
 
     font_manager::~font_manager()
     {
+        try
+        {
+            disable_persistent_glyph_cache();
+        }
+        catch (std::exception const& e)
+        {
+            service<debug::logger>() << "neogfx: warning: Cannot save glyph cache: " << e.what() << endl;
+        }
         iIdCache.clear();
         iFontFamilies.clear();
+        for (auto const& font : iNativeFonts)
+            release_sdf_glyphs(font);
         iNativeFonts.clear();
+        iGlyphPlaceholderUpdater = std::nullopt;
+        iGlyphRasterizer.reset();
         FT_Done_FreeType(iFontLib);
     }
 
@@ -1098,6 +1153,139 @@ namespace neogfx
         return iEmojiAtlas;
     }
 
+    bool font_manager::async_glyph_rasterization() const
+    {
+        return iAsyncGlyphRasterization;
+    }
+
+    void font_manager::enable_async_glyph_rasterization(bool aEnable)
+    {
+        iAsyncGlyphRasterization = aEnable;
+    }
+
+    bool font_manager::glyph_placeholders() const
+    {
+        return iGlyphPlaceholders;
+    }
+
+    void font_manager::enable_glyph_placeholders(bool aEnable)
+    {
+        iGlyphPlaceholders = aEnable;
+    }
+
+    bool font_manager::sdf_glyphs() const
+    {
+        return iSdfGlyphs;
+    }
+
+    void font_manager::enable_sdf_glyphs(bool aEnable)
+    {
+        if (iSdfGlyphs != aEnable)
+        {
+            iSdfGlyphs = aEnable;
+            service<i_surface_manager>().invalidate_surfaces();
+        }
+    }
+
+    void font_manager::flush_glyphs()
+    {
+        bool committed = false;
+        if (iGlyphRasterizer)
+            for (auto& completed : iGlyphRasterizer->take_completed())
+            {
+                completed.first->commit_glyph(std::move(completed.second));
+                committed = true;
+            }
+        for (auto& upload : iGlyphUploads)
+            static_cast<i_native_texture&>(upload.texture->native_texture()).set_pixels(upload.texture->atlas_location(), &upload.pixels[0], 1u);
+        iGlyphUploads.clear();
+        if (committed && iGlyphPlaceholdersIssued)
+        {
+            iGlyphPlaceholdersIssued = !iGlyphRasterizer->idle();
+            service<i_surface_manager>().invalidate_surfaces();
+        }
+    }
+
+    bool font_manager::persistent_glyph_cache_enabled() const
+    {
+        return iPersistentGlyphCache != nullptr;
+    }
+
+    void font_manager::enable_persistent_glyph_cache(i_string const& aPath)
+    {
+        if (iPersistentGlyphCache != nullptr && iPersistentGlyphCache->path() == aPath.to_std_string())
+            return;
+        disable_persistent_glyph_cache();
+        iPersistentGlyphCache = std::make_unique<neogfx::persistent_glyph_cache>(aPath.to_std_string());
+    }
+
+    void font_manager::disable_persistent_glyph_cache()
+    {
+        if (iPersistentGlyphCache == nullptr)
+            return;
+        // Release the cache before saving so a failed save doesn't leave it enabled.
+        auto cache = std::move(iPersistentGlyphCache);
+        cache->save();
+    }
+
+    void font_manager::save_persistent_glyph_cache()
+    {
+        if (iPersistentGlyphCache != nullptr)
+            iPersistentGlyphCache->save();
+    }
+
+    glyph_rasterizer& font_manager::glyph_rasterizer()
+    {
+        if (!iGlyphRasterizer)
+            iGlyphRasterizer = std::make_unique<neogfx::glyph_rasterizer>();
+        return *iGlyphRasterizer;
+    }
+
+    void font_manager::queue_glyph_upload(i_sub_texture const& aTexture, std::vector<uint8_t>&& aPixels)
+    {
+        iGlyphUploads.push_back(glyph_upload{ &aTexture, std::move(aPixels) });
+    }
+
+    font_manager::sdf_glyph_cache& font_manager::sdf_cache()
+    {
+        return iSdfGlyphCache;
+    }
+
+    void font_manager::release_sdf_glyphs(native_font const& aFont)
+    {
+        // a font that was never hashed has never rendered a distance field glyph
+        if (aFont.cached_data_hash() == std::nullopt)
+            return;
+        auto const fontHash = *aFont.cached_data_hash();
+        // another font loaded from identical data still uses the entries
+        for (auto const& other : iNativeFonts)
+            if (&other != &aFont && other.cached_data_hash() == fontHash)
+                return;
+        for (auto i = iSdfGlyphCache.lower_bound(sdf_glyph_key{ fontHash, std::numeric_limits<long>::min(), false, 0u });
+            i != iSdfGlyphCache.end() && std::get<0>(i->first) == fontHash;)
+            i = iSdfGlyphCache.erase(i);
+    }
+
+    persistent_glyph_cache* font_manager::persistent_glyph_cache() const
+    {
+        return iPersistentGlyphCache.get();
+    }
+
+    void font_manager::glyph_placeholder_issued()
+    {
+        iGlyphPlaceholdersIssued = true;
+        if (iGlyphPlaceholderUpdater == std::nullopt)
+            iGlyphPlaceholderUpdater.emplace(service<i_async_task>(), [this](neolib::callback_timer& aTimer)
+            {
+                // Completed glyphs are committed and uploaded by the next render; just ask for one.
+                if (iGlyphRasterizer->has_completed())
+                    service<i_surface_manager>().invalidate_surfaces();
+                if (iGlyphPlaceholdersIssued)
+                    aTimer.again();
+            }, std::chrono::milliseconds{ 20 }, false);
+        iGlyphPlaceholderUpdater->again_if();
+    }
+
     void font_manager::add_ref(font_id aId)
     {
         font_from_id(aId).native_font_face().add_ref();
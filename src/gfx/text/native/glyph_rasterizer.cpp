@@ -0,0 +1,229 @@
+// glyph_rasterizer.cpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2020 Leigh Johnston.  All Rights Reserved.
+
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <neogfx/neogfx.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_LCD_FILTER_H
+#include "native_font_face.hpp"
+#include "glyph_rasterizer.hpp"
+
+namespace neogfx
+{
+    void lcd_filter_row(uint8_t const* aSource, uint32_t aSourceWidth, uint8_t* aDestination)
+    {
+        int32_t const width = static_cast<int32_t>(aSourceWidth);
+        auto const filter = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e) -> uint8_t
+        {
+            return static_cast<uint8_t>((a * 3u + b * 7u + c * 12u + d * 7u + e * 3u) >> 5u);
+        };
+        auto const filter_edge = [&](int32_t aTexel)
+        {
+            auto const sample = [&](int32_t s) -> uint32_t { return s >= 0 && s < width ? aSource[s] : 0u; };
+            for (int32_t x = aTexel * 3; x < std::min(aTexel * 3 + 3, width); ++x)
+                aDestination[aTexel * 4 + x % 3] = filter(sample(x - 2), sample(x - 1), sample(x), sample(x + 1), sample(x + 2));
+        };
+        // each destination texel is filtered from the seven contiguous source samples [3t - 2, 3t + 4]; for interior
+        // texels the whole window is in range so the loop body is straight-line code without index arithmetic
+        int32_t const texels = (width + 2) / 3;
+        int32_t const interiorBegin = std::min(1, texels);
+        int32_t const interiorEnd = std::max(interiorBegin, width >= 5 ? (width - 5) / 3 + 1 : 0);
+        for (int32_t t = 0; t < interiorBegin; ++t)
+            filter_edge(t);
+        for (int32_t t = interiorBegin; t < interiorEnd; ++t)
+        {
+            uint8_t const* const s = aSource + t * 3 - 2;
+            uint8_t* const d = aDestination + t * 4;
+            d[0] = filter(s[0], s[1], s[2], s[3], s[4]);
+            d[1] = filter(s[1], s[2], s[3], s[4], s[5]);
+            d[2] = filter(s[2], s[3], s[4], s[5], s[6]);
+        }
+        for (int32_t t = interiorEnd; t < texels; ++t)
+            filter_edge(t);
+    }
+
+    glyph_rasterizer::glyph_rasterizer(uint32_t aThreadCount)
+    {
+        for (uint32_t t = 0; t < aThreadCount; ++t)
+        {
+            auto& newWorker = iWorkers.emplace_back();
+            if (FT_Init_FreeType(&newWorker.fontLib) != FT_Err_Ok || FT_Library_SetLcdFilter(newWorker.fontLib, FT_LCD_FILTER_NONE) != FT_Err_Ok)
+            {
+                for (auto& w : iWorkers)
+                    if (w.fontLib != nullptr)
+                        FT_Done_FreeType(w.fontLib);
+                throw error_initializing_font_library();
+            }
+        }
+        for (auto& w : iWorkers)
+            w.thread = std::thread{ [this, &w]() { process(w); } };
+    }
+
+    glyph_rasterizer::~glyph_rasterizer()
+    {
+        {
+            std::unique_lock<std::mutex> lock{ iMutex };
+            iStopping = true;
+        }
+        iWorkAvailable.notify_all();
+        for (auto& w : iWorkers)
+        {
+            if (w.thread.joinable())
+                w.thread.join();
+            for (auto& f : w.faces)
+                FT_Done_Face(f.second);
+            w.faces.clear();
+            if (w.fontLib != nullptr)
+                FT_Done_FreeType(w.fontLib);
+            w.fontLib = nullptr;
+        }
+    }
+
+    void glyph_rasterizer::rasterize(native_font_face const& aFace, i_native_font_face::glyph_index_t aGlyphIndex)
+    {
+        {
+            std::unique_lock<std::mutex> lock{ iMutex };
+            iQueue.emplace_back(&aFace, aGlyphIndex);
+        }
+        iWorkAvailable.notify_one();
+    }
+
+    void glyph_rasterizer::wait(native_font_face const& aFace, i_native_font_face::glyph_index_t aGlyphIndex)
+    {
+        job const awaited{ &aFace, aGlyphIndex };
+        std::unique_lock<std::mutex> lock{ iMutex };
+        // move the awaited glyph to the front of the queue so we don't wait behind unrelated work
+        auto existing = std::find(iQueue.begin(), iQueue.end(), awaited);
+        if (existing != iQueue.end() && existing != iQueue.begin())
+        {
+            iQueue.erase(existing);
+            iQueue.push_front(awaited);
+        }
+        iWorkDone.wait(lock, [&]() { return !queued(awaited) && !in_flight(awaited); });
+    }
+
+    void glyph_rasterizer::cancel(native_font_face const& aFace)
+    {
+        std::unique_lock<std::mutex> lock{ iMutex };
+        iQueue.erase(std::remove_if(iQueue.begin(), iQueue.end(), [&](job const& j) { return j.first == &aFace; }), iQueue.end());
+        iWorkDone.wait(lock, [&]() { return !in_flight(aFace); });
+        iCompleted.erase(std::remove_if(iCompleted.begin(), iCompleted.end(), [&](completed_glyph const& g) { return g.first == &aFace; }), iCompleted.end());
+        for (auto& w : iWorkers)
+            w.retired.push_back(&aFace);
+    }
+
+    bool glyph_rasterizer::idle() const
+    {
+        std::unique_lock<std::mutex> lock{ iMutex };
+        if (!iQueue.empty())
+            return false;
+        for (auto const& w : iWorkers)
+            if (w.current)
+                return false;
+        return true;
+    }
+
+    bool glyph_rasterizer::has_completed() const
+    {
+        std::unique_lock<std::mutex> lock{ iMutex };
+        return !iCompleted.empty();
+    }
+
+    glyph_rasterizer::completed_glyph_list glyph_rasterizer::take_completed()
+    {
+        completed_glyph_list result;
+        std::unique_lock<std::mutex> lock{ iMutex };
+        result.swap(iCompleted);
+        return result;
+    }
+
+    bool glyph_rasterizer::queued(job const& aJob) const
+    {
+        return std::find(iQueue.begin(), iQueue.end(), aJob) != iQueue.end();
+    }
+
+    bool glyph_rasterizer::in_flight(job const& aJob) const
+    {
+        for (auto const& w : iWorkers)
+            if (w.current == aJob)
+                return true;
+        return false;
+    }
+
+    bool glyph_rasterizer::in_flight(native_font_face const& aFace) const
+    {
+        for (auto const& w : iWorkers)
+            if (w.current && w.current->first == &aFace)
+                return true;
+        return false;
+    }
+
+    void glyph_rasterizer::process(worker& aWorker)
+    {
+        std::vector<native_font_face const*> retired;
+        for (;;)
+        {
+            job next;
+            {
+                std::unique_lock<std::mutex> lock{ iMutex };
+                iWorkAvailable.wait(lock, [&]() { return iStopping || !iQueue.empty(); });
+                if (iStopping)
+                    return;
+                // Retirements are drained in the same critical section as the job is dequeued so a face
+                // destroyed and then reallocated at the same address never sees a stale FreeType face.
+                retired.swap(aWorker.retired);
+                next = iQueue.front();
+                iQueue.pop_front();
+                aWorker.current = next;
+            }
+            for (auto face : retired)
+            {
+                auto existing = aWorker.faces.find(face);
+                if (existing != aWorker.faces.end())
+                {
+                    FT_Done_Face(existing->second);
+                    aWorker.faces.erase(existing);
+                }
+            }
+            retired.clear();
+            rasterized_glyph result = { next.second };
+            try
+            {
+                auto existing = aWorker.faces.find(next.first);
+                if (existing == aWorker.faces.end())
+                    existing = aWorker.faces.emplace(next.first, next.first->clone_freetype_face(aWorker.fontLib)).first;
+                result = next.first->rasterize_glyph(aWorker.fontLib, existing->second, next.second);
+            }
+            catch (std::exception const& e)
+            {
+                result.error = e.what();
+            }
+            catch (...)
+            {
+                result.error = "unknown error";
+            }
+            {
+                std::unique_lock<std::mutex> lock{ iMutex };
+                iCompleted.emplace_back(next.first, std::move(result));
+                aWorker.current = std::nullopt;
+            }
+            iWorkDone.notify_all();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+// glyph_rasterizer.hpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2020 Leigh Johnston.  All Rights Reserved.
+
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <neogfx/neogfx.hpp>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <neogfx/core/geometrical.hpp>
+#include <neogfx/gfx/text/i_glyph_texture.hpp>
+#include "i_native_font_face.hpp"
+
+namespace neogfx
+{
+    class native_font_face;
+
+    struct rasterized_glyph
+    {
+        i_native_font_face::glyph_index_t index;
+        bool subpixel;
+        glyph_pixel_mode pixelMode;
+        point placement;
+        size_u32 extents;
+        std::vector<uint8_t> pixels;
+        std::optional<std::string> error;
+    };
+
+    // Filters a row of FT_RENDER_MODE_LCD coverage into RGBA sub-pixel texels using the
+    // 5-tap FIR (3, 7, 12, 7, 3) / 32 in integer arithmetic.
+    void lcd_filter_row(uint8_t const* aSource, uint32_t aSourceWidth, uint8_t* aDestination);
+
+    class glyph_rasterizer
+    {
+    public:
+        typedef std::pair<native_font_face const*, rasterized_glyph> completed_glyph;
+        typedef std::vector<completed_glyph> completed_glyph_list;
+    private:
+        typedef std::pair<native_font_face const*, i_native_font_face::glyph_index_t> job;
+        struct worker
+        {
+            FT_Library fontLib = nullptr;
+            std::unordered_map<native_font_face const*, FT_Face> faces;
+            std::vector<native_font_face const*> retired;
+            std::optional<job> current;
+            std::thread thread;
+        };
+    public:
+        struct error_initializing_font_library : std::runtime_error { error_initializing_font_library() : std::runtime_error("neogfx::glyph_rasterizer::error_initializing_font_library") {} };
+    public:
+        glyph_rasterizer(uint32_t aThreadCount = std::max(1u, std::min(8u, std::thread::hardware_concurrency() - 1u)));
+        ~glyph_rasterizer();
+    public:
+        void rasterize(native_font_face const& aFace, i_native_font_face::glyph_index_t aGlyphIndex);
+        void wait(native_font_face const& aFace, i_native_font_face::glyph_index_t aGlyphIndex);
+        void cancel(native_font_face const& aFace);
+        bool idle() const;
+        bool has_completed() const;
+        completed_glyph_list take_completed();
+    private:
+        bool queued(job const& aJob) const;
+        bool in_flight(job const& aJob) const;
+        bool in_flight(native_font_face const& aFace) const;
+        void process(worker& aWorker);
+    private:
+        mutable std::mutex iMutex;
+        std::condition_variable iWorkAvailable;
+        std::condition_variable iWorkDone;
+        std::deque<job> iQueue;
+        completed_glyph_list iCompleted;
+        std::deque<worker> iWorkers;
+        bool iStopping = false;
+    };
+}
\ No newline at end of file
@@ -22,8 +22,8 @@
 
 namespace neogfx
 {
-    glyph_texture::glyph_texture(const i_sub_texture& aTexture, bool aSubpixel, const point& aPlacement, glyph_pixel_mode aPixelMode) :
-        iTexture(aTexture), iSubpixel{ aSubpixel }, iPlacement{ aPlacement }, iPixelMode{ aPixelMode }
+    glyph_texture::glyph_texture(const i_sub_texture& aTexture, bool aSubpixel, const point& aPlacement, glyph_pixel_mode aPixelMode, const optional_size& aExtents) :
+        iTexture(aTexture), iSubpixel{ aSubpixel }, iPlacement{ aPlacement }, iExtents{ aExtents ? *aExtents : aTexture.extents() }, iPixelMode{ aPixelMode }
     {
     }
 
@@ -46,6 +46,11 @@ namespace neogfx
         return iPlacement;
     }
 
+    const size& glyph_texture::extents() const
+    {
+        return iExtents;
+    }
+
     glyph_pixel_mode glyph_texture::pixel_mode() const
     {
         return iPixelMode;
@@ -27,17 +27,19 @@ namespace neogfx
     class glyph_texture : public i_glyph_texture
     {
     public:
-        glyph_texture(const i_sub_texture& aTexture, bool aSubpixel, const point& aPlacement, glyph_pixel_mode aPixelMode);
+        glyph_texture(const i_sub_texture& aTexture, bool aSubpixel, const point& aPlacement, glyph_pixel_mode aPixelMode, const optional_size& aExtents = {});
         ~glyph_texture();
     public:
         const i_sub_texture& texture() const override;
         bool subpixel() const override;
         const point& placement() const override;
+        const size& extents() const override;
         glyph_pixel_mode pixel_mode() const override;
     private:
         const i_sub_texture& iTexture;
         bool iSubpixel;
         const point iPlacement;
+        const size iExtents;
         glyph_pixel_mode iPixelMode;
     };
 }
\ No newline at end of file
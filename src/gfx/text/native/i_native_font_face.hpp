@@ -74,6 +74,7 @@ namespace neogfx
         virtual i_native_font_face& fallback() const = 0;
         virtual void* handle() const = 0;
         virtual glyph_index_t glyph_index(char32_t aCodePoint) const = 0;
+        virtual void prepare_glyph_texture(const glyph& aGlyph) const = 0;
         virtual i_glyph_texture& glyph_texture(const glyph& aGlyph) const = 0;
     };
 }
\ No newline at end of file
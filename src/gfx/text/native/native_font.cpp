@@ -264,4 +264,17 @@ namespace neogfx
             throw;
         }
     }
+
+    uint64_t native_font::data_hash(FT_Face aFace) const
+    {
+        // every face of this font is opened from the same data so it only needs hashing once
+        if (iDataHash == std::nullopt)
+            iDataHash = persistent_glyph_cache::hash(aFace->stream->base, static_cast<std::size_t>(aFace->stream->size));
+        return *iDataHash;
+    }
+
+    std::optional<uint64_t> const& native_font::cached_data_hash() const
+    {
+        return iDataHash;
+    }
 }
\ No newline at end of file
@@ -57,6 +57,9 @@ namespace neogfx
         void remove_style(uint32_t aStyleIndex) override;
         void create_face(font_style aStyle, font::point_size aSize, const i_device_resolution& aDevice, i_ref_ptr<i_native_font_face>& aResult) override;
         void create_face(i_string const& aStyleName, font::point_size aSize, const i_device_resolution& aDevice, i_ref_ptr<i_native_font_face>& aResult) override;
+    public:
+        uint64_t data_hash(FT_Face aFace) const;
+        std::optional<uint64_t> const& cached_data_hash() const;
     private:
         style_map::const_iterator find_style(font_style aStyle) const;
         void register_faces();
@@ -73,5 +76,6 @@ namespace neogfx
         FT_Long iFaceCount;
         style_map iStyleMap;
         face_map iFaces;
+        mutable std::optional<uint64_t> iDataHash;
     };
 }
\ No newline at end of file
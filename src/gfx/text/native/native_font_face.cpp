@@ -27,11 +27,13 @@
 #include FT_BITMAP_H
 #include FT_LCD_FILTER_H
 #include FT_ADVANCES_H
+#include FT_MODULE_H
 #include "../../native/opengl.hpp"
 #include "../../native/i_native_texture.hpp"
+#include "native_font.hpp"
 #include "native_font_face.hpp"
 #include <neogfx/gfx/text/glyph.hpp>
-#include <neogfx/gfx/text/i_font_manager.hpp>
+#include <neogfx/gfx/text/font_manager.hpp>
 #include <neogfx/gfx/i_texture_atlas.hpp>
 #include <neogfx/gfx/i_rendering_engine.hpp>
 
@@ -42,6 +44,10 @@ namespace neogfx
         typedef std::unordered_map<std::pair<FT_UInt, FT_Int32>, FT_Fixed, boost::hash<std::pair<FT_UInt, FT_Int32>>> get_advance_cache_face;
         typedef std::unordered_map<FT_Face, get_advance_cache_face> get_advance_cache;
         get_advance_cache sGetAdvanceCache;
+
+        // Distance field glyphs are rendered at this pixel size and scaled to the size of each face.
+        constexpr FT_UInt kSdfReferencePixelSize = 64u;
+        constexpr FT_Int kSdfSpread = 8;
     }
 
     bool& kerning_enabled_flag()
@@ -86,6 +92,10 @@ namespace neogfx
 
     native_font_face::~native_font_face()
     {
+        if (iRasterizer != nullptr)
+            iRasterizer->cancel(*this);
+        if (iSdfFace != nullptr)
+            FT_Done_Face(iSdfFace);
         if (iHandle.freetypeFace != nullptr)
             sGetAdvanceCache.erase(sGetAdvanceCache.find(iHandle.freetypeFace));
         FT_Done_Face(iHandle.freetypeFace);
@@ -283,133 +293,318 @@ namespace neogfx
         }
     }
          
+    void native_font_face::prepare_glyph_texture(const glyph& aGlyph) const
+    {
+        auto& fontManager = service<i_font_manager>();
+        if (!fontManager.async_glyph_rasterization() || use_sdf_glyphs() || glyph_cached(aGlyph.value) || restore_glyph(aGlyph.value) || !iPendingGlyphs.insert(aGlyph.value).second)
+            return;
+        if (iRasterizer == nullptr)
+            iRasterizer = &static_cast<font_manager&>(fontManager).glyph_rasterizer();
+        iRasterizer->rasterize(*this, aGlyph.value);
+    }
+
     i_glyph_texture& native_font_face::glyph_texture(const glyph& aGlyph) const
     {
-        auto existingGlyph = iGlyphs.find(aGlyph.value);
-        if (existingGlyph != iGlyphs.end())
-            return existingGlyph->second;
-        try
+        if (use_sdf_glyphs())
+            return sdf_glyph_texture(aGlyph);
+        if (glyph_cached(aGlyph.value) || restore_glyph(aGlyph.value))
+            return cached_glyph_texture(aGlyph);
+        auto& fontManager = service<i_font_manager>();
+        if (fontManager.async_glyph_rasterization())
         {
-            try
-            {
-                // todo: remove FT_LOAD_NO_AUTOHINT when cause of crash in freetype 2.11 with certain fonts is resolved
-                freetypeCheck(FT_Load_Glyph(iHandle.freetypeFace, aGlyph.value, FT_LOAD_NO_AUTOHINT | FT_LOAD_TARGET_LCD | FT_LOAD_NO_BITMAP));
-            }
-            catch (freetype_error fe)
+            prepare_glyph_texture(aGlyph);
+            if (fontManager.glyph_placeholders())
             {
-                service<debug::logger>() << "neogfx: warning: Cannot load font glyph" << endl;
-                throw freetype_load_glyph_error(fe.what());
+                static_cast<font_manager&>(fontManager).glyph_placeholder_issued();
+                return invalid_glyph();
             }
+            iRasterizer->wait(*this, aGlyph.value);
+            fontManager.flush_glyphs();
+        }
+        else
+        {
+            rasterized_glyph rasterizedGlyph = {};
             try
             {
-                freetypeCheck(FT_Render_Glyph(iHandle.freetypeFace->glyph, FT_RENDER_MODE_LCD));
+                rasterizedGlyph = rasterize_glyph(iFontLib, iHandle.freetypeFace, aGlyph.value);
             }
-            catch (freetype_error fe)
+            catch (freetype_error const& fe)
             {
-                service<debug::logger>() << "neogfx: warning: Cannot render font glyph" << endl;
-                throw freetype_render_glyph_error(fe.what());
+                rasterizedGlyph.index = aGlyph.value;
+                rasterizedGlyph.error = fe.what();
             }
+            commit_glyph(std::move(rasterizedGlyph));
+        }
+        if (glyph_cached(aGlyph.value))
+            return cached_glyph_texture(aGlyph);
+        return invalid_glyph();
+    }
+
+    FT_Face native_font_face::clone_freetype_face(FT_Library aFontLib) const
+    {
+        // All faces are opened from memory (see native_font::open_face) so the clone can share the font data.
+        FT_Face clone = nullptr;
+        freetypeCheck(FT_New_Memory_Face(
+            aFontLib,
+            iHandle.freetypeFace->stream->base,
+            static_cast<FT_Long>(iHandle.freetypeFace->stream->size),
+            iHandle.freetypeFace->face_index,
+            &clone));
+        try
+        {
+            set_size(clone);
         }
         catch (...)
         {
-            thread_local bool inHere = false;
-            if (!inHere)
-            {
-                neolib::scoped_flag sf{ inHere };
-                glyph invalid = aGlyph;
-                auto const replacementGlyph = FT_Get_Char_Index(iHandle.freetypeFace, 0xFFFD);
-                if (replacementGlyph != 0)
-                {
-                    invalid.value = replacementGlyph;
-                    return glyph_texture(aGlyph);
-                }
-            }
-            return invalid_glyph();
+            FT_Done_Face(clone);
+            throw;
         }
+        return clone;
+    }
 
-        bool useSubpixelFiltering = true;
+    rasterized_glyph native_font_face::rasterize_glyph(FT_Library aFontLib, FT_Face aFreetypeFace, glyph_index_t aGlyphIndex) const
+    {
+        try
+        {
+            // todo: remove FT_LOAD_NO_AUTOHINT when cause of crash in freetype 2.11 with certain fonts is resolved
+            freetypeCheck(FT_Load_Glyph(aFreetypeFace, aGlyphIndex, FT_LOAD_NO_AUTOHINT | FT_LOAD_TARGET_LCD | FT_LOAD_NO_BITMAP));
+        }
+        catch (freetype_error fe)
+        {
+            throw freetype_load_glyph_error(fe.what());
+        }
+        try
+        {
+            freetypeCheck(FT_Render_Glyph(aFreetypeFace->glyph, FT_RENDER_MODE_LCD));
+        }
+        catch (freetype_error fe)
+        {
+            throw freetype_render_glyph_error(fe.what());
+        }
 
-        FT_Bitmap& bitmap = iHandle.freetypeFace->glyph->bitmap;
+        FT_Bitmap& bitmap = aFreetypeFace->glyph->bitmap;
 
         if ((style() & (font_style::EmulatedBold)) == font_style::EmulatedBold)
-            FT_Bitmap_Embolden(iFontLib, &bitmap, static_cast<FT_F26Dot6>(default_dpi_scale_factor(iPixelDensityDpi.cx) * 64), 0);
+            FT_Bitmap_Embolden(aFontLib, &bitmap, static_cast<FT_F26Dot6>(default_dpi_scale_factor(iPixelDensityDpi.cx) * 64), 0);
 
-        auto pixelMode = to_glyph_pixel_mode(bitmap.pixel_mode);
+        rasterized_glyph result = {};
+        result.index = aGlyphIndex;
+        result.pixelMode = to_glyph_pixel_mode(bitmap.pixel_mode);
+        result.subpixel = (result.pixelMode == glyph_pixel_mode::LCD);
+        result.placement = point{
+            aFreetypeFace->glyph->metrics.horiBearingX / 64.0,
+            (aFreetypeFace->glyph->metrics.horiBearingY - aFreetypeFace->glyph->metrics.height) / 64.0 };
+        result.extents = size_u32{ bitmap.width / (result.subpixel ? 3u : 1u), bitmap.rows };
 
-        if (pixelMode != glyph_pixel_mode::LCD)
-            useSubpixelFiltering = false;
+        if (result.extents.cx == 0)
+            return result;
 
-        auto subTextureWidth = bitmap.width / (useSubpixelFiltering ? 3 : 1);
-        if (subTextureWidth == 0)
-            return invalid_glyph();
-
-        auto& subTexture = service<i_font_manager>().glyph_atlas().create_sub_texture(
-            neogfx::size{ static_cast<dimension>(subTextureWidth), static_cast<dimension>(bitmap.rows) }.ceil(),
-            1.0, texture_sampling::Normal, pixelMode != glyph_pixel_mode::Mono ? texture_data_format::SubPixel : texture_data_format::Red);
+        std::size_t const textureWidth = result.extents.cx;
 
-        rect glyphRect{ subTexture.atlas_location() };
-        i_glyph_texture& glyphTexture = iGlyphs.insert(std::make_pair(aGlyph.value,
-            neogfx::glyph_texture{
-                subTexture,
-                useSubpixelFiltering,
-                point{
-                    iHandle.freetypeFace->glyph->metrics.horiBearingX / 64.0,
-                    (iHandle.freetypeFace->glyph->metrics.horiBearingY - iHandle.freetypeFace->glyph->metrics.height) / 64.0 },
-                pixelMode })).first->second;
-
-        thread_local std::vector<GLubyte> glyphTextureData;
-        thread_local std::vector<std::array<GLubyte, 4>> subpixelGlyphTextureData;
-        glyphTextureData.clear();
-        subpixelGlyphTextureData.clear();
-
-        const GLubyte* textureData = 0;
-        
-        if (useSubpixelFiltering)
+        if (result.subpixel)
         {
-            subpixelGlyphTextureData.resize(static_cast<std::size_t>(glyphRect.cx * glyphRect.cy));
-            // sub-pixel FIR filter.
-            static double coefficients[] = { 1.5 / 16.0, 3.5 / 16.0, 6.0 / 16.0, 3.5 / 16.0, 1.5 / 16.0 };
+            result.pixels.resize(textureWidth * bitmap.rows * 4u);
             for (uint32_t y = 0; y < bitmap.rows; y++)
-            {
-                for (uint32_t x = 0; x < bitmap.width; x++)
-                {
-                    uint8_t alpha = 0;
-                    for (int32_t z = -2; z <= 2; ++z)
-                    {
-                        int32_t const s = x + z;
-                        if (s >= 0 && s <= static_cast<int32_t>(bitmap.width) - 1)
-                            alpha += static_cast<uint8_t>(bitmap.buffer[s + bitmap.pitch * y] * coefficients[z + 2]);
-                    }
-                    subpixelGlyphTextureData[(x / 3) + (bitmap.rows - 1 - y) * static_cast<std::size_t>(glyphRect.cx)][x % 3] = alpha;
-                }
-            }
-            textureData = &subpixelGlyphTextureData[0][0];
+                lcd_filter_row(&bitmap.buffer[bitmap.pitch * y], bitmap.width, &result.pixels[(bitmap.rows - 1 - y) * textureWidth * 4u]);
         }
         else
         {
-            glyphTextureData.resize(static_cast<std::size_t>(glyphRect.cx * glyphRect.cy));
+            result.pixels.resize(textureWidth * bitmap.rows);
             for (uint32_t y = 0; y < bitmap.rows; y++)
                 switch (bitmap.pixel_mode)
                 {
                 case FT_PIXEL_MODE_MONO: // 1 bit per pixel monochrome
                     for (uint32_t x = 0; x < bitmap.width; x += 8)
                         for (uint32_t b = 0; b < std::min(bitmap.width - x, 8u); ++b)
-                            glyphTextureData[(x + b) + (bitmap.rows - 1 - y) * static_cast<std::size_t>(glyphRect.cx)] =
-                                (x >= bitmap.width || y >= bitmap.rows) ? 0x00 : ((bitmap.buffer[x / 8 + bitmap.pitch * y] & (1 << (7 - b))) != 0 ? 0xFF : 0x00);
+                            result.pixels[(x + b) + (bitmap.rows - 1 - y) * textureWidth] =
+                                ((bitmap.buffer[x / 8 + bitmap.pitch * y] & (1 << (7 - b))) != 0 ? 0xFF : 0x00);
                     break;
                 case FT_PIXEL_MODE_GRAY:
                 default:
                     for (uint32_t x = 0; x < bitmap.width; x++)
-                        glyphTextureData[x + (bitmap.rows - 1 - y) * static_cast<std::size_t>(glyphRect.cx)] =
-                            (x >= bitmap.width || y >= bitmap.rows) ? 0x00 : bitmap.buffer[x + bitmap.pitch * y];
+                        result.pixels[x + (bitmap.rows - 1 - y) * textureWidth] = bitmap.buffer[x + bitmap.pitch * y];
                     break;
                 }
-            textureData = &glyphTextureData[0];
         }
-        
-        static_cast<i_native_texture&>(glyphTexture.texture().native_texture()).set_pixels(glyphRect, &textureData[0], 1u);
 
-        return glyphTexture;
+        return result;
+    }
+
+    void native_font_face::commit_glyph(rasterized_glyph&& aGlyph, bool aPersist) const
+    {
+        iPendingGlyphs.erase(aGlyph.index);
+        if (aGlyph.error)
+        {
+            service<debug::logger>() << "neogfx: warning: Cannot render font glyph: " << *aGlyph.error << endl;
+            iFailedGlyphs.insert(aGlyph.index);
+            return;
+        }
+        auto& fontManager = static_cast<font_manager&>(service<i_font_manager>());
+        if (aPersist && fontManager.persistent_glyph_cache() != nullptr)
+            fontManager.persistent_glyph_cache()->add_glyph(persistent_key(), aGlyph.index, aGlyph.subpixel, aGlyph.pixelMode, aGlyph.placement, aGlyph.extents, aGlyph.pixels);
+        if (aGlyph.extents.cx == 0 || aGlyph.pixels.empty())
+        {
+            iEmptyGlyphs.insert(aGlyph.index);
+            return;
+        }
+
+        auto& subTexture = fontManager.glyph_atlas().create_sub_texture(
+            aGlyph.extents.as<dimension>(),
+            1.0, texture_sampling::Normal, aGlyph.pixelMode != glyph_pixel_mode::Mono ? texture_data_format::SubPixel : texture_data_format::Red);
+
+        iGlyphs.insert(std::make_pair(aGlyph.index,
+            neogfx::glyph_texture{
+                subTexture,
+                aGlyph.subpixel,
+                aGlyph.placement,
+                aGlyph.pixelMode }));
+
+        fontManager.queue_glyph_upload(subTexture, std::move(aGlyph.pixels));
+    }
+
+    persistent_glyph_cache::face_key const& native_font_face::persistent_key() const
+    {
+        // Keyed by a hash of the font data rather than by font id so the key is stable across runs.
+        if (iPersistentKey == std::nullopt)
+            iPersistentKey = persistent_glyph_cache::face_key{
+                static_cast<neogfx::native_font const&>(iFont).data_hash(iHandle.freetypeFace),
+                static_cast<int64_t>(iHandle.freetypeFace->face_index),
+                static_cast<uint32_t>(style()),
+                iSize,
+                iPixelDensityDpi.cx,
+                iPixelDensityDpi.cy };
+        return *iPersistentKey;
+    }
+
+    bool native_font_face::restore_glyph(glyph_index_t aGlyphIndex) const
+    {
+        auto const cache = static_cast<font_manager&>(service<i_font_manager>()).persistent_glyph_cache();
+        if (cache == nullptr)
+            return false;
+        auto const record = cache->find_glyph(persistent_key(), aGlyphIndex);
+        if (record == nullptr)
+            return false;
+        rasterized_glyph restoredGlyph = {};
+        restoredGlyph.index = aGlyphIndex;
+        restoredGlyph.subpixel = record->subpixel;
+        restoredGlyph.pixelMode = record->pixelMode;
+        restoredGlyph.placement = record->placement;
+        restoredGlyph.extents = record->extents;
+        restoredGlyph.pixels.assign(record->pixels, record->pixels + record->pixelCount);
+        commit_glyph(std::move(restoredGlyph), false);
+        return true;
+    }
+
+    bool native_font_face::use_sdf_glyphs() const
+    {
+        return service<i_font_manager>().sdf_glyphs() && !is_bitmap_font();
+    }
+
+    i_glyph_texture& native_font_face::sdf_glyph_texture(const glyph& aGlyph) const
+    {
+        auto existingGlyph = iSdfGlyphs.find(aGlyph.value);
+        if (existingGlyph != iSdfGlyphs.end())
+            return existingGlyph->second;
+
+        auto& fontManager = static_cast<font_manager&>(service<i_font_manager>());
+        auto& sdfCache = fontManager.sdf_cache();
+        bool const emulatedBold = (style() & font_style::EmulatedBold) == font_style::EmulatedBold;
+        font_manager::sdf_glyph_key const key{ static_cast<neogfx::native_font const&>(iFont).data_hash(iHandle.freetypeFace), iHandle.freetypeFace->face_index, emulatedBold, aGlyph.value };
+        auto existingSdfGlyph = sdfCache.find(key);
+        if (existingSdfGlyph == sdfCache.end())
+        {
+            // One distance field per font glyph, rendered at a fixed reference size, is shared by faces of all sizes.
+            if (iSdfFace == nullptr)
+            {
+                iSdfFace = clone_freetype_face(iFontLib);
+                freetypeCheck(FT_Set_Pixel_Sizes(iSdfFace, 0, kSdfReferencePixelSize));
+            }
+            font_manager::sdf_glyph sdfGlyph = {};
+            try
+            {
+                freetypeCheck(FT_Load_Glyph(iSdfFace, aGlyph.value, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP));
+                if (emulatedBold)
+                    freetypeCheck(FT_Outline_Embolden(&iSdfFace->glyph->outline, static_cast<FT_Pos>(kSdfReferencePixelSize * 64 / 32)));
+                freetypeCheck(FT_Property_Set(iFontLib, "sdf", "spread", &kSdfSpread));
+                freetypeCheck(FT_Render_Glyph(iSdfFace->glyph, FT_RENDER_MODE_SDF));
+            }
+            catch (freetype_error const& fe)
+            {
+                service<debug::logger>() << "neogfx: warning: Cannot render distance field glyph: " << fe.what() << endl;
+                existingSdfGlyph = sdfCache.emplace(key, sdfGlyph).first;
+            }
+            if (existingSdfGlyph == sdfCache.end())
+            {
+                FT_Bitmap const& bitmap = iSdfFace->glyph->bitmap;
+                if (bitmap.width != 0 && bitmap.rows != 0)
+                {
+                    std::vector<uint8_t> pixels(static_cast<std::size_t>(bitmap.width) * bitmap.rows);
+                    for (uint32_t y = 0; y < bitmap.rows; y++)
+                        std::copy(&bitmap.buffer[bitmap.pitch * y], &bitmap.buffer[bitmap.pitch * y] + bitmap.width, &pixels[(bitmap.rows - 1 - y) * static_cast<std::size_t>(bitmap.width)]);
+                    auto& subTexture = fontManager.glyph_atlas().create_sub_texture(
+                        neogfx::size{ static_cast<dimension>(bitmap.width), static_cast<dimension>(bitmap.rows) },
+                        1.0, texture_sampling::Normal, texture_data_format::Red);
+                    fontManager.queue_glyph_upload(subTexture, std::move(pixels));
+                    sdfGlyph.texture = &subTexture;
+                    sdfGlyph.placement = point{
+                        static_cast<coordinate>(iSdfFace->glyph->bitmap_left),
+                        static_cast<coordinate>(iSdfFace->glyph->bitmap_top) - static_cast<coordinate>(bitmap.rows) };
+                }
+                existingSdfGlyph = sdfCache.emplace(key, sdfGlyph).first;
+            }
+        }
+
+        auto const& sdfGlyph = existingSdfGlyph->second;
+        if (sdfGlyph.texture == nullptr)
+            return invalid_glyph();
+        auto const scale = sdf_scale();
+        return iSdfGlyphs.emplace(aGlyph.value, 
+            neogfx::glyph_texture{ 
+                *sdfGlyph.texture, 
+                false, 
+                sdfGlyph.placement * scale, 
+                glyph_pixel_mode::SDF, 
+                sdfGlyph.texture->extents() * scale }).first->second;
+    }
+
+    scalar native_font_face::sdf_scale() const
+    {
+        auto const size = ((style() & (font_style::Superscript | font_style::Subscript)) == font_style::Invalid) ? iSize : iSize * 0.58;
+        return size * iPixelDensityDpi.cy / 72.0 / kSdfReferencePixelSize;
+    }
+
+    bool native_font_face::glyph_cached(glyph_index_t aGlyphIndex) const
+    {
+        return iGlyphs.find(aGlyphIndex) != iGlyphs.end() || 
+            iEmptyGlyphs.find(aGlyphIndex) != iEmptyGlyphs.end() || 
+            iFailedGlyphs.find(aGlyphIndex) != iFailedGlyphs.end();
+    }
+
+    i_glyph_texture& native_font_face::cached_glyph_texture(const glyph& aGlyph) const
+    {
+        auto existingGlyph = iGlyphs.find(aGlyph.value);
+        if (existingGlyph != iGlyphs.end())
+            return existingGlyph->second;
+        if (iFailedGlyphs.find(aGlyph.value) != iFailedGlyphs.end())
+            return replacement_glyph(aGlyph);
+        return invalid_glyph();
+    }
+
+    i_glyph_texture& native_font_face::replacement_glyph(const glyph& aGlyph) const
+    {
+        thread_local bool inHere = false;
+        if (!inHere)
+        {
+            neolib::scoped_flag sf{ inHere };
+            auto const replacementGlyph = FT_Get_Char_Index(iHandle.freetypeFace, 0xFFFD);
+            if (replacementGlyph != 0 && replacementGlyph != aGlyph.value)
+            {
+                glyph replacement = aGlyph;
+                replacement.value = replacementGlyph;
+                return glyph_texture(replacement);
+            }
+        }
+        return invalid_glyph();
     }
 
     i_glyph_texture& native_font_face::invalid_glyph() const
@@ -429,29 +624,39 @@ namespace neogfx
         return *iInvalidGlyph;
     }
 
-    void native_font_face::set_metrics()
+    font::point_size native_font_face::rendered_size() const
     {
-        auto const size = ((style() & (font_style::Superscript | font_style::Subscript)) == font_style::Invalid) ? iSize : iSize * 0.58;
-        if (!is_bitmap_font())
+        return ((style() & (font_style::Superscript | font_style::Subscript)) == font_style::Invalid) ? iSize : iSize * 0.58;
+    }
+
+    void native_font_face::set_size(FT_Face aFreetypeFace) const
+    {
+        auto const size = rendered_size();
+        if (FT_IS_SCALABLE(aFreetypeFace))
         {
-            freetypeCheck(FT_Set_Char_Size(iHandle.freetypeFace, 0, static_cast<FT_F26Dot6>(size * 64), static_cast<FT_UInt>(iPixelDensityDpi.cx), static_cast<FT_UInt>(iPixelDensityDpi.cy)));
+            freetypeCheck(FT_Set_Char_Size(aFreetypeFace, 0, static_cast<FT_F26Dot6>(size * 64), static_cast<FT_UInt>(iPixelDensityDpi.cx), static_cast<FT_UInt>(iPixelDensityDpi.cy)));
         }
         else
         {
             auto requestedSize = size * iPixelDensityDpi.cy / 72.0;
-            auto availableSize = iHandle.freetypeFace->available_sizes[0].size / 64.0;
+            auto availableSize = aFreetypeFace->available_sizes[0].size / 64.0;
             FT_Int strikeIndex = 0;
-            for (FT_Int si = 0; si < iHandle.freetypeFace->num_fixed_sizes; ++si)
+            for (FT_Int si = 0; si < aFreetypeFace->num_fixed_sizes; ++si)
             {
-                auto nextAvailableSize = iHandle.freetypeFace->available_sizes[si].size / 64.0;
+                auto nextAvailableSize = aFreetypeFace->available_sizes[si].size / 64.0;
                 if (abs(requestedSize - nextAvailableSize) < abs(requestedSize - availableSize))
                 {
                     availableSize = nextAvailableSize;
                     strikeIndex = si;
                 }
             }
-            freetypeCheck(FT_Select_Size(iHandle.freetypeFace, strikeIndex));
+            freetypeCheck(FT_Select_Size(aFreetypeFace, strikeIndex));
         }
+    }
+
+    void native_font_face::set_metrics()
+    {
+        set_size(iHandle.freetypeFace);
         if (iMetrics == std::nullopt)
             iMetrics.emplace(iHandle.freetypeFace->size->metrics);
         for (const FT_CharMap* cm = iHandle.freetypeFace->charmaps; cm != iHandle.freetypeFace->charmaps + iHandle.freetypeFace->num_charmaps; ++cm)
@@ -464,7 +669,7 @@ namespace neogfx
         }
         hb_font_set_scale(
             iHandle.harfbuzzFont, 
-            static_cast<int>(size * iPixelDensityDpi.cx / 72.0 * 64), 
-            static_cast<int>(size * iPixelDensityDpi.cy / 72.0 * 64));
+            static_cast<int>(rendered_size() * iPixelDensityDpi.cx / 72.0 * 64), 
+            static_cast<int>(rendered_size() * iPixelDensityDpi.cy / 72.0 * 64));
     }
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
 
 #include <neogfx/neogfx.hpp>
 #include <unordered_map>
+#include <unordered_set>
 #include <boost/functional/hash.hpp>
 #include <boost/pool/pool_alloc.hpp>
 #include <ft2build.h>
@@ -41,6 +42,8 @@
 #include <neogfx/hid/i_surface.hpp>
 #include <neogfx/gfx/text/font.hpp>
 #include "glyph_texture.hpp"
+#include "glyph_rasterizer.hpp"
+#include "persistent_glyph_cache.hpp"
 #include "i_native_font.hpp"
 #include "i_native_font_face.hpp"
 
@@ -106,6 +109,7 @@ namespace neogfx
     {
     private:
         typedef std::unordered_map<glyph_index_t, neogfx::glyph_texture> glyph_map;
+        typedef std::unordered_set<glyph_index_t> glyph_set;
         typedef std::pair<glyph_index_t, glyph_index_t> kerning_pair;
         typedef std::unordered_map<kerning_pair, dimension, boost::hash<kerning_pair>, std::equal_to<kerning_pair>,
             boost::fast_pool_allocator<std::pair<const kerning_pair, dimension>>> kerning_table;
@@ -141,9 +145,24 @@ namespace neogfx
         i_native_font_face& fallback() const final;
         void* handle() const final;
         glyph_index_t glyph_index(char32_t aCodePoint) const final;
+        void prepare_glyph_texture(const glyph& aGlyph) const final;
         i_glyph_texture& glyph_texture(const glyph& aGlyph) const final;
+    public:
+        FT_Face clone_freetype_face(FT_Library aFontLib) const;
+        rasterized_glyph rasterize_glyph(FT_Library aFontLib, FT_Face aFreetypeFace, glyph_index_t aGlyphIndex) const;
+        void commit_glyph(rasterized_glyph&& aGlyph, bool aPersist = true) const;
+        persistent_glyph_cache::face_key const& persistent_key() const;
     private:
+        bool restore_glyph(glyph_index_t aGlyphIndex) const;
+        bool use_sdf_glyphs() const;
+        i_glyph_texture& sdf_glyph_texture(const glyph& aGlyph) const;
+        scalar sdf_scale() const;
+        bool glyph_cached(glyph_index_t aGlyphIndex) const;
+        i_glyph_texture& cached_glyph_texture(const glyph& aGlyph) const;
+        i_glyph_texture& replacement_glyph(const glyph& aGlyph) const;
         i_glyph_texture& invalid_glyph() const;
+        font::point_size rendered_size() const;
+        void set_size(FT_Face aFreetypeFace) const;
         void set_metrics();
     private:
         FT_Library iFontLib;
@@ -157,6 +176,13 @@ namespace neogfx
         std::optional<FT_Size_Metrics> iMetrics;
         mutable ref_ptr<i_native_font_face> iFallbackFont;
         mutable glyph_map iGlyphs;
+        mutable glyph_set iPendingGlyphs;
+        mutable glyph_set iEmptyGlyphs;
+        mutable glyph_set iFailedGlyphs;
+        mutable glyph_rasterizer* iRasterizer = nullptr;
+        mutable glyph_map iSdfGlyphs;
+        mutable FT_Face iSdfFace = nullptr;
+        mutable std::optional<persistent_glyph_cache::face_key> iPersistentKey;
         bool iHasKerning = false;
         neogfx::kerning_method iKerningMethod = neogfx::kerning_method::Harfbuzz;
         mutable kerning_table iKerningTable;
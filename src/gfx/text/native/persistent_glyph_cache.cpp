@@ -0,0 +1,338 @@
+// persistent_glyph_cache.cpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2020 Leigh Johnston.  All Rights Reserved.
+
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <neogfx/neogfx.hpp>
+#include <fstream>
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <harfbuzz/hb.h>
+#include "persistent_glyph_cache.hpp"
+
+namespace neogfx
+{
+    namespace
+    {
+        char const kMagic[8] = { 'n', 'e', 'o', 'G', 'F', 'X', 'g', 'c' };
+        uint32_t const kFormatVersion = 1u;
+        uint32_t const kFreetypeVersion = (FREETYPE_MAJOR << 16) | (FREETYPE_MINOR << 8) | FREETYPE_PATCH;
+        uint32_t const kHarfbuzzVersion = (HB_VERSION_MAJOR << 16) | (HB_VERSION_MINOR << 8) | HB_VERSION_MICRO;
+
+        class reader
+        {
+        public:
+            reader(char const* aBegin, char const* aEnd) :
+                iNext{ aBegin }, iEnd{ aEnd }
+            {
+            }
+        public:
+            template <typename T>
+            T read()
+            {
+                T result;
+                read(&result, sizeof(T));
+                return result;
+            }
+            void read(void* aDestination, std::size_t aSize)
+            {
+                if (static_cast<std::size_t>(iEnd - iNext) < aSize)
+                    throw persistent_glyph_cache::bad_cache_file();
+                std::memcpy(aDestination, iNext, aSize);
+                iNext += aSize;
+            }
+            char const* position() const
+            {
+                return iNext;
+            }
+        private:
+            char const* iNext;
+            char const* iEnd;
+        };
+
+        template <typename T>
+        void write(std::ostream& aStream, T const& aValue)
+        {
+            aStream.write(reinterpret_cast<char const*>(&aValue), sizeof(T));
+        }
+
+        persistent_glyph_cache::face_key read_face_key(reader& aReader)
+        {
+            persistent_glyph_cache::face_key result;
+            result.fontHash = aReader.read<uint64_t>();
+            result.faceIndex = aReader.read<int64_t>();
+            result.style = aReader.read<uint32_t>();
+            result.size = aReader.read<double>();
+            result.horizontalDpi = aReader.read<double>();
+            result.verticalDpi = aReader.read<double>();
+            return result;
+        }
+
+        void write_face_key(std::ostream& aStream, persistent_glyph_cache::face_key const& aKey)
+        {
+            write(aStream, aKey.fontHash);
+            write(aStream, aKey.faceIndex);
+            write(aStream, aKey.style);
+            write(aStream, aKey.size);
+            write(aStream, aKey.horizontalDpi);
+            write(aStream, aKey.verticalDpi);
+        }
+    }
+
+    struct persistent_glyph_cache::mapped_file
+    {
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+    };
+
+    persistent_glyph_cache::persistent_glyph_cache(std::string const& aPath) :
+        iPath{ aPath }, iDirty{ false }
+    {
+        try
+        {
+            load();
+        }
+        catch (std::exception const& e)
+        {
+            service<debug::logger>() << "neogfx: warning: Discarding glyph cache '" << iPath << "': " << e.what() << endl;
+            iGlyphs.clear();
+            iShapedRuns.clear();
+            iMappedFile.reset();
+            iFileData.clear();
+        }
+    }
+
+    persistent_glyph_cache::~persistent_glyph_cache()
+    {
+    }
+
+    std::string const& persistent_glyph_cache::path() const
+    {
+        return iPath;
+    }
+
+    bool persistent_glyph_cache::dirty() const
+    {
+        return iDirty;
+    }
+
+    void persistent_glyph_cache::save()
+    {
+        if (!iDirty)
+            return;
+        boost::filesystem::path const target{ iPath };
+        if (target.has_parent_path())
+            boost::filesystem::create_directories(target.parent_path());
+        std::string const temporary = iPath + ".tmp";
+        {
+            std::ofstream file{ temporary, std::ios::out | std::ios::binary | std::ios::trunc };
+            if (!file)
+                throw failed_to_write_cache_file();
+            uint64_t pixelBlobSize = 0u;
+            for (auto const& g : iGlyphs)
+                pixelBlobSize += g.second.pixelCount;
+            file.write(kMagic, sizeof(kMagic));
+            write(file, kFormatVersion);
+            write(file, kFreetypeVersion);
+            write(file, kHarfbuzzVersion);
+            write(file, static_cast<uint64_t>(iGlyphs.size()));
+            write(file, static_cast<uint64_t>(iShapedRuns.size()));
+            write(file, pixelBlobSize);
+            uint64_t pixelOffset = 0u;
+            for (auto const& g : iGlyphs)
+            {
+                write_face_key(file, g.first.first);
+                write(file, g.first.second);
+                write(file, static_cast<uint8_t>(g.second.subpixel));
+                write(file, static_cast<uint8_t>(g.second.pixelMode));
+                write(file, g.second.placement.x);
+                write(file, g.second.placement.y);
+                write(file, g.second.extents.cx);
+                write(file, g.second.extents.cy);
+                write(file, pixelOffset);
+                write(file, static_cast<uint64_t>(g.second.pixelCount));
+                pixelOffset += g.second.pixelCount;
+            }
+            for (auto const& r : iShapedRuns)
+            {
+                write_face_key(file, r.first.face);
+                write(file, r.first.direction);
+                write(file, r.first.script);
+                write(file, static_cast<uint8_t>(r.first.kerning));
+                write(file, static_cast<uint32_t>(r.first.text.size()));
+                write(file, static_cast<uint32_t>(r.second.size()));
+                file.write(reinterpret_cast<char const*>(r.first.text.data()), r.first.text.size() * sizeof(char32_t));
+                file.write(reinterpret_cast<char const*>(r.second.data()), r.second.size() * sizeof(shaped_glyph));
+            }
+            for (auto const& g : iGlyphs)
+                file.write(reinterpret_cast<char const*>(g.second.pixels), g.second.pixelCount);
+            if (!file)
+                throw failed_to_write_cache_file();
+        }
+        unmap();
+        boost::filesystem::rename(temporary, target);
+        iDirty = false;
+    }
+
+    persistent_glyph_cache::glyph_record const* persistent_glyph_cache::find_glyph(face_key const& aFace, uint32_t aGlyphIndex) const
+    {
+        auto existing = iGlyphs.find(std::make_pair(aFace, aGlyphIndex));
+        if (existing != iGlyphs.end())
+            return &existing->second;
+        return nullptr;
+    }
+
+    void persistent_glyph_cache::add_glyph(face_key const& aFace, uint32_t aGlyphIndex, bool aSubpixel, glyph_pixel_mode aPixelMode, point const& aPlacement, size_u32 const& aExtents, std::vector<uint8_t> const& aPixels)
+    {
+        auto const key = std::make_pair(aFace, aGlyphIndex);
+        if (iGlyphs.find(key) != iGlyphs.end())
+            return;
+        auto const& pixels = iNewPixels.emplace_back(aPixels);
+        iGlyphs.emplace(key, glyph_record{ aSubpixel, aPixelMode, aPlacement, aExtents, pixels.data(), pixels.size() });
+        iDirty = true;
+    }
+
+    persistent_glyph_cache::shaped_run const* persistent_glyph_cache::find_shaped_run(shaping_key const& aKey) const
+    {
+        auto existing = iShapedRuns.find(aKey);
+        if (existing != iShapedRuns.end())
+            return &existing->second;
+        return nullptr;
+    }
+
+    void persistent_glyph_cache::add_shaped_run(shaping_key const& aKey, shaped_run const& aRun)
+    {
+        if (aKey.text.size() > kMaxShapedRunLength)
+            return;
+        if (iShapedRuns.emplace(aKey, aRun).second)
+            iDirty = true;
+    }
+
+    uint64_t persistent_glyph_cache::hash(void const* aData, std::size_t aSize)
+    {
+        // FNV-1a
+        uint64_t result = 14695981039346656037ull;
+        auto const* bytes = static_cast<uint8_t const*>(aData);
+        for (std::size_t i = 0; i < aSize; ++i)
+        {
+            result ^= bytes[i];
+            result *= 1099511628211ull;
+        }
+        return result;
+    }
+
+    void persistent_glyph_cache::load()
+    {
+        if (!boost::filesystem::exists(iPath))
+            return;
+        auto const fileSize = static_cast<std::size_t>(boost::filesystem::file_size(iPath));
+        if (fileSize == 0u)
+            throw bad_cache_file();
+        char const* fileData = nullptr;
+        try
+        {
+            // map the file rather than copying it into memory; glyph pixels are then referenced in the mapping
+            boost::interprocess::file_mapping file{ iPath.c_str(), boost::interprocess::read_only };
+            boost::interprocess::mapped_region region{ file, boost::interprocess::read_only, 0, fileSize };
+            iMappedFile = std::make_unique<mapped_file>(mapped_file{ std::move(file), std::move(region) });
+            fileData = static_cast<char const*>(iMappedFile->region.get_address());
+        }
+        catch (boost::interprocess::interprocess_exception const&)
+        {
+            iFileData.resize(fileSize);
+            std::ifstream file{ iPath, std::ios::in | std::ios::binary };
+            if (!file.read(iFileData.data(), fileSize))
+                throw bad_cache_file();
+            fileData = iFileData.data();
+        }
+
+        reader input{ fileData, fileData + fileSize };
+        char magic[sizeof(kMagic)];
+        input.read(magic, sizeof(magic));
+        if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            input.read<uint32_t>() != kFormatVersion ||
+            input.read<uint32_t>() != kFreetypeVersion ||
+            input.read<uint32_t>() != kHarfbuzzVersion)
+            throw bad_cache_file();
+        auto const glyphCount = input.read<uint64_t>();
+        auto const shapedRunCount = input.read<uint64_t>();
+        auto const pixelBlobSize = input.read<uint64_t>();
+        if (pixelBlobSize > fileSize)
+            throw bad_cache_file();
+        auto const* const pixelBlob = reinterpret_cast<uint8_t const*>(fileData + fileSize - pixelBlobSize);
+        for (uint64_t i = 0u; i < glyphCount; ++i)
+        {
+            auto const face = read_face_key(input);
+            auto const glyphIndex = input.read<uint32_t>();
+            glyph_record record;
+            record.subpixel = input.read<uint8_t>() != 0u;
+            record.pixelMode = static_cast<glyph_pixel_mode>(input.read<uint8_t>());
+            record.placement.x = input.read<coordinate>();
+            record.placement.y = input.read<coordinate>();
+            record.extents.cx = input.read<uint32_t>();
+            record.extents.cy = input.read<uint32_t>();
+            auto const pixelOffset = input.read<uint64_t>();
+            auto const pixelCount = input.read<uint64_t>();
+            if (pixelOffset > pixelBlobSize || pixelCount > pixelBlobSize - pixelOffset)
+                throw bad_cache_file();
+            record.pixels = pixelBlob + pixelOffset;
+            record.pixelCount = static_cast<std::size_t>(pixelCount);
+            iGlyphs.emplace(std::make_pair(face, glyphIndex), record);
+        }
+        for (uint64_t i = 0u; i < shapedRunCount; ++i)
+        {
+            shaping_key key;
+            key.face = read_face_key(input);
+            key.direction = input.read<uint32_t>();
+            key.script = input.read<uint32_t>();
+            key.kerning = input.read<uint8_t>() != 0u;
+            auto const textLength = input.read<uint32_t>();
+            auto const runLength = input.read<uint32_t>();
+            if (textLength > kMaxShapedRunLength || runLength > kMaxShapedRunLength * 4u)
+                throw bad_cache_file();
+            key.text.resize(textLength);
+            input.read(key.text.data(), textLength * sizeof(char32_t));
+            shaped_run run(runLength);
+            input.read(run.data(), runLength * sizeof(shaped_glyph));
+            iShapedRuns.emplace(std::move(key), std::move(run));
+        }
+        if (input.position() != reinterpret_cast<char const*>(pixelBlob))
+            throw bad_cache_file();
+    }
+
+    void persistent_glyph_cache::unmap()
+    {
+        // the cache file can't be replaced while it is mapped (on Windows) so glyphs still referencing it are
+        // given their own copy of their pixels first
+        if (!iMappedFile)
+            return;
+        auto const* const mappedBegin = static_cast<uint8_t const*>(iMappedFile->region.get_address());
+        auto const* const mappedEnd = mappedBegin + iMappedFile->region.get_size();
+        for (auto& g : iGlyphs)
+        {
+            if (g.second.pixels < mappedBegin || g.second.pixels >= mappedEnd)
+                continue;
+            auto const& pixels = iNewPixels.emplace_back(g.second.pixels, g.second.pixels + g.second.pixelCount);
+            g.second.pixels = pixels.data();
+        }
+        iMappedFile.reset();
+    }
+}
\ No newline at end of file
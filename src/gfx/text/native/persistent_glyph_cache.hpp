@@ -0,0 +1,114 @@
+// persistent_glyph_cache.hpp
+/*
+  neogfx C++ App/Game Engine
+  Copyright (c) 2020 Leigh Johnston.  All Rights Reserved.
+
+  This program is free software: you can redistribute it and / or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <neogfx/neogfx.hpp>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <neogfx/core/geometrical.hpp>
+#include <neogfx/gfx/text/i_glyph_texture.hpp>
+
+namespace neogfx
+{
+    // Rasterized glyphs and shaped runs keyed by font file hash rather than by font id so that
+    // they remain valid across application runs. The file is a header and fixed layout index
+    // followed by a single pixel blob; the file is memory mapped and glyph pixels are
+    // referenced in place.
+    class persistent_glyph_cache
+    {
+    public:
+        struct face_key
+        {
+            uint64_t fontHash;
+            int64_t faceIndex;
+            uint32_t style;
+            double size;
+            double horizontalDpi;
+            double verticalDpi;
+            auto operator<=>(face_key const&) const = default;
+        };
+        struct glyph_record
+        {
+            bool subpixel;
+            glyph_pixel_mode pixelMode;
+            point placement;
+            size_u32 extents;
+            uint8_t const* pixels;
+            std::size_t pixelCount;
+        };
+        struct shaping_key
+        {
+            face_key face;
+            uint32_t direction;
+            uint32_t script;
+            bool kerning;
+            std::u32string text;
+            auto operator<=>(shaping_key const&) const = default;
+        };
+        struct shaped_glyph
+        {
+            uint32_t codepoint;
+            uint32_t cluster;
+            int32_t xAdvance;
+            int32_t yAdvance;
+            int32_t xOffset;
+            int32_t yOffset;
+        };
+        typedef std::vector<shaped_glyph> shaped_run;
+    private:
+        typedef std::map<std::pair<face_key, uint32_t>, glyph_record> glyph_index;
+        typedef std::map<shaping_key, shaped_run> shaping_index;
+    public:
+        struct bad_cache_file : std::runtime_error { bad_cache_file() : std::runtime_error("neogfx::persistent_glyph_cache::bad_cache_file") {} };
+        struct failed_to_write_cache_file : std::runtime_error { failed_to_write_cache_file() : std::runtime_error("neogfx::persistent_glyph_cache::failed_to_write_cache_file") {} };
+    public:
+        static constexpr std::size_t kMaxShapedRunLength = 256u;
+    public:
+        persistent_glyph_cache(std::string const& aPath);
+        ~persistent_glyph_cache();
+    public:
+        std::string const& path() const;
+        bool dirty() const;
+        void save();
+    public:
+        glyph_record const* find_glyph(face_key const& aFace, uint32_t aGlyphIndex) const;
+        void add_glyph(face_key const& aFace, uint32_t aGlyphIndex, bool aSubpixel, glyph_pixel_mode aPixelMode, point const& aPlacement, size_u32 const& aExtents, std::vector<uint8_t> const& aPixels);
+        shaped_run const* find_shaped_run(shaping_key const& aKey) const;
+        void add_shaped_run(shaping_key const& aKey, shaped_run const& aRun);
+    public:
+        static uint64_t hash(void const* aData, std::size_t aSize);
+    private:
+        void load();
+        void unmap();
+    private:
+        struct mapped_file;
+    private:
+        std::string iPath;
+        std::unique_ptr<mapped_file> iMappedFile;
+        std::vector<char> iFileData;
+        std::deque<std::vector<uint8_t>> iNewPixels;
+        glyph_index iGlyphs;
+        shaping_index iShapedRuns;
+        bool iDirty;
+    };
+}
\ No newline at end of file
@@ -215,6 +215,7 @@ namespace neogfx
         iDimensions = {};
         iCursor = {};
         iSpans.clear();
+        iSpanLookup = std::nullopt;
     }
 
     void grid_layout::invalidate(bool aDeferLayout)
@@ -318,6 +319,7 @@ namespace neogfx
     grid_layout& grid_layout::add_span(const cell_coordinates& aFrom, const cell_coordinates& aTo)
     {
         iSpans.push_back(std::make_pair(aFrom, aTo));
+        iSpanLookup = std::nullopt;
         update_layout();
         return *this;
     }
@@ -357,6 +359,10 @@ namespace neogfx
         {
             std::vector<dimension> maxRowHeight;
             std::vector<dimension> maxColWidth;
+            std::vector<coordinate> rowPos;
+            std::vector<coordinate> colPos;
+            std::vector<bool> rowVisible;
+            std::vector<bool> colVisible;
         };
         typedef std::vector<std::unique_ptr<stack_entry>> calc_stack_t;
         thread_local calc_stack_t stack;
@@ -366,87 +372,77 @@ namespace neogfx
             stack.push_back(std::make_unique<stack_entry>());
         auto& maxRowHeight = stack[stackIndex - 1]->maxRowHeight;
         auto& maxColWidth = stack[stackIndex - 1]->maxColWidth;
+        auto& rowPos = stack[stackIndex - 1]->rowPos;
+        auto& colPos = stack[stackIndex - 1]->colPos;
+        auto& rowVisible = stack[stackIndex - 1]->rowVisible;
+        auto& colVisible = stack[stackIndex - 1]->colVisible;
         maxRowHeight.clear();
         maxColWidth.clear();
+        rowVisible.clear();
+        colVisible.clear();
         maxRowHeight.resize(iDimensions.cy);
         maxColWidth.resize(iDimensions.cx);
+        rowPos.resize(iDimensions.cy);
+        colPos.resize(iDimensions.cx);
+        rowVisible.resize(iDimensions.cy);
+        colVisible.resize(iDimensions.cx);
 
-        bool first = true;
-        for (cell_coordinate row = 0; row < iDimensions.cy; ++row)
+        // a single pass over the occupied cells rather than probing every row and column
+        for (auto const& cell : iCells)
         {
-            if (!is_row_visible(row))
+            if (cell.first.y >= iDimensions.cy || cell.first.x >= iDimensions.cx || !cell.second->visible())
                 continue;
-            if (first)
-            {
-                first = false;
-                availablePos.y = row_layout(row).position().y;
-            }
-            for (cell_coordinate col = 0; col < iDimensions.cx; ++col)
-            {
-                if (!is_column_visible(col))
-                    continue;
-                auto i = iCells.find(cell_coordinates{ col, row });
-                if (i != iCells.end())
-                {
-                    auto s = find_span(cell_coordinates{ col, row });
-                    if (s == iSpans.end() || s->first.y == s->second.y)
-                        maxRowHeight[row] = std::max(maxRowHeight[row], i->second->extents().cy);
-                    if (s == iSpans.end() || s->first.x == s->second.x)
-                        maxColWidth[col] = std::max(maxColWidth[col], i->second->extents().cx);
-                }
-            }
+            auto const minimumSize = cell.second->minimum_size();
+            if (minimumSize.cy != 0.0)
+                rowVisible[cell.first.y] = true;
+            if (minimumSize.cx != 0.0)
+                colVisible[cell.first.x] = true;
+        }
+        auto const firstVisibleRow = std::find(rowVisible.begin(), rowVisible.end(), true);
+        if (firstVisibleRow != rowVisible.end())
+            availablePos.y = row_layout(static_cast<cell_coordinate>(std::distance(rowVisible.begin(), firstVisibleRow))).position().y;
+        for (auto const& cell : iCells)
+        {
+            if (cell.first.y >= iDimensions.cy || cell.first.x >= iDimensions.cx || !rowVisible[cell.first.y] || !colVisible[cell.first.x])
+                continue;
+            auto s = find_span(cell.first);
+            if (s == iSpans.end() || s->first.y == s->second.y)
+                maxRowHeight[cell.first.y] = std::max(maxRowHeight[cell.first.y], cell.second->extents().cy);
+            if (s == iSpans.end() || s->first.x == s->second.x)
+                maxColWidth[cell.first.x] = std::max(maxColWidth[cell.first.x], cell.second->extents().cx);
         }
-        point rowPos = availablePos;
+
+        // prefix sums of row heights and column widths (empty rows and columns take no space)
+        coordinate nextPos = availablePos.y;
         for (cell_coordinate row = 0; row < iDimensions.cy; ++row)
         {
-            if (maxRowHeight[row] == 0.0)
+            rowPos[row] = nextPos;
+            if (maxRowHeight[row] != 0.0)
+                nextPos += maxRowHeight[row] + spacing().cy;
+        }
+        nextPos = availablePos.x;
+        for (cell_coordinate col = 0; col < iDimensions.cx; ++col)
+        {
+            colPos[col] = nextPos;
+            if (maxColWidth[col] != 0.0)
+                nextPos += maxColWidth[col] + spacing().cx;
+        }
+
+        for (auto const& cell : iCells)
+        {
+            auto const row = cell.first.y;
+            auto const col = cell.first.x;
+            if (row >= iDimensions.cy || col >= iDimensions.cx || maxRowHeight[row] == 0.0 || maxColWidth[col] == 0.0)
                 continue;
-            point colPos = rowPos;
-            for (cell_coordinate col = 0; col < iDimensions.cx; ++col)
+            auto s = find_span(cell.first);
+            if (s != iSpans.end() && s->second.y < iDimensions.cy && s->second.x < iDimensions.cx)
             {
-                if (maxColWidth[col] == 0.0)
-                    continue;
-                auto i = iCells.find(cell_coordinates{ col, row });
-                if (i != iCells.end())
-                {
-                    bool foundSpan = false;
-                    for (auto& s : iSpans)
-                    {
-                        if (col >= s.first.x && col <= s.second.x &&
-                            row >= s.first.y && row <= s.second.y)
-                        {
-                            point fromPos;
-                            point toPos;
-                            point rowPos2 = availablePos;
-                            for (cell_coordinate row2 = 0; !foundSpan && row2 <= s.second.y; ++row2)
-                            {
-                                point colPos2 = rowPos2;
-                                for (cell_coordinate col2 = 0; !foundSpan && col2 <= s.second.x; ++col2)
-                                {
-                                    if (row2 == s.first.y && col2 == s.first.x)
-                                        fromPos = colPos2;
-                                    if (row2 == s.second.y && col2 == s.second.x)
-                                    {
-                                        toPos = colPos2 + size{ maxColWidth[col2], maxRowHeight[row2] };
-                                        i->second->layout_as(fromPos, size{ toPos - fromPos });
-                                        foundSpan = true;
-                                    }
-                                    colPos2.x += maxColWidth[col2];
-                                    colPos2.x += spacing().cx;
-                                }
-                                rowPos2.y += maxRowHeight[row2];
-                                rowPos2.y += spacing().cy;
-                            }
-                        }
-                    }
-                    if (!foundSpan)
-                        i->second->layout_as(colPos, size{maxColWidth[col], maxRowHeight[row]});
-                }
-                colPos.x += maxColWidth[col];
-                colPos.x += spacing().cx;
+                point const fromPos{ colPos[s->first.x], rowPos[s->first.y] };
+                point const toPos{ colPos[s->second.x] + maxColWidth[s->second.x], rowPos[s->second.y] + maxRowHeight[s->second.y] };
+                cell.second->layout_as(fromPos, size{ toPos - fromPos });
             }
-            rowPos.y += maxRowHeight[row];
-            rowPos.y += spacing().cy;
+            else
+                cell.second->layout_as(point{ colPos[col], rowPos[row] }, size{ maxColWidth[col], maxRowHeight[row] });
         }
         if (has_layout_owner())
             layout_owner().layout_items_completed();
@@ -610,6 +606,30 @@ namespace neogfx
 
     grid_layout::span_list::const_iterator grid_layout::find_span(const cell_coordinates& aCell) const
     {
+        if (iSpans.empty())
+            return iSpans.end();
+        if (!iSpanLookup || iSpanLookup->dimensions != iDimensions)
+        {
+            iSpanLookup.emplace();
+            iSpanLookup->dimensions = iDimensions;
+            iSpanLookup->spans.assign(static_cast<std::size_t>(iDimensions.cx) * iDimensions.cy, 0u);
+            for (std::size_t spanIndex = 0u; spanIndex < iSpans.size(); ++spanIndex)
+            {
+                auto const& s = iSpans[spanIndex];
+                for (cell_coordinate row = s.first.y; row <= s.second.y && row < iDimensions.cy; ++row)
+                    for (cell_coordinate col = s.first.x; col <= s.second.x && col < iDimensions.cx; ++col)
+                    {
+                        auto& entry = iSpanLookup->spans[static_cast<std::size_t>(row) * iDimensions.cx + col];
+                        if (entry == 0u)
+                            entry = static_cast<uint32_t>(spanIndex + 1u);
+                    }
+            }
+        }
+        if (aCell.x < iDimensions.cx && aCell.y < iDimensions.cy)
+        {
+            auto const entry = iSpanLookup->spans[static_cast<std::size_t>(aCell.y) * iDimensions.cx + aCell.x];
+            return entry != 0u ? std::next(iSpans.begin(), entry - 1u) : iSpans.end();
+        }
         for (auto s = iSpans.begin(); s != iSpans.end(); ++s)
             if (aCell.x >= s->first.x && aCell.x <= s->second.x && aCell.y >= s->first.y && aCell.y <= s->second.y)
                 return s;
@@ -198,21 +198,18 @@ namespace neogfx
     void header_view::item_added(item_presentation_model_index const&)
     {
         iSectionWidths.resize(presentation_model().columns());
-        /* todo : optimize (don't do full update) */
         request_full_update();
     }
 
     void header_view::item_changed(item_presentation_model_index const&)
     {
         iSectionWidths.resize(presentation_model().columns());
-        /* todo : optimize (don't do full update) */
         request_full_update();
     }
 
     void header_view::item_removed(item_presentation_model_index const&)
     {
         iSectionWidths.resize(presentation_model().columns());
-        /* todo : optimize (don't do full update) */
         request_full_update();
     }
 
@@ -468,18 +465,13 @@ namespace neogfx
         iUpdateNeeded = false;
         update_buttons();
         graphics_context gc{ *this, graphics_context::type::Unattached };
-        for (uint32_t row = 0; row < presentation_model().rows(); ++row)
-            update_from_row(row, gc);
-        iOwner.header_view_updated(*this, header_view_update_reason::FullUpdate);
-    }
-
-    void header_view::update_from_row(uint32_t aRow, i_graphics_context& aGc)
-    {
+        // the presentation model maintains column widths incrementally so only changed rows are remeasured
         bool updated = false;
-        for (uint32_t col = 0; col < presentation_model().columns(item_presentation_model_index{ aRow }); ++col)
-            updated = update_section_width(col, presentation_model().cell_extents(item_presentation_model_index{ aRow, col }, aGc) + presentation_model().cell_padding(*this).size() * 2.0, aGc) || updated;
+        for (uint32_t col = 0; col < presentation_model().columns(); ++col)
+            updated = update_section_width(col, size{ presentation_model().column_width(col, gc, false) + presentation_model().cell_padding(*this).size().cx * 2.0 }, gc) || updated;
         if (updated)
             layout_items();
+        iOwner.header_view_updated(*this, header_view_update_reason::FullUpdate);
     }
 
     bool header_view::update_section_width(uint32_t aColumn, const size& aCellExtents, i_graphics_context& aGc)
@@ -132,6 +132,7 @@ namespace neogfx
             return;
         iPresentationModelSink.clear();
         iPresentationModel = aPresentationModel;
+        iSelectionAnchor = std::nullopt;
         if (has_presentation_model())
         {
             if (presentation_model().has_item_model())
@@ -1435,6 +1436,24 @@ namespace neogfx
 
     void item_view::select(item_presentation_model_index const& aItemIndex, key_modifiers_e aKeyModifiers)
     {
+        if ((aKeyModifiers & KeyModifier_SHIFT) == KeyModifier_NONE)
+            iSelectionAnchor = presentation_model().to_item_model_index(aItemIndex);
+        else if (selection_model().mode() == item_selection_mode::ExtendedSelection)
+        {
+            // successive shift-clicks all extend from the item of the last click without shift
+            optional_item_presentation_model_index anchor;
+            if (iSelectionAnchor != std::nullopt && presentation_model().has_item_model_index(*iSelectionAnchor))
+                anchor = presentation_model().from_item_model_index(*iSelectionAnchor);
+            else if (selection_model().has_current_index())
+                anchor = selection_model().current_index();
+            if (anchor != std::nullopt)
+            {
+                selection_model().set_current_index(aItemIndex);
+                selection_model().select(*anchor, aItemIndex, (aKeyModifiers & KeyModifier_CTRL) != KeyModifier_NONE ?
+                    item_selection_operation::Select : item_selection_operation::ClearAndSelect);
+                return;
+            }
+        }
         select(aItemIndex, to_selection_operation(aKeyModifiers));
     }
 
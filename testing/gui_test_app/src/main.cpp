@@ -220,6 +220,7 @@ private:
 };
 
 ng::game::i_ecs& create_game(ng::i_layout& aLayout);
+int run_self_tests();
 
 void signal_handler(int signal)
 {
@@ -260,7 +261,11 @@ int main(int argc, char* argv[])
     egregious this function is a special case: it is test code which mostly just creates widgets. 
     Most of this code is about to disappear into code auto-generated by the neoGFX resource compiler! */
 
-    test::main_app app{ argc, argv, "neoGFX Test App (Pre-Release)" };
+    // --self-test runs the headless checks in self_test.cpp instead of the demo
+    std::vector<char*> arguments{ argv, argv + argc };
+    bool const selfTest = std::erase_if(arguments, [](char const* aArgument) { return std::string_view{ aArgument } == "--self-test"; }) != 0u;
+
+    test::main_app app{ static_cast<int>(arguments.size()), arguments.data(), "neoGFX Test App (Pre-Release)" };
 
     try
     {
@@ -269,6 +274,9 @@ int main(int argc, char* argv[])
         app.current_style().palette().set_color(ng::color_role::Theme, ng::color::Black);
         app.change_style("Dark");
 
+        if (selfTest)
+            return run_self_tests();
+
         test::main_window window{ app };
 
         auto ds = window.textEdit.default_style();
@@ -0,0 +1,398 @@
+﻿#include <neogfx/neogfx.hpp>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <numbers>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <neogfx/gui/widget/item_model.hpp>
+#include <neogfx/gui/widget/item_presentation_model.hpp>
+#include <neogfx/gui/widget/item_selection_model.hpp>
+#include <neogfx/gfx/image.hpp>
+#include <neogfx/audio/audio_waveform.hpp>
+#include <neogfx/audio/audio_renderer.hpp>
+#include <neogfx/audio/audio_bitstream.hpp>
+#include <neogfx/audio/audio_device.hpp>
+#include <neogfx/audio/audio_oscillator.hpp>
+
+namespace ng = neogfx;
+
+// Headless checks run by "test --self-test" in place of the demo window; each check throws on failure.
+
+namespace
+{
+    struct check_failed : std::logic_error { check_failed(std::string const& aWhat) : std::logic_error{ "test::" + aWhat } {} };
+
+    void check(bool aCondition, std::string const& aWhat)
+    {
+        if (!aCondition)
+            throw check_failed{ aWhat };
+    }
+
+    typedef ng::basic_item_model<void*, 1u> value_model;
+
+    // FNV-1a
+    template <typename T>
+    uint64_t hash(std::vector<T> const& aValues)
+    {
+        uint64_t result = 14695981039346656037ull;
+        auto const* bytes = reinterpret_cast<uint8_t const*>(aValues.data());
+        for (std::size_t i = 0u; i < aValues.size() * sizeof(T); ++i)
+        {
+            result ^= bytes[i];
+            result *= 1099511628211ull;
+        }
+        return result;
+    }
+
+    uint32_t selected_rows(ng::i_item_presentation_model const& aPresentationModel, ng::i_item_selection_model const& aSelectionModel)
+    {
+        uint32_t result = 0u;
+        for (uint32_t row = 0u; row < aPresentationModel.rows(); ++row)
+            if (aSelectionModel.is_selected(ng::item_presentation_model_index{ row }))
+                ++result;
+        return result;
+    }
+
+    // amplitude of the sinusoid at DFT bin aBin (Goertzel)
+    double spectrum_amplitude(std::vector<float> const& aSamples, std::size_t aBin)
+    {
+        double const w = 2.0 * std::numbers::pi * aBin / aSamples.size();
+        double const coefficient = 2.0 * std::cos(w);
+        double s1 = 0.0;
+        double s2 = 0.0;
+        for (auto sample : aSamples)
+        {
+            double const s = sample + coefficient * s1 - s2;
+            s2 = s1;
+            s1 = s;
+        }
+        double const real = s1 - s2 * std::cos(w);
+        double const imaginary = s2 * std::sin(w);
+        return 2.0 * std::sqrt(real * real + imaginary * imaginary) / aSamples.size();
+    }
+
+    // silent source that counts the frames the mixer pulls from it
+    class counting_bitstream : public ng::audio_bitstream<ng::i_audio_bitstream>
+    {
+    public:
+        counting_bitstream() : audio_bitstream{ 48000u }
+        {
+        }
+    public:
+        uint64_t frames() const
+        {
+            return iFrames;
+        }
+    public:
+        ng::audio_frame_count length() const final
+        {
+            return 0ull;
+        }
+        void generate(ng::audio_channel, ng::audio_frame_count aFrameCount, float*) final
+        {
+            iFrames += aFrameCount;
+        }
+        void generate_from(ng::audio_channel, ng::audio_frame_index, ng::audio_frame_count aFrameCount, float*) final
+        {
+            iFrames += aFrameCount;
+        }
+    private:
+        std::atomic<uint64_t> iFrames = 0ull;
+    };
+
+    class envelope_bitstream : public ng::audio_bitstream<ng::i_audio_bitstream>
+    {
+    public:
+        envelope_bitstream() : audio_bitstream{ 48000u, 0.8f }
+        {
+        }
+    public:
+        using audio_bitstream::apply_envelope;
+    public:
+        ng::audio_frame_count length() const final
+        {
+            return 0ull;
+        }
+        void generate(ng::audio_channel, ng::audio_frame_count, float*) final
+        {
+        }
+        void generate_from(ng::audio_channel, ng::audio_frame_index, ng::audio_frame_count, float*) final
+        {
+        }
+    };
+
+    void test_sorted_insertion_keeps_selection()
+    {
+        // inserting into a sorted model must leave the selection on the items that were selected
+        value_model model;
+        for (uint32_t value : { 10u, 20u, 30u, 40u })
+            model.append_item(nullptr, value);
+        ng::basic_item_presentation_model<value_model> presentationModel{ model, true };
+        presentationModel.sort_by(0, ng::i_item_presentation_model::sort_direction::Descending);
+        ng::item_selection_model selectionModel{ presentationModel, ng::item_selection_mode::MultipleSelection };
+        selectionModel.select(ng::item_model_index{ 1u }, ng::item_selection_operation::Select);
+        selectionModel.select(ng::item_model_index{ 3u }, ng::item_selection_operation::Select);
+        model.append_item(nullptr, 25u);
+        model.insert_item(ng::item_model_index{ 0u }, nullptr, 35u);
+        check(selected_rows(presentationModel, selectionModel) == 2u &&
+            selectionModel.is_selected(presentationModel.from_item_model_index(ng::item_model_index{ 2u })) &&
+            selectionModel.is_selected(presentationModel.from_item_model_index(ng::item_model_index{ 4u })),
+            "sorted insertion moved the selection");
+    }
+
+    void test_filtering_sorted_model_keeps_selection()
+    {
+        // filtering a sortable model re-sorts it while the filter is being applied; the selection and current
+        // index saved when filtering began must survive the nested sort
+        value_model model;
+        for (uint32_t value : { 10u, 20u, 21u, 30u, 22u })
+            model.append_item(nullptr, value);
+        ng::basic_item_presentation_model<value_model> presentationModel{ model, true };
+        presentationModel.sort_by(0, ng::i_item_presentation_model::sort_direction::Descending);
+        ng::item_selection_model selectionModel{ presentationModel, ng::item_selection_mode::MultipleSelection };
+        selectionModel.set_current_index(presentationModel.from_item_model_index(ng::item_model_index{ 1u }));
+        selectionModel.select(ng::item_model_index{ 1u }, ng::item_selection_operation::Select);
+        selectionModel.select(ng::item_model_index{ 3u }, ng::item_selection_operation::Select);
+        presentationModel.filter_by(0, "2");
+        check(presentationModel.rows() == 3u, "filter did not leave the expected rows");
+        check(selected_rows(presentationModel, selectionModel) == 1u &&
+            selectionModel.is_selected(presentationModel.from_item_model_index(ng::item_model_index{ 1u })),
+            "filtering a sorted model lost the selection");
+        check(selectionModel.has_current_index() &&
+            selectionModel.current_index().row() == presentationModel.from_item_model_index(ng::item_model_index{ 1u }).row(),
+            "filtering a sorted model lost the current index");
+    }
+
+    void test_removing_filtered_out_item_renumbers_rows()
+    {
+        // removing a row the filter hides must still renumber the model rows presented after it
+        value_model model;
+        for (uint32_t value : { 10u, 20u, 11u, 21u, 12u })
+            model.append_item(nullptr, value);
+        ng::basic_item_presentation_model<value_model> presentationModel{ model };
+        presentationModel.filter_by(0, "1");
+        model.erase(ng::item_model_index{ 1u });
+        check(presentationModel.rows() == 3u, "filter did not leave the expected rows");
+        for (uint32_t row = 0u; row < presentationModel.rows(); ++row)
+        {
+            auto const modelIndex = presentationModel.to_item_model_index(ng::item_presentation_model_index{ row });
+            check(modelIndex.row() < model.rows() && model.cell_data(modelIndex).to_string() == std::to_string(10u + row),
+                "removing a filtered out item left stale model rows");
+            check(presentationModel.from_item_model_index(modelIndex).row() == row, "removing a filtered out item left a stale row map");
+        }
+    }
+
+    void test_decoded_images_are_copies()
+    {
+        // a background decode must match a synchronous one and each request must get an image of its own
+        std::string const uri = ":/test/resources/neoGFX.png";
+        ng::image const expected{ uri };
+        auto first = ng::image::load_async(uri).get();
+        auto second = ng::image::load_async(uri).get();
+        check(!first->extents().empty() && first->extents() == expected.extents(), "decoded image has the wrong extents");
+        std::size_t const pixelBytes = static_cast<std::size_t>(expected.extents().cx * expected.extents().cy) * 4u;
+        check(std::memcmp(first->cpixels(), expected.cpixels(), pixelBytes) == 0, "background decode differs from a synchronous one");
+        check(&*first != &*second && first->cpixels() != second->cpixels(), "decoded image is shared between requests");
+        auto const original = second->get_pixel(ng::point{});
+        first->set_pixel(ng::point{}, original == ng::color::Red ? ng::color::Blue : ng::color::Red);
+        check(second->get_pixel(ng::point{}) == original, "changing one decoded image changed another");
+        ng::image::clear_decoded_images();
+        auto third = ng::image::load_async(uri).get();
+        check(std::memcmp(third->cpixels(), expected.cpixels(), pixelBytes) == 0, "decoding again after clearing the cache failed");
+    }
+
+    void test_device_survives_concurrent_add_and_remove()
+    {
+        // several producers add and remove sources while the null backend's callback mixes them; once every source
+        // has been removed none of them may be pulled from again
+        std::array<counting_bitstream, 16u> bitstreams;
+        ng::audio_device device{ ng::audio_data_format{ ng::audio_sample_format::F32, 2u, 48000u } };
+        auto const retry = [](auto aCommand)
+        {
+            for (;;)
+                try
+                {
+                    aCommand();
+                    return;
+                }
+                catch (ng::audio_device::command_queue_full const&)
+                {
+                    std::this_thread::yield();
+                }
+        };
+        device.start();
+        std::vector<std::thread> producers;
+        for (uint32_t producer = 0u; producer < 4u; ++producer)
+            producers.emplace_back([&, producer]()
+            {
+                for (uint32_t i = 0u; i < 5000u; ++i)
+                {
+                    auto& bitstream = bitstreams[(producer * 7u + i) % bitstreams.size()];
+                    if (i % 3u == 2u)
+                        retry([&]() { device.stop(bitstream); });
+                    else
+                        retry([&]() { device.play(bitstream, std::chrono::milliseconds{ 20 + i % 50u }); });
+                }
+            });
+        for (auto& producer : producers)
+            producer.join();
+        for (auto& bitstream : bitstreams)
+            retry([&]() { device.stop(bitstream); });
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+        auto const total = [&]()
+        {
+            uint64_t result = 0ull;
+            for (auto const& bitstream : bitstreams)
+                result += bitstream.frames();
+            return result;
+        };
+        auto const mixed = total();
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+        check(total() == mixed, "a removed source is still being mixed");
+        device.stop();
+        check(mixed != 0u, "the device never mixed a source");
+    }
+
+    void test_oscillator_spectra()
+    {
+        // a whole number of cycles fits the analysis window so every harmonic falls exactly on a bin, and harmonics
+        // above Nyquist alias to bins between them; the band-limited waveforms must keep their harmonic series and
+        // keep those aliases well below what naive waveforms produce (about -26 dB for a sawtooth's first alias)
+        std::size_t constexpr windowSize = 65536u;
+        std::size_t constexpr cycles = 1689u;
+        ng::audio_sample_rate constexpr sampleRate = 48000u;
+        float const frequency = static_cast<float>(static_cast<double>(cycles) * sampleRate / windowSize);
+        struct expected_spectrum
+        {
+            ng::oscillator_function function;
+            char const* name;
+            double fundamental;
+            double third;       ///< relative to the fundamental
+            bool oddOnly;
+            double worstAlias;  ///< dB relative to the fundamental
+        };
+        double constexpr pi = std::numbers::pi;
+        expected_spectrum const spectra[] =
+        {
+            { ng::oscillator_function::Sine, "sine", 1.0, 0.0, true, -120.0 },
+            { ng::oscillator_function::Square, "square", 4.0 / pi, 1.0 / 3.0, true, -30.0 },
+            { ng::oscillator_function::Sawtooth, "sawtooth", 2.0 / pi, 1.0 / 3.0, false, -30.0 },
+            { ng::oscillator_function::Triangle, "triangle", 8.0 / (pi * pi), 1.0 / 9.0, true, -55.0 }
+        };
+        for (auto const& expected : spectra)
+        {
+            ng::audio_oscillator oscillator{ sampleRate, frequency, 1.0f, expected.function };
+            std::vector<float> samples(windowSize);
+            // generated in uneven pieces so that the phase is carried across calls
+            for (std::size_t offset = 0u; offset < windowSize; offset += 997u)
+                oscillator.generate(std::min<std::size_t>(997u, windowSize - offset), samples.data() + offset);
+            std::string const name = expected.name;
+            auto const fundamental = spectrum_amplitude(samples, cycles);
+            check(std::abs(fundamental - expected.fundamental) < expected.fundamental * 0.01, name + " fundamental has the wrong amplitude");
+            check(std::abs(spectrum_amplitude(samples, cycles * 3u) / fundamental - expected.third) < 0.01, name + " third harmonic has the wrong amplitude");
+            if (expected.oddOnly)
+                check(spectrum_amplitude(samples, cycles * 2u) / fundamental < 1e-4, name + " has even harmonics");
+            double worstAlias = 0.0;
+            for (std::size_t harmonic = windowSize / 2u / cycles + 1u; harmonic <= windowSize / 2u / cycles + 30u; ++harmonic)
+            {
+                auto bin = (harmonic * cycles) % windowSize;
+                if (bin > windowSize / 2u)
+                    bin = windowSize - bin;
+                worstAlias = std::max(worstAlias, spectrum_amplitude(samples, bin));
+            }
+            check(20.0 * std::log10(worstAlias / fundamental) < expected.worstAlias, name + " aliases too strongly");
+            // changing the frequency part way through a cycle restarts the waveform from zero phase
+            std::vector<float> restarted(100u);
+            oscillator.generate(restarted.size(), restarted.data());
+            oscillator.set_frequency(frequency * 2.0f);
+            oscillator.generate(restarted.size(), restarted.data());
+            std::vector<float> fresh(restarted.size());
+            ng::audio_oscillator{ sampleRate, frequency * 2.0f, 1.0f, expected.function }.generate(fresh.size(), fresh.data());
+            check(restarted == fresh, name + " did not restart from zero phase after a frequency change");
+        }
+    }
+
+    void test_block_envelope_matches_per_sample()
+    {
+        // the block envelope ramps the gain by a constant step within each ADSR segment; it must agree with
+        // evaluating the envelope at every sample, including windows that straddle segments or the end of the note
+        envelope_bitstream bitstream;
+        ng::audio_sample_count constexpr length = 9000u;
+        std::pair<ng::audio_sample_index, ng::audio_sample_count> const windows[] =
+        {
+            { 0u, length }, { 0u, 1000u }, { 470u, 20u }, { 1430u, 3000u }, { 6590u, 20u }, { 8900u, 500u }, { 9500u, 100u }
+        };
+        for (bool withEnvelope : { true, false })
+        {
+            if (withEnvelope)
+                bitstream.set_envelope(ng::adsr_envelope{ 0.01f, 0.02f, 0.6f, 0.05f });
+            else
+                bitstream.clear_envelope();
+            for (auto const& window : windows)
+            {
+                std::vector<float> samples(window.second, 1.0f);
+                bitstream.apply_envelope(window.first, length, samples.data(), samples.size());
+                for (ng::audio_sample_count i = 0u; i < samples.size(); ++i)
+                    check(std::abs(samples[i] - bitstream.apply_envelope(window.first + i, length)) < 1e-4f,
+                        "block envelope differs from the per-sample envelope at sample " + std::to_string(window.first + i));
+            }
+        }
+    }
+
+    void test_renderer_output_is_independent_of_thread_count()
+    {
+        // overlapping sources of different lengths, starts and gains must mix to the same golden output whatever
+        // the number of worker threads; only oscillator functions that are plain arithmetic (no libm) are used
+        // so that the golden hashes hold on every platform
+        ng::oscillator_function const functions[] = { ng::oscillator_function::Square, ng::oscillator_function::Sawtooth, ng::oscillator_function::Triangle };
+        std::pair<uint32_t, uint64_t> const golden[] = { { 1u, 0xeec76e8bbbb0d366ull }, { 2u, 0x35d04ef66f442389ull } };
+        for (auto const& expected : golden)
+            for (uint32_t threads : { 1u, 2u, 3u, 8u })
+            {
+                ng::audio_renderer renderer{ 48000u, expected.first, threads };
+                std::vector<ng::ref_ptr<ng::audio_waveform>> waveforms;
+                for (uint32_t source = 0u; source < 6u; ++source)
+                {
+                    auto& waveform = waveforms.emplace_back(ng::make_ref<ng::audio_waveform>(48000u, 0.25f));
+                    waveform->create_oscillator(110.0f * (source + 1u) + 7.0f, 1.0f, functions[source % 3u]);
+                    renderer.add_source(*waveform, source * 20000ull, 0.5f + 0.1f * source);
+                }
+                auto const output = renderer.render(200000ull);
+                check(output.size() == 200000u * expected.first, "rendered the wrong number of samples");
+                check(hash(output) == expected.second, "rendered output differs from the golden output with " + std::to_string(threads) + " thread(s)");
+            }
+    }
+}
+
+int run_self_tests()
+{
+    std::pair<char const*, void(*)()> const tests[] =
+    {
+        { "sorted_insertion_keeps_selection", &test_sorted_insertion_keeps_selection },
+        { "filtering_sorted_model_keeps_selection", &test_filtering_sorted_model_keeps_selection },
+        { "removing_filtered_out_item_renumbers_rows", &test_removing_filtered_out_item_renumbers_rows },
+        { "decoded_images_are_copies", &test_decoded_images_are_copies },
+        { "device_survives_concurrent_add_and_remove", &test_device_survives_concurrent_add_and_remove },
+        { "oscillator_spectra", &test_oscillator_spectra },
+        { "block_envelope_matches_per_sample", &test_block_envelope_matches_per_sample },
+        { "renderer_output_is_independent_of_thread_count", &test_renderer_output_is_independent_of_thread_count }
+    };
+    uint32_t failures = 0u;
+    for (auto const& test : tests)
+    {
+        try
+        {
+            test.second();
+            std::cout << "passed: " << test.first << std::endl;
+        }
+        catch (std::exception const& e)
+        {
+            ++failures;
+            std::cerr << "FAILED: " << test.first << ": " << e.what() << std::endl;
+        }
+    }
+    return failures == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+}